@@ -19,21 +19,101 @@
 
 #include "config.h"
 
-#include "org.ofono.Manager.h"
-#include "org.ofono.Modem.h"
-#include "org.ofono.VoiceCallManager.h"
-#include "org.ofono.VoiceCall.h"
-#include "nui-call-monitor.h"
+#include <gio/gio.h>
+#include <glib/gstdio.h>
 
-#define OFONO_BUS_TYPE G_BUS_TYPE_SYSTEM
-#define OFONO_SERVICE "org.ofono"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 
-#define OFONO_(interface) OFONO_SERVICE "." interface
-#define OFONO_VOICECALL_MANAGER_INTERFACE_NAME OFONO_("VoiceCallManager")
+#include "nui-ofono.h"
+#include "nui-call-monitor.h"
 
 #define OFONO_MODEM_PROPERTY_INTERFACES "Interfaces"
 #define OFONO_VOICE_CALL_PROPERTY_STATE "State"
 
+/* seconds to wait for oFono to come back before dropping the call status */
+#define OFONO_RESYNC_TIMEOUT 3
+
+/* file every oFono signal and reply the monitor sees is appended to, SMS
+ * bodies and senders are redacted and the file is created readable by the
+ * user only
+ */
+#define NUI_CALL_MONITOR_TRACE_ENV "NUI_CALL_MONITOR_TRACE"
+#define NUI_CALL_MONITOR_TRACE_HEADER "# nui-call-monitor trace 1"
+
+#define NUI_BUS_NAME "org.maemo.NotificationUI"
+#define NUI_CALL_MONITOR_PATH "/org/maemo/NotificationUI/CallMonitor"
+#define NUI_CALL_MONITOR_STATS_INTERFACE_NAME \
+  "org.maemo.NotificationUI.CallMonitor.Stats"
+#define NUI_CALL_STATE_PATH "/org/maemo/NotificationUI/CallState"
+#define NUI_CALL_STATE_INTERFACE_NAME "org.maemo.NotificationUI.CallState"
+
+static const gchar introspection_xml[] =
+  "<node>"
+  "  <interface name='" NUI_CALL_MONITOR_STATS_INTERFACE_NAME "'>"
+  "    <method name='GetStats'>"
+  "      <arg name='stats' type='a{sv}' direction='out'/>"
+  "    </method>"
+  "  </interface>"
+  "  <interface name='" NUI_CALL_STATE_INTERFACE_NAME "'>"
+  "    <property name='Active' type='b' access='read'/>"
+  "    <property name='Counts' type='au' access='read'/>"
+  "    <property name='Modems' type='a{sau}' access='read'/>"
+  "  </interface>"
+  "</node>";
+
+/* log2 buckets of microseconds, the last one collects everything above */
+#define NUI_HISTOGRAM_BUCKETS 16
+
+typedef struct
+{
+  guint64 count;
+  guint64 total;
+  guint32 buckets[NUI_HISTOGRAM_BUCKETS];
+} NuiHistogram;
+
+enum
+{
+  OFONO_IFACE_MANAGER,
+  OFONO_IFACE_MODEM,
+  OFONO_IFACE_VOICECALL_MANAGER,
+  OFONO_IFACE_VOICECALL,
+  OFONO_IFACE_MESSAGE_MANAGER,
+  OFONO_IFACE_LAST
+};
+
+static const gchar *ofono_iface_names[OFONO_IFACE_LAST] =
+{
+  "Manager",
+  "Modem",
+  "VoiceCallManager",
+  "VoiceCall",
+  "MessageManager"
+};
+
+typedef struct
+{
+  /* D-Bus signal subscriptions, not proxies, there are none */
+  guint subscriptions;
+  guint64 subscriptions_created;
+  guint64 round_trips;
+  guint64 signals[OFONO_IFACE_LAST];
+  guint64 status_changes;
+  guint64 calls_changes;
+  NuiHistogram call_state_changed;
+  NuiHistogram parse_interfaces;
+  /* CallAdded received to status-changed emitted */
+  NuiHistogram call_added_to_status;
+  /* us from start to the GetModems reply, 0 until there is one */
+  guint64 modems_enumerated;
+  /* main loop time spent on the GetModems reply */
+  NuiHistogram modems_parse;
+} NuiCallMonitorStats;
+
 struct _NuiCallMonitor
 {
   GObject parent;
@@ -46,481 +126,1863 @@ struct _NuiCallMonitorClass
 
 struct _NuiCallMonitorPrivate
 {
-  NuiOfonoManager *manager;
+  /* set once oFono bus is connected and the manager signals subscribed */
+  GDBusConnection *ofono;
+  guint modem_added_id;
+  guint modem_removed_id;
   GHashTable *modems;
   GHashTable *calls;
   guint active;
+  /* last status reported from the context oFono is handled in */
+  gboolean status;
+  guint call_property_changed_id;
+
+  /* oFono name owner tracking */
+  guint ofono_watch_id;
+  gboolean ofono_present;
+  gboolean ofono_lost;
+  /* while set, status changes are held back until the resync is done */
+  gboolean resyncing;
+  guint resync_pending;
+  GCancellable *resync_cancellable;
+  GSource *resync_timeout;
+  GCancellable *cancellable;
+  gint64 start_time;
+
+  /* only touched from the context oFono is handled in */
+  NuiCallMonitorStats stats;
+  GDBusConnection *session_bus;
+  guint stats_id;
+  guint state_id;
+  /* a{sau}, the call state last published on the session bus */
+  GVariant *exported;
+  guint bus_name_id;
+
+  /* threaded mode, oFono is handled in a worker thread running context */
+  gboolean threaded;
+  GMainContext *context;
+  GMainLoop *loop;
+  GThread *thread;
+
+  /* context the monitor was created in, signals are emitted there */
+  GMainContext *owner_context;
+  /* protects the state posted from the worker to the owner context */
+  GMutex lock;
+  gint pending_status;
+  GVariant *snapshot;
+  gboolean snapshot_pending;
+  gboolean post_scheduled;
+  gboolean reported_status;
+  /* (osba{sv}) messages received since the last post */
+  GPtrArray *messages;
+  /* start of the oldest active call, posted together with the snapshot */
+  gint64 active_since;
+
+  /* oFono is not used, events are fed by nui_call_monitor_replay() */
+  gboolean offline;
+  /* owns NUI_BUS_NAME and serves the stats and the call state on it */
+  gboolean export;
+  FILE *trace;
+
   gboolean disposed;
 };
 
 typedef struct _NuiCallMonitorPrivate NuiCallMonitorPrivate;
 
+typedef struct _NuiModem NuiModem;
+
+/* per-call state, all calls share a single PropertyChanged subscription */
+typedef struct
+{
+  NuiModem *modem;
+  gchar *path;
+  /* link in the modem calls queue */
+  GList link;
+  NuiCallState state;
+  /* monotonic time CallAdded was received, 0 once the call is seeded */
+  gint64 added_time;
+  /* monotonic time the call first became active, kept while on hold */
+  gint64 start_time;
+} NuiCall;
+
+struct _NuiModem
+{
+  NuiCallMonitor *monitor;
+  gchar *path;
+  /* NuiCall records of the modem, owned by priv->calls */
+  GQueue calls;
+  guint counts[NUI_CALL_STATE_LAST];
+  guint property_changed_id;
+  /* CallAdded and CallRemoved, set while the modem has a voice call
+   * manager
+   */
+  guint call_added_id;
+  guint call_removed_id;
+  gboolean has_vcm;
+  /* IncomingMessage and ImmediateMessage */
+  guint incoming_message_id;
+  guint immediate_message_id;
+  gboolean has_mm;
+  /* set while the initial GetCalls is in flight */
+  GCancellable *vcm_cancellable;
+  /* voice call manager setup is part of an oFono resync */
+  gboolean resync;
+};
+
 #define PRIVATE(o) \
     ((NuiCallMonitorPrivate *)nui_call_monitor_get_instance_private( \
       (NuiCallMonitor *)(o)))
 
+#define STATS(o) (&PRIVATE(o)->stats)
+
+static void
+_trace(NuiCallMonitor *monitor, const gchar *event, const gchar *path,
+       GVariant *value)
+{
+  FILE *trace = PRIVATE(monitor)->trace;
+  gchar *v;
+
+  if (!trace)
+    return;
+
+  /* one line per event, "time event path value" */
+  if (value)
+  {
+    g_variant_ref_sink(value);
+    v = g_variant_print(value, TRUE);
+    g_variant_unref(value);
+  }
+  else
+    v = NULL;
+
+  fprintf(trace, "%" G_GINT64_FORMAT " %s %s %s\n", g_get_monotonic_time(),
+          event, path ? path : "-", v ? v : "-");
+  fflush(trace);
+  g_free(v);
+}
+
 G_DEFINE_TYPE_WITH_PRIVATE(
   NuiCallMonitor,
   nui_call_monitor,
   G_TYPE_OBJECT
 );
 
+enum
+{
+  PROP_THREADED = 1,
+  PROP_OFFLINE,
+  PROP_EXPORT
+};
+
 enum
 {
   STATUS_CHAGED,
+  CALLS_CHANGED,
+  MESSAGES_RECEIVED,
   LAST_SIGNAL
 };
 
 static guint signals[LAST_SIGNAL] = { 0 };
 
-static void
-_call_state_changed(NuiCallMonitor *monitor, NuiOfonoVoiceCall *proxy,
-                    GVariant *v)
+/* oFono call state names, indexed by NuiCallState */
+static const gchar *call_state_names[NUI_CALL_STATE_LAST] =
 {
-  NuiCallMonitorPrivate *priv = PRIVATE(monitor);
-  const char *state = g_variant_get_string(v, NULL);
-  gint was_active;
-  gint active;
+  NULL,
+  "incoming",
+  "dialing",
+  "alerting",
+  "active",
+  "held",
+  "waiting",
+  "disconnected"
+};
 
-  g_debug("Call state changed %s", state ? state : "unknown");
+static GQuark call_state_quarks[NUI_CALL_STATE_LAST];
 
-  active = !g_strcmp0(state, "active") || !g_strcmp0(state, "held");
-  was_active = GPOINTER_TO_INT(g_object_get_data(G_OBJECT(proxy), "active"));
+#define CALL_STATE_IS_ACTIVE(state) \
+  ((state) == NUI_CALL_STATE_ACTIVE || (state) == NUI_CALL_STATE_HELD)
 
-  if (was_active == -1)
-  {
-    was_active = FALSE;
-    g_object_set_data(G_OBJECT(proxy), "active", GINT_TO_POINTER(active));
-  }
+static NuiCallState
+_call_state_parse(const gchar *state)
+{
+  GQuark q = g_quark_try_string(state);
+  int i;
 
-  if (active != was_active)
+  if (q)
   {
-    if (active)
-    {
-      priv->active++;
-
-      if (priv->active == 1)
-        g_signal_emit(monitor, signals[STATUS_CHAGED], 0, TRUE);
-    }
-    else
+    for (i = 1; i < NUI_CALL_STATE_LAST; i++)
     {
-      priv->active--;
-
-      if (!priv->active)
-        g_signal_emit(monitor, signals[STATUS_CHAGED], 0, FALSE);
+      if (call_state_quarks[i] == q)
+        return i;
     }
-
-    g_object_set_data(G_OBJECT(proxy), "active", GINT_TO_POINTER(active));
   }
+
+  return NUI_CALL_STATE_UNKNOWN;
 }
 
 static void
-_call_property_changed_cb(NuiOfonoVoiceCall *proxy, const gchar *name,
-                          GVariant *value, gpointer user_data)
+_histogram_add(NuiHistogram *h, gint64 start)
 {
-  NuiCallMonitor *monitor = user_data;
+  gint64 usec = g_get_monotonic_time() - start;
+  guint bucket = usec > 0 ? g_bit_storage(usec) : 0;
 
-  if (!strcmp(name, OFONO_VOICE_CALL_PROPERTY_STATE))
-  {
-    GVariant *v = g_variant_get_variant(value);
+  if (bucket >= NUI_HISTOGRAM_BUCKETS)
+    bucket = NUI_HISTOGRAM_BUCKETS - 1;
 
-    g_debug("Call properties changed");
+  h->count++;
+  h->total += usec;
+  h->buckets[bucket]++;
+}
 
-    _call_state_changed(monitor, proxy, v);
-    g_variant_unref(v);
-  }
+static GVariant *
+_histogram_to_variant(NuiHistogram *h)
+{
+  return g_variant_new("(tt@au)", h->count, h->total,
+                       g_variant_new_fixed_array(G_VARIANT_TYPE_UINT32,
+                                                 h->buckets,
+                                                 NUI_HISTOGRAM_BUCKETS,
+                                                 sizeof(h->buckets[0])));
 }
 
-static void
-_call_destroy(gpointer data)
+static GVariant *
+_stats_to_variant(NuiCallMonitor *monitor)
 {
-  NuiOfonoVoiceCall *call = data;
-  NuiCallMonitor *monitor = g_object_get_data(G_OBJECT(call), "monitor");
   NuiCallMonitorPrivate *priv = PRIVATE(monitor);
-  gboolean active;
-
-  g_signal_handlers_disconnect_by_func(
-        G_OBJECT(call), _call_property_changed_cb, monitor);
+  NuiCallMonitorStats *stats = &priv->stats;
+  GVariantBuilder signals;
+  GVariantBuilder builder;
+  int i;
 
-  active = GPOINTER_TO_INT(g_object_get_data(G_OBJECT(call), "active"));
+  g_variant_builder_init(&signals, G_VARIANT_TYPE("a{st}"));
 
-  if (active)
+  for (i = 0; i < OFONO_IFACE_LAST; i++)
   {
-    g_warn_if_fail(priv->active > 0);
+    g_variant_builder_add(&signals, "{st}", ofono_iface_names[i],
+                          stats->signals[i]);
+  }
 
-    if (priv->active)
-    {
-      priv->active--;
+  g_variant_builder_init(&builder, G_VARIANT_TYPE_VARDICT);
+  g_variant_builder_add(&builder, "{sv}", "modems",
+                        g_variant_new_uint32(g_hash_table_size(priv->modems)));
+  g_variant_builder_add(&builder, "{sv}", "calls",
+                        g_variant_new_uint32(g_hash_table_size(priv->calls)));
+  g_variant_builder_add(&builder, "{sv}", "subscriptions",
+                        g_variant_new_uint32(stats->subscriptions));
+  g_variant_builder_add(&builder, "{sv}", "subscriptions-created",
+                        g_variant_new_uint64(stats->subscriptions_created));
+  g_variant_builder_add(&builder, "{sv}", "round-trips",
+                        g_variant_new_uint64(stats->round_trips));
+  g_variant_builder_add(&builder, "{sv}", "signals",
+                        g_variant_builder_end(&signals));
+  g_variant_builder_add(&builder, "{sv}", "status-changes",
+                        g_variant_new_uint64(stats->status_changes));
+  g_variant_builder_add(&builder, "{sv}", "calls-changes",
+                        g_variant_new_uint64(stats->calls_changes));
+  g_variant_builder_add(&builder, "{sv}", "call-state-changed",
+                        _histogram_to_variant(&stats->call_state_changed));
+  g_variant_builder_add(&builder, "{sv}", "parse-interfaces",
+                        _histogram_to_variant(&stats->parse_interfaces));
+  g_variant_builder_add(&builder, "{sv}", "call-added-to-status",
+                        _histogram_to_variant(&stats->call_added_to_status));
+  g_variant_builder_add(&builder, "{sv}", "modems-enumerated",
+                        g_variant_new_uint64(stats->modems_enumerated));
+  g_variant_builder_add(&builder, "{sv}", "modems-parse",
+                        _histogram_to_variant(&stats->modems_parse));
+
+  return g_variant_builder_end(&builder);
+}
 
-      if (!priv->active)
-        g_signal_emit(monitor, signals[STATUS_CHAGED], 0, FALSE);
-    }
+static guint
+_subscribed(NuiCallMonitor *monitor, guint id)
+{
+  if (id)
+  {
+    STATS(monitor)->subscriptions++;
+    STATS(monitor)->subscriptions_created++;
   }
 
-  g_object_unref(call);
+  return id;
 }
 
 static void
-_call_properties_ready_cb(GObject *object, GAsyncResult *res,
-                          gpointer user_data)
+_unsubscribe(NuiCallMonitor *monitor, guint *id)
 {
-  NuiCallMonitor *monitor = user_data;
-  NuiOfonoVoiceCall *call = NUI_OFONO_VOICE_CALL(object);
-  GVariant *properties;
-  GError *error = NULL;
+  if (!*id)
+    return;
 
-  if (nui_ofono_voice_call_call_get_properties_finish(call, &properties, res,
-                                                      &error))
-  {
-    if (GPOINTER_TO_INT(g_object_get_data(G_OBJECT(call), "active")) == -1)
-    {
-      GVariant *v = g_variant_lookup_value(properties,
-                                           OFONO_VOICE_CALL_PROPERTY_STATE,
-                                           NULL);
-      if (v)
-      {
-        _call_state_changed(monitor, call, v);
-        g_variant_unref(v);
-      }
-    }
+  g_dbus_connection_signal_unsubscribe(PRIVATE(monitor)->ofono, *id);
+  STATS(monitor)->subscriptions--;
+  *id = 0;
+}
 
-    g_variant_unref(properties);
+static void
+_stats_method_call(GDBusConnection *connection, const gchar *sender,
+                   const gchar *path, const gchar *interface,
+                   const gchar *method, GVariant *parameters,
+                   GDBusMethodInvocation *invocation, gpointer user_data)
+{
+  if (!g_strcmp0(method, "GetStats"))
+  {
+    g_dbus_method_invocation_return_value(
+          invocation, g_variant_new("(@a{sv})", _stats_to_variant(user_data)));
   }
   else
   {
-    g_warning("Error getting OFONO voice call properties [%s]", error->message);
-    g_error_free(error);
+    g_dbus_method_invocation_return_error(
+          invocation, G_DBUS_ERROR, G_DBUS_ERROR_UNKNOWN_METHOD,
+          "Unknown method %s", method);
   }
-
-  g_object_unref(monitor);
 }
 
-static void
-_call_ready_cb(GObject *object, GAsyncResult *res, gpointer user_data)
+static const GDBusInterfaceVTable stats_vtable =
 {
-  NuiCallMonitor *monitor = user_data;
-  NuiCallMonitorPrivate *priv = PRIVATE(monitor);
-  NuiOfonoVoiceCall *call;
-  GError *error = NULL;
+  _stats_method_call,
+  NULL,
+  NULL
+};
 
-  call = nui_ofono_voice_call_proxy_new_for_bus_finish(res, &error);
+static GVariant *_calls_snapshot(NuiCallMonitor *monitor);
 
-  if (call)
-  {
-    gchar *path;
+static GVariant *
+_state_get_counts(GVariant *modems)
+{
+  guint32 counts[NUI_CALL_STATE_LAST] = { 0 };
+  GVariantIter i;
+  GVariant *v;
 
-    g_object_get(G_OBJECT(call), "g-object-path", &path, NULL);
-    g_object_set_data(G_OBJECT(call), "monitor", monitor);
-    g_hash_table_insert(priv->calls, path, call);
-    g_signal_connect(call, "property-changed",
-                     G_CALLBACK(_call_property_changed_cb), monitor);
-    /* in case property-changed is emitted while we are wating for the
-     * get_properties async call
-     */
-    g_object_set_data(G_OBJECT(call), "active", GINT_TO_POINTER(-1));
-    nui_ofono_voice_call_call_get_properties(
-          call, NULL, _call_properties_ready_cb, monitor);
-  }
-  else
+  g_variant_iter_init(&i, modems);
+
+  while (g_variant_iter_loop(&i, "{&s@au}", NULL, &v))
   {
-    g_warning("Error creating OFONO voice call proxy [%s]", error->message);
-    g_error_free(error);
-    g_object_unref(monitor);
+    const guint32 *modem_counts;
+    gsize n;
+    gsize j;
+
+    modem_counts = g_variant_get_fixed_array(v, &n, sizeof(guint32));
+
+    for (j = 0; j < n && j < NUI_CALL_STATE_LAST; j++)
+      counts[j] += modem_counts[j];
   }
+
+  return g_variant_new_fixed_array(G_VARIANT_TYPE_UINT32, counts,
+                                   NUI_CALL_STATE_LAST, sizeof(counts[0]));
 }
 
-static void
-_vcm_call_added_cb(NuiOfonoVoiceCallManager *proxy, const gchar *path,
-                   GVariant *properties, gpointer user_data)
+static GVariant *
+_state_get_active(GVariant *counts)
 {
-  NuiCallMonitor *monitor = user_data;
+  const guint32 *c;
+  gsize n;
 
-  g_debug("call added %s", path);
+  c = g_variant_get_fixed_array(counts, &n, sizeof(guint32));
+  g_return_val_if_fail(n == NUI_CALL_STATE_LAST, NULL);
 
-  nui_ofono_voice_call_proxy_new_for_bus(
-        OFONO_BUS_TYPE, G_DBUS_PROXY_FLAGS_DO_NOT_LOAD_PROPERTIES,
-        OFONO_SERVICE, path, NULL, _call_ready_cb, g_object_ref(monitor));
+  return g_variant_new_boolean(c[NUI_CALL_STATE_ACTIVE] ||
+                               c[NUI_CALL_STATE_HELD]);
 }
 
-static void
-_vcm_call_removed_cb(NuiOfonoVoiceCallManager *proxy, const gchar *path,
-                     gpointer user_data)
+static GVariant *
+_state_get_property(GDBusConnection *connection, const gchar *sender,
+                    const gchar *path, const gchar *interface,
+                    const gchar *property, GError **error, gpointer user_data)
 {
-  NuiCallMonitor *monitor = user_data;
-  NuiCallMonitorPrivate *priv = PRIVATE(monitor);
+  NuiCallMonitorPrivate *priv = PRIVATE(user_data);
+  GVariant *counts;
+  GVariant *active;
 
-  g_debug("call removed %s", path);
+  if (!g_strcmp0(property, "Modems"))
+    return g_variant_ref(priv->exported);
 
-  g_hash_table_remove(priv->calls, path);
-}
+  counts = _state_get_counts(priv->exported);
 
-static void
-_vcm_destroy(gpointer data)
-{
-  NuiOfonoVoiceCallManager *vcm = data;
-  NuiCallMonitor *monitor = g_object_get_data(G_OBJECT(vcm), "monitor");
+  if (!g_strcmp0(property, "Counts"))
+    return counts;
+
+  g_variant_ref_sink(counts);
+  active = _state_get_active(counts);
+  g_variant_unref(counts);
 
-  g_signal_handlers_disconnect_by_func(
-        G_OBJECT(vcm), _vcm_call_added_cb, monitor);
-  g_signal_handlers_disconnect_by_func(
-        G_OBJECT(vcm), _vcm_call_removed_cb, monitor);
-  g_object_unref(vcm);
+  return active;
 }
 
+static const GDBusInterfaceVTable state_vtable =
+{
+  NULL,
+  _state_get_property,
+  NULL
+};
+
+/* publishes the new state, unless nothing has changed */
 static void
-_modem_parse_interfaces(NuiCallMonitor *monitor, NuiOfonoModem *modem,
-                        GVariant *interfaces)
+_state_export(NuiCallMonitor *monitor, GVariant *snapshot)
 {
-  GVariantIter i;
-  const gchar *iface;
-  gboolean has_vcm = FALSE;
+  NuiCallMonitorPrivate *priv = PRIVATE(monitor);
+  GVariantBuilder changed;
+  GVariant *counts;
+  GError *error = NULL;
 
-  g_variant_iter_init(&i, interfaces);
+  if (!priv->state_id || g_variant_equal(priv->exported, snapshot))
+    return;
 
-  while (g_variant_iter_loop(&i, "s", &iface))
+  g_variant_unref(priv->exported);
+  priv->exported = g_variant_ref(snapshot);
+
+  counts = g_variant_ref_sink(_state_get_counts(snapshot));
+
+  g_variant_builder_init(&changed, G_VARIANT_TYPE_VARDICT);
+  g_variant_builder_add(&changed, "{sv}", "Modems", snapshot);
+  g_variant_builder_add(&changed, "{sv}", "Counts", counts);
+  g_variant_builder_add(&changed, "{sv}", "Active",
+                        _state_get_active(counts));
+  g_variant_unref(counts);
+
+  if (!g_dbus_connection_emit_signal(
+        priv->session_bus, NULL, NUI_CALL_STATE_PATH,
+        "org.freedesktop.DBus.Properties", "PropertiesChanged",
+        g_variant_new("(s@a{sv}@as)", NUI_CALL_STATE_INTERFACE_NAME,
+                      g_variant_builder_end(&changed),
+                      g_variant_new_strv(NULL, 0)),
+        &error))
   {
-    if (!strcmp(iface, OFONO_VOICECALL_MANAGER_INTERFACE_NAME))
-    {
-      has_vcm = TRUE;
-      break;
-    }
+    g_warning("Error emitting call state change [%s]", error->message);
+    g_error_free(error);
   }
+}
 
-  if (has_vcm)
-  {
-    if (!g_object_get_data(G_OBJECT(modem), "vcm"))
-    {
-      gchar *path;
-      GError *error = NULL;
-      NuiOfonoVoiceCallManager *vcm;
+static void
+_session_bus_ready_cb(GObject *object, GAsyncResult *res, gpointer user_data)
+{
+  NuiCallMonitor *monitor;
+  NuiCallMonitorPrivate *priv;
+  GDBusConnection *connection;
+  GDBusNodeInfo *info;
+  GError *error = NULL;
 
-      g_object_get(G_OBJECT(modem), "g-object-path", &path, NULL);
+  connection = g_bus_get_finish(res, &error);
 
-      g_return_if_fail(path != NULL);
+  if (!connection)
+  {
+    if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+      g_warning("Error getting session bus [%s]", error->message);
 
-      vcm = nui_ofono_voice_call_manager_proxy_new_for_bus_sync(
-            OFONO_BUS_TYPE, G_DBUS_PROXY_FLAGS_DO_NOT_LOAD_PROPERTIES,
-            OFONO_SERVICE, path, NULL, &error);
+    g_error_free(error);
+    return;
+  }
 
-      if (error)
-      {
-        g_warning("Error creating OFONO voice call manager proxy for %s [%s]",
-                  path, error->message);
-        g_error_free(error);
-      }
+  monitor = user_data;
+  priv = PRIVATE(monitor);
+  priv->session_bus = connection;
 
-      g_free(path);
+  info = g_dbus_node_info_new_for_xml(introspection_xml, NULL);
+  priv->stats_id = g_dbus_connection_register_object(
+        connection, NUI_CALL_MONITOR_PATH,
+        g_dbus_node_info_lookup_interface(
+          info, NUI_CALL_MONITOR_STATS_INTERFACE_NAME),
+        &stats_vtable, monitor, NULL, &error);
 
-      if (vcm)
-      {
-        g_object_set_data_full(G_OBJECT(modem), "vcm", vcm, _vcm_destroy);
-        g_object_set_data(G_OBJECT(vcm), "monitor", monitor);
-        g_signal_connect(vcm, "call-added",
-                         G_CALLBACK(_vcm_call_added_cb), monitor);
-        g_signal_connect(vcm, "call-removed",
-                         G_CALLBACK(_vcm_call_removed_cb), monitor);
-      }
-    }
+  if (!priv->stats_id)
+  {
+    g_warning("Error registering call monitor stats [%s]", error->message);
+    g_clear_error(&error);
   }
-  else
-    g_object_set_data(G_OBJECT(modem), "vcm", NULL);
-}
 
-static void
-_modem_property_changed_cb(NuiOfonoModem *proxy, const gchar *name,
-                           GVariant *value, gpointer user_data)
-{
-  if (!strcmp(name, OFONO_MODEM_PROPERTY_INTERFACES))
-  {
-    GVariant *v = g_variant_get_variant(value);
+  priv->exported = g_variant_ref_sink(_calls_snapshot(monitor));
+  priv->state_id = g_dbus_connection_register_object(
+        connection, NUI_CALL_STATE_PATH,
+        g_dbus_node_info_lookup_interface(
+          info, NUI_CALL_STATE_INTERFACE_NAME),
+        &state_vtable, monitor, NULL, &error);
 
-    _modem_parse_interfaces(user_data, proxy, v);
-    g_variant_unref(v);
+  if (!priv->state_id)
+  {
+    g_warning("Error registering call state [%s]", error->message);
+    g_clear_error(&error);
   }
+
+  g_dbus_node_info_unref(info);
+
+  priv->bus_name_id = g_bus_own_name_on_connection(
+        connection, NUI_BUS_NAME, G_BUS_NAME_OWNER_FLAGS_NONE,
+        NULL, NULL, NULL, NULL);
 }
 
-static void
-_modem_add(NuiCallMonitor *monitor, const gchar *path, GVariant *properties)
+static gboolean
+_post_pending_cb(gpointer user_data)
 {
-  GError *error = NULL;
+  NuiCallMonitor *monitor = user_data;
   NuiCallMonitorPrivate *priv = PRIVATE(monitor);
-  NuiOfonoModem *proxy;
+  GVariant *snapshot = NULL;
+  GVariant *messages = NULL;
+  gint status;
 
-  if (g_hash_table_lookup(priv->modems, path))
-    return;
+  g_mutex_lock(&priv->lock);
 
-  g_debug("Adding modem %s", path);
+  status = priv->pending_status;
+  priv->pending_status = -1;
 
-  proxy = nui_ofono_modem_proxy_new_for_bus_sync(
-          OFONO_BUS_TYPE, G_DBUS_PROXY_FLAGS_DO_NOT_LOAD_PROPERTIES,
-          OFONO_SERVICE, path, NULL, &error);
+  if (priv->messages->len)
+  {
+    messages = g_variant_ref_sink(g_variant_new_array(
+          G_VARIANT_TYPE("(osba{sv})"), (GVariant **)priv->messages->pdata,
+          priv->messages->len));
+    g_ptr_array_set_size(priv->messages, 0);
+  }
 
-  if (proxy)
+  if (priv->snapshot_pending)
   {
-    GVariantIter i;
-    GVariant *v;
-    const gchar *name;
+    snapshot = g_variant_ref(priv->snapshot);
+    priv->snapshot_pending = FALSE;
+  }
 
-    g_hash_table_insert(priv->modems, g_strdup(path), proxy);
-    g_variant_iter_init(&i, properties);
+  priv->post_scheduled = FALSE;
 
-    while (g_variant_iter_loop(&i, "{&sv}", &name, &v))
+  g_mutex_unlock(&priv->lock);
+
+  if (!priv->disposed)
+  {
+    if (status != -1 && status != priv->reported_status)
     {
-      if (!strcmp(name, OFONO_MODEM_PROPERTY_INTERFACES))
-        _modem_parse_interfaces(monitor, proxy, v);
+      priv->reported_status = status;
+      g_signal_emit(monitor, signals[STATUS_CHAGED], 0, status);
     }
 
-    g_signal_connect(proxy, "property-changed",
-                     G_CALLBACK(_modem_property_changed_cb), monitor);
-  }
-  else
-  {
-    g_warning("Error creating OFONO modem %s proxy [%s]", path,
-              error->message);
-    g_error_free(error);
+    if (snapshot)
+      g_signal_emit(monitor, signals[CALLS_CHANGED], 0, snapshot);
+
+    if (messages)
+      g_signal_emit(monitor, signals[MESSAGES_RECEIVED], 0, messages);
   }
+
+  if (snapshot)
+    g_variant_unref(snapshot);
+
+  if (messages)
+    g_variant_unref(messages);
+
+  return G_SOURCE_REMOVE;
 }
 
+/* called with priv->lock held, from the context oFono is handled in */
 static void
-_modem_added_cb(NuiOfonoManager *manager, const gchar *path,
-                GVariant *properties, gpointer user_data)
+_post_pending(NuiCallMonitor *monitor)
 {
-  _modem_add(user_data, path, properties);
+  NuiCallMonitorPrivate *priv = PRIVATE(monitor);
+  GSource *source;
+
+  /* the tables are being dropped, a ref taken now would never be released
+   * if the owner context does not run again
+   */
+  if (priv->post_scheduled || priv->disposed)
+    return;
+
+  priv->post_scheduled = TRUE;
+
+  source = g_idle_source_new();
+  g_source_set_priority(source, G_PRIORITY_DEFAULT);
+  g_source_set_callback(source, _post_pending_cb, g_object_ref(monitor),
+                        g_object_unref);
+  g_source_attach(source, priv->owner_context);
+  g_source_unref(source);
 }
 
 static void
-_modem_removed_cb(NuiOfonoManager *manager, const gchar *path,
-                  gpointer user_data)
+_status_changed(NuiCallMonitor *monitor, gboolean active)
 {
-  NuiCallMonitor *monitor = user_data;
   NuiCallMonitorPrivate *priv = PRIVATE(monitor);
-  NuiOfonoModem *proxy;
-  GHashTableIter iter;
-  gpointer key, value;
 
-  g_debug("Modem %s removed", path);
+  /* calls going away with the monitor are not a status change */
+  if (priv->resyncing || priv->disposed || priv->status == active)
+    return;
 
-  g_hash_table_iter_init (&iter, priv->calls);
+  priv->status = active;
+  priv->stats.status_changes++;
 
-  while (g_hash_table_iter_next (&iter, &key, &value))
+  if (priv->threaded)
   {
-    if (g_str_has_prefix(key, path))
-      g_hash_table_iter_remove(&iter);
+    g_mutex_lock(&priv->lock);
+    priv->pending_status = active;
+    _post_pending(monitor);
+    g_mutex_unlock(&priv->lock);
   }
+  else
+    g_signal_emit(monitor, signals[STATUS_CHAGED], 0, active);
+}
+
+static gint
+_modem_path_cmp(gconstpointer a, gconstpointer b)
+{
+  return strcmp((*(NuiModem **)a)->path, (*(NuiModem **)b)->path);
+}
+
+/* modems are sorted by path, so equal states give equal snapshots no matter
+ * how the hash table happens to be laid out
+ */
+static GVariant *
+_calls_snapshot(NuiCallMonitor *monitor)
+{
+  NuiCallMonitorPrivate *priv = PRIVATE(monitor);
+  GVariantBuilder builder;
+  NuiModem **modems;
+  guint len;
+  guint i;
 
-  proxy = g_hash_table_lookup(priv->modems, path);
+  modems = (NuiModem **)g_hash_table_get_values_as_array(priv->modems, &len);
+  qsort(modems, len, sizeof(modems[0]), _modem_path_cmp);
 
-  if (proxy)
+  g_variant_builder_init(&builder, G_VARIANT_TYPE("a{sau}"));
+
+  /* counts are indexed by NuiCallState, their order is fixed already */
+  for (i = 0; i < len; i++)
   {
-    g_signal_handlers_disconnect_by_func(G_OBJECT(proxy),
-                                         _modem_property_changed_cb, monitor);
+    GVariant *counts = g_variant_new_fixed_array(
+          G_VARIANT_TYPE_UINT32, modems[i]->counts, NUI_CALL_STATE_LAST,
+          sizeof(modems[i]->counts[0]));
 
-    g_hash_table_remove(priv->modems, path);
+    g_variant_builder_add(&builder, "{s@au}", modems[i]->path, counts);
   }
+
+  g_free(modems);
+
+  return g_variant_builder_end(&builder);
 }
 
-static void
-_modems_ready_cb(GObject *object, GAsyncResult *res, gpointer user_data)
+static gint64
+_calls_active_since(NuiCallMonitor *monitor)
 {
-  NuiCallMonitor *monitor = user_data;
-  NuiOfonoManager *proxy = NUI_OFONO_MANAGER(object);
-  GVariant *modems;
-  GError *error = NULL;
-
-  if (nui_ofono_manager_call_get_modems_finish(proxy, &modems, res, &error))
-  {
-    GVariantIter i;
-    GVariant *properties;
-    const gchar *path;
+  NuiCallMonitorPrivate *priv = PRIVATE(monitor);
+  GHashTableIter iter;
+  NuiCall *call;
+  gint64 since = 0;
 
-    g_variant_iter_init(&i, modems);
+  if (!priv->active)
+    return 0;
 
-    while (g_variant_iter_loop(&i, "(&o@a{sv})", &path, &properties))
-      _modem_add(monitor, path, properties);
+  g_hash_table_iter_init(&iter, priv->calls);
 
-    g_variant_unref(modems);
-  }
-  else
+  while (g_hash_table_iter_next(&iter, NULL, (gpointer *)&call))
   {
-    g_warning("Error getting OFONO modems [%s]", error->message);
-    g_error_free(error);
+    if (CALL_STATE_IS_ACTIVE(call->state) && call->start_time &&
+        (!since || call->start_time < since))
+    {
+      since = call->start_time;
+    }
   }
 
-  g_object_unref(monitor);
+  return since;
 }
 
 static void
-_manager_ready_cb(GObject *object, GAsyncResult *res, gpointer user_data)
+_calls_changed(NuiCallMonitor *monitor)
 {
-  NuiCallMonitor *monitor = user_data;
   NuiCallMonitorPrivate *priv = PRIVATE(monitor);
-  GError *error = NULL;
+  GVariant *snapshot;
+  gint64 since;
+
+  if (priv->resyncing || priv->disposed)
+    return;
 
-  priv->manager = nui_ofono_manager_proxy_new_for_bus_finish(res, &error);
+  since = _calls_active_since(monitor);
 
-  if (priv->manager)
+  /* only the final state is handed over to the owner context */
+  if (priv->threaded)
   {
-    g_signal_connect(priv->manager, "modem-added",
-                     G_CALLBACK(_modem_added_cb), monitor);
-    g_signal_connect(priv->manager, "modem-removed",
-                     G_CALLBACK(_modem_removed_cb), monitor);
+    priv->stats.calls_changes++;
+    snapshot = g_variant_ref_sink(_calls_snapshot(monitor));
+    _state_export(monitor, snapshot);
 
-    nui_ofono_manager_call_get_modems(priv->manager, NULL,
-                                      _modems_ready_cb, monitor);
+    g_mutex_lock(&priv->lock);
+
+    if (priv->snapshot)
+      g_variant_unref(priv->snapshot);
+
+    priv->snapshot = snapshot;
+    priv->snapshot_pending = TRUE;
+    priv->active_since = since;
+    _post_pending(monitor);
+
+    g_mutex_unlock(&priv->lock);
+
+    return;
   }
-  else
+
+  priv->active_since = since;
+
+  if (!priv->state_id &&
+      !g_signal_has_handler_pending(monitor, signals[CALLS_CHANGED], 0, TRUE))
   {
-    g_warning("Error creating OFONO manager [%s]", error->message);
-    g_error_free(error);
-    g_object_unref(monitor);
+    return;
   }
+
+  priv->stats.calls_changes++;
+  snapshot = g_variant_ref_sink(_calls_snapshot(monitor));
+  _state_export(monitor, snapshot);
+  g_signal_emit(monitor, signals[CALLS_CHANGED], 0, snapshot);
+  g_variant_unref(snapshot);
 }
 
 static void
-nui_call_monitor_init(NuiCallMonitor *monitor)
+_call_state_apply(NuiCallMonitor *monitor, NuiCall *call, GVariant *v)
 {
   NuiCallMonitorPrivate *priv = PRIVATE(monitor);
+  const char *name = g_variant_get_string(v, NULL);
+  NuiCallState state;
+  gboolean active;
 
-  priv->modems = g_hash_table_new_full(
-        g_str_hash, g_str_equal, g_free, g_object_unref);
-  priv->calls = g_hash_table_new_full(
-        g_str_hash, g_str_equal, g_free, _call_destroy);
+  g_debug("Call state changed %s", name ? name : "unknown");
 
-  nui_ofono_manager_proxy_new_for_bus(
-        OFONO_BUS_TYPE, G_DBUS_PROXY_FLAGS_DO_NOT_LOAD_PROPERTIES,
-        OFONO_SERVICE, "/", NULL, _manager_ready_cb, g_object_ref(monitor));
-}
+  state = _call_state_parse(name);
 
-static void
-nui_call_monitor_dispose(GObject *object)
-{
-  NuiCallMonitorPrivate *priv = PRIVATE(object);
+  if (state == call->state)
+    return;
 
-  if (!priv->disposed)
-  {
-    g_hash_table_unref(priv->calls);
-    g_hash_table_unref(priv->modems);
+  call->modem->counts[call->state]--;
+  call->modem->counts[state]++;
 
-    if (priv->manager)
-    {
-      g_signal_handlers_disconnect_by_func(G_OBJECT(priv->manager),
-                                           _modem_added_cb, object);
-      g_signal_handlers_disconnect_by_func(G_OBJECT(priv->manager),
-                                           _modem_removed_cb, object);
-      g_object_unref(priv->manager);
-    }
+  active = CALL_STATE_IS_ACTIVE(state);
 
-    priv->disposed = TRUE;
-    G_OBJECT_CLASS(nui_call_monitor_parent_class)->dispose(object);
-  }
-}
+  if (state == NUI_CALL_STATE_ACTIVE && !call->start_time)
+    call->start_time = g_get_monotonic_time();
 
-static void
-nui_call_monitor_class_init(NuiCallMonitorClass *klass)
-{
+  if (active != CALL_STATE_IS_ACTIVE(call->state))
+  {
+    if (active)
+    {
+      priv->active++;
+
+      if (priv->active == 1)
+      {
+        _status_changed(monitor, TRUE);
+
+        if (call->added_time)
+        {
+          g_debug("CallAdded to status-changed latency %" G_GINT64_FORMAT
+                  " us", g_get_monotonic_time() - call->added_time);
+          _histogram_add(&priv->stats.call_added_to_status, call->added_time);
+        }
+      }
+    }
+    else
+    {
+      priv->active--;
+
+      if (!priv->active)
+        _status_changed(monitor, FALSE);
+    }
+  }
+
+  call->state = state;
+}
+
+static void
+_call_state_changed(NuiCallMonitor *monitor, NuiCall *call, GVariant *v)
+{
+  gint64 start = g_get_monotonic_time();
+
+  _call_state_apply(monitor, call, v);
+  _histogram_add(&STATS(monitor)->call_state_changed, start);
+}
+
+static void
+_call_property_changed_cb(GDBusConnection *connection, const gchar *sender,
+                          const gchar *path, const gchar *interface,
+                          const gchar *signal, GVariant *parameters,
+                          gpointer user_data)
+{
+  NuiCallMonitor *monitor = user_data;
+  NuiCallMonitorPrivate *priv = PRIVATE(monitor);
+  NuiCall *call;
+  const gchar *name;
+  GVariant *v;
+
+  priv->stats.signals[OFONO_IFACE_VOICECALL]++;
+  _trace(monitor, "CallPropertyChanged", path, parameters);
+
+  call = g_hash_table_lookup(priv->calls, path);
+
+  if (!call)
+    return;
+
+  g_variant_get(parameters, "(&sv)", &name, &v);
+
+  if (!strcmp(name, OFONO_VOICE_CALL_PROPERTY_STATE))
+  {
+    g_debug("Call %s properties changed", path);
+
+    _call_state_changed(monitor, call, v);
+    _calls_changed(monitor);
+  }
+
+  g_variant_unref(v);
+}
+
+static void
+_call_destroy(gpointer data)
+{
+  NuiCall *call = data;
+  NuiCallMonitor *monitor = call->modem->monitor;
+  NuiCallMonitorPrivate *priv = PRIVATE(monitor);
+
+  g_queue_unlink(&call->modem->calls, &call->link);
+  call->modem->counts[call->state]--;
+
+  if (CALL_STATE_IS_ACTIVE(call->state))
+  {
+    g_warn_if_fail(priv->active > 0);
+
+    if (priv->active)
+    {
+      priv->active--;
+
+      if (!priv->active)
+        _status_changed(monitor, FALSE);
+    }
+  }
+
+  g_free(call->path);
+  g_slice_free(NuiCall, call);
+}
+
+static void
+_call_add(NuiModem *modem, const gchar *path, GVariant *properties)
+{
+  NuiCallMonitor *monitor = modem->monitor;
+  NuiCallMonitorPrivate *priv = PRIVATE(monitor);
+  NuiCall *call;
+  GVariant *v;
+
+  if (g_hash_table_lookup(priv->calls, path))
+    return;
+
+  call = g_slice_new0(NuiCall);
+  call->modem = modem;
+  call->path = g_strdup(path);
+  call->link.data = call;
+  call->added_time = g_get_monotonic_time();
+  g_queue_push_tail_link(&modem->calls, &call->link);
+  modem->counts[NUI_CALL_STATE_UNKNOWN]++;
+  g_hash_table_insert(priv->calls, call->path, call);
+
+  /* oFono sends all the call properties along, no need to ask for them */
+  v = g_variant_lookup_value(properties, OFONO_VOICE_CALL_PROPERTY_STATE,
+                             G_VARIANT_TYPE_STRING);
+
+  if (v)
+  {
+    _call_state_changed(monitor, call, v);
+    g_variant_unref(v);
+  }
+
+  call->added_time = 0;
+}
+
+static void
+_vcm_call_added_cb(const gchar *path, GVariant *properties,
+                   gpointer user_data)
+{
+  NuiModem *modem = user_data;
+
+  STATS(modem->monitor)->signals[OFONO_IFACE_VOICECALL_MANAGER]++;
+
+  if (PRIVATE(modem->monitor)->trace)
+  {
+    _trace(modem->monitor, "CallAdded", modem->path,
+           g_variant_new("(o@a{sv})", path, properties));
+  }
+
+  g_debug("call added %s", path);
+
+  _call_add(modem, path, properties);
+  _calls_changed(modem->monitor);
+}
+
+static void
+_vcm_call_removed_cb(const gchar *path, gpointer user_data)
+{
+  NuiModem *modem = user_data;
+
+  STATS(modem->monitor)->signals[OFONO_IFACE_VOICECALL_MANAGER]++;
+
+  if (PRIVATE(modem->monitor)->trace)
+  {
+    _trace(modem->monitor, "CallRemoved", modem->path,
+           g_variant_new("(o)", path));
+  }
+
+  g_debug("call removed %s", path);
+
+  if (g_hash_table_remove(PRIVATE(modem->monitor)->calls, path))
+    _calls_changed(modem->monitor);
+}
+
+static gboolean
+_modem_remove_calls(NuiModem *modem)
+{
+  NuiCallMonitorPrivate *priv = PRIVATE(modem->monitor);
+  NuiCall *call;
+
+  if (g_queue_is_empty(&modem->calls))
+    return FALSE;
+
+  /* record destroy unlinks the call from the modem queue */
+  while ((call = g_queue_peek_head(&modem->calls)))
+    g_hash_table_remove(priv->calls, call->path);
+
+  return TRUE;
+}
+
+static void
+_resync_timeout_remove(NuiCallMonitor *monitor)
+{
+  NuiCallMonitorPrivate *priv = PRIVATE(monitor);
+
+  if (priv->resync_timeout)
+  {
+    g_source_destroy(priv->resync_timeout);
+    g_source_unref(priv->resync_timeout);
+    priv->resync_timeout = NULL;
+  }
+}
+
+static void
+_resync_finish(NuiCallMonitor *monitor)
+{
+  NuiCallMonitorPrivate *priv = PRIVATE(monitor);
+
+  g_debug("OFONO resync done, %u active calls", priv->active);
+
+  _resync_timeout_remove(monitor);
+  priv->resyncing = FALSE;
+  _status_changed(monitor, priv->active > 0);
+  _calls_changed(monitor);
+}
+
+static void
+_resync_step_done(NuiCallMonitor *monitor)
+{
+  NuiCallMonitorPrivate *priv = PRIVATE(monitor);
+
+  g_return_if_fail(priv->resync_pending > 0);
+
+  priv->resync_pending--;
+
+  if (!priv->resync_pending && !priv->ofono_lost)
+    _resync_finish(monitor);
+}
+
+static void
+_modem_resync_done(NuiModem *modem)
+{
+  if (modem->resync)
+  {
+    modem->resync = FALSE;
+    _resync_step_done(modem->monitor);
+  }
+}
+
+static void
+_vcm_destroy(NuiModem *modem)
+{
+  if (modem->vcm_cancellable)
+  {
+    g_cancellable_cancel(modem->vcm_cancellable);
+    g_clear_object(&modem->vcm_cancellable);
+  }
+
+  _unsubscribe(modem->monitor, &modem->call_added_id);
+  _unsubscribe(modem->monitor, &modem->call_removed_id);
+  modem->has_vcm = FALSE;
+}
+
+static void
+_vcm_calls_parse(NuiModem *modem, GVariant *calls)
+{
+  GVariantIter i;
+  GVariant *properties;
+  const gchar *path;
+
+  _trace(modem->monitor, "GetCalls", modem->path, calls);
+
+  g_variant_iter_init(&i, calls);
+
+  while (g_variant_iter_loop(&i, "(&o@a{sv})", &path, &properties))
+  {
+    g_debug("call found %s", path);
+    _call_add(modem, path, properties);
+  }
+
+  _calls_changed(modem->monitor);
+  _modem_resync_done(modem);
+}
+
+static void
+_vcm_calls_ready_cb(GObject *object, GAsyncResult *res, gpointer user_data)
+{
+  NuiModem *modem;
+  GVariant *calls;
+  GError *error = NULL;
+
+  calls = nui_ofono_get_objects_finish(G_DBUS_CONNECTION(object), res,
+                                       &error);
+
+  if (!calls)
+  {
+    if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+    {
+      g_warning("Error getting OFONO voice calls [%s]", error->message);
+      modem = user_data;
+      _trace(modem->monitor, "GetCallsError", modem->path,
+             g_variant_new_string(error->message));
+      g_clear_object(&modem->vcm_cancellable);
+      _modem_resync_done(modem);
+    }
+
+    g_error_free(error);
+    return;
+  }
+
+  modem = user_data;
+  g_clear_object(&modem->vcm_cancellable);
+  _vcm_calls_parse(modem, calls);
+  g_variant_unref(calls);
+}
+
+static void
+_vcm_subscribe(NuiModem *modem)
+{
+  GDBusConnection *ofono = PRIVATE(modem->monitor)->ofono;
+
+  modem->has_vcm = TRUE;
+
+  /* offline, calls come from the trace being replayed */
+  if (!ofono)
+    return;
+
+  modem->call_added_id = _subscribed(
+        modem->monitor,
+        nui_ofono_subscribe_object_added(
+          ofono, modem->path, NUI_OFONO_VOICECALL_MANAGER_INTERFACE_NAME,
+          "CallAdded", _vcm_call_added_cb, modem));
+  modem->call_removed_id = _subscribed(
+        modem->monitor,
+        nui_ofono_subscribe_object_removed(
+          ofono, modem->path, NUI_OFONO_VOICECALL_MANAGER_INTERFACE_NAME,
+          "CallRemoved", _vcm_call_removed_cb, modem));
+
+  /* pick up the calls that are already there, signals take it from here */
+  modem->vcm_cancellable = g_cancellable_new();
+  STATS(modem->monitor)->round_trips++;
+  nui_ofono_get_objects(ofono, modem->path,
+                        NUI_OFONO_VOICECALL_MANAGER_INTERFACE_NAME,
+                        "GetCalls", modem->vcm_cancellable,
+                        _vcm_calls_ready_cb, modem);
+}
+
+/* traces get shared, only the shape of the message is kept: a body of the
+ * same length and a sender that is the same for the same number
+ */
+static GVariant *
+_mm_message_redact(const gchar *message, GVariant *info)
+{
+  GVariantDict dict;
+  const gchar *sender;
+  gchar *body;
+  GVariant *v;
+
+  g_variant_dict_init(&dict, info);
+
+  if (g_variant_dict_lookup(&dict, "Sender", "&s", &sender))
+  {
+    gchar *checksum = g_compute_checksum_for_string(G_CHECKSUM_SHA256, sender,
+                                                    -1);
+
+    checksum[8] = 0;
+    g_variant_dict_insert(&dict, "Sender", "s", checksum);
+    g_free(checksum);
+  }
+
+  body = g_strnfill(g_utf8_strlen(message, -1), 'x');
+  v = g_variant_new("(s@a{sv})", body, g_variant_dict_end(&dict));
+  g_free(body);
+
+  return v;
+}
+
+static void
+_mm_message(NuiModem *modem, const gchar *message, GVariant *info,
+            gboolean immediate)
+{
+  NuiCallMonitor *monitor = modem->monitor;
+  NuiCallMonitorPrivate *priv = PRIVATE(monitor);
+  GVariant *v;
+
+  STATS(monitor)->signals[OFONO_IFACE_MESSAGE_MANAGER]++;
+
+  if (priv->trace)
+  {
+    _trace(monitor, immediate ? "ImmediateMessage" : "IncomingMessage",
+           modem->path, _mm_message_redact(message, info));
+  }
+
+  v = g_variant_ref_sink(
+        g_variant_new("(osb@a{sv})", modem->path, message, immediate, info));
+
+  /* messages come in bursts, they are handed over once per main loop
+   * iteration of the owner context
+   */
+  g_mutex_lock(&priv->lock);
+  g_ptr_array_add(priv->messages, v);
+  _post_pending(monitor);
+  g_mutex_unlock(&priv->lock);
+}
+
+static void
+_mm_incoming_message_cb(const gchar *path, const gchar *message,
+                        GVariant *info, gpointer user_data)
+{
+  _mm_message(user_data, message, info, FALSE);
+}
+
+static void
+_mm_immediate_message_cb(const gchar *path, const gchar *message,
+                         GVariant *info, gpointer user_data)
+{
+  _mm_message(user_data, message, info, TRUE);
+}
+
+static void
+_mm_subscribe(NuiModem *modem)
+{
+  GDBusConnection *ofono = PRIVATE(modem->monitor)->ofono;
+
+  if (modem->has_mm)
+    return;
+
+  modem->has_mm = TRUE;
+
+  if (!ofono)
+    return;
+
+  modem->incoming_message_id = _subscribed(
+        modem->monitor,
+        nui_ofono_subscribe_message(
+          ofono, modem->path, NUI_OFONO_MESSAGE_MANAGER_INTERFACE_NAME,
+          "IncomingMessage", _mm_incoming_message_cb, modem));
+  modem->immediate_message_id = _subscribed(
+        modem->monitor,
+        nui_ofono_subscribe_message(
+          ofono, modem->path, NUI_OFONO_MESSAGE_MANAGER_INTERFACE_NAME,
+          "ImmediateMessage", _mm_immediate_message_cb, modem));
+}
+
+static void
+_mm_destroy(NuiModem *modem)
+{
+  _unsubscribe(modem->monitor, &modem->incoming_message_id);
+  _unsubscribe(modem->monitor, &modem->immediate_message_id);
+
+  modem->has_mm = FALSE;
+}
+
+static void
+_modem_update_interfaces(NuiModem *modem, GVariant *interfaces)
+{
+  GVariantIter i;
+  const gchar *iface;
+  gboolean has_vcm = FALSE;
+  gboolean has_mm = FALSE;
+
+  g_variant_iter_init(&i, interfaces);
+
+  while (g_variant_iter_next(&i, "&s", &iface))
+  {
+    if (!strcmp(iface, NUI_OFONO_VOICECALL_MANAGER_INTERFACE_NAME))
+      has_vcm = TRUE;
+    else if (!strcmp(iface, NUI_OFONO_MESSAGE_MANAGER_INTERFACE_NAME))
+      has_mm = TRUE;
+  }
+
+  if (has_mm)
+    _mm_subscribe(modem);
+  else
+    _mm_destroy(modem);
+
+  if (has_vcm)
+  {
+    if (!modem->has_vcm)
+    {
+      if (PRIVATE(modem->monitor)->resyncing)
+      {
+        modem->resync = TRUE;
+        PRIVATE(modem->monitor)->resync_pending++;
+      }
+
+      _vcm_subscribe(modem);
+    }
+  }
+  else
+  {
+    _vcm_destroy(modem);
+
+    if (_modem_remove_calls(modem))
+      _calls_changed(modem->monitor);
+
+    _modem_resync_done(modem);
+  }
+}
+
+static void
+_modem_parse_interfaces(NuiModem *modem, GVariant *interfaces)
+{
+  gint64 start = g_get_monotonic_time();
+
+  _modem_update_interfaces(modem, interfaces);
+  _histogram_add(&STATS(modem->monitor)->parse_interfaces, start);
+}
+
+static void
+_modem_property_changed_cb(const gchar *path, const gchar *name,
+                           GVariant *value, gpointer user_data)
+{
+  NuiModem *modem = user_data;
+
+  STATS(modem->monitor)->signals[OFONO_IFACE_MODEM]++;
+  _trace(modem->monitor, "ModemPropertyChanged", path, value);
+
+  if (!strcmp(name, OFONO_MODEM_PROPERTY_INTERFACES) &&
+      g_variant_is_of_type(value, G_VARIANT_TYPE_STRING_ARRAY))
+  {
+    _modem_parse_interfaces(user_data, value);
+  }
+}
+
+static void
+_modem_destroy(gpointer data)
+{
+  NuiModem *modem = data;
+
+  _vcm_destroy(modem);
+  _mm_destroy(modem);
+
+  _unsubscribe(modem->monitor, &modem->property_changed_id);
+
+  g_free(modem->path);
+  g_slice_free(NuiModem, modem);
+}
+
+static void
+_modem_add(NuiCallMonitor *monitor, const gchar *path, GVariant *properties)
+{
+  NuiCallMonitorPrivate *priv = PRIVATE(monitor);
+  NuiModem *modem;
+  GVariant *v;
+
+  if (g_hash_table_lookup(priv->modems, path))
+    return;
+
+  g_debug("Adding modem %s", path);
+
+  modem = g_slice_new0(NuiModem);
+  modem->monitor = monitor;
+  modem->path = g_strdup(path);
+  g_hash_table_insert(priv->modems, modem->path, modem);
+
+  if (priv->ofono)
+  {
+    modem->property_changed_id = _subscribed(
+          monitor,
+          nui_ofono_subscribe_property_changed(
+            priv->ofono, path, NUI_OFONO_MODEM_INTERFACE_NAME,
+            OFONO_MODEM_PROPERTY_INTERFACES, _modem_property_changed_cb,
+            modem));
+  }
+
+  v = g_variant_lookup_value(properties, OFONO_MODEM_PROPERTY_INTERFACES,
+                             G_VARIANT_TYPE_STRING_ARRAY);
+
+  if (v)
+  {
+    _modem_parse_interfaces(modem, v);
+    g_variant_unref(v);
+  }
+}
+
+static void
+_modem_added_cb(const gchar *path, GVariant *properties, gpointer user_data)
+{
+  STATS(user_data)->signals[OFONO_IFACE_MANAGER]++;
+  _trace(user_data, "ModemAdded", path, properties);
+
+  _modem_add(user_data, path, properties);
+}
+
+static void
+_modem_removed_cb(const gchar *path, gpointer user_data)
+{
+  NuiCallMonitor *monitor = user_data;
+  NuiCallMonitorPrivate *priv = PRIVATE(monitor);
+  NuiModem *modem;
+
+  priv->stats.signals[OFONO_IFACE_MANAGER]++;
+  _trace(monitor, "ModemRemoved", path, NULL);
+
+  g_debug("Modem %s removed", path);
+
+  modem = g_hash_table_lookup(priv->modems, path);
+
+  if (modem)
+  {
+    _modem_remove_calls(modem);
+    _modem_resync_done(modem);
+    g_hash_table_remove(priv->modems, path);
+    _calls_changed(monitor);
+  }
+}
+
+static void
+_modems_parse(NuiCallMonitor *monitor, GVariant *modems)
+{
+  GVariantIter i;
+  GVariant *properties;
+  const gchar *path;
+
+  g_variant_iter_init(&i, modems);
+
+  while (g_variant_iter_loop(&i, "(&o@a{sv})", &path, &properties))
+    _modem_add(monitor, path, properties);
+}
+
+static void
+_modems_ready_cb(GObject *object, GAsyncResult *res, gpointer user_data)
+{
+  NuiCallMonitor *monitor;
+  NuiCallMonitorPrivate *priv;
+  GVariant *modems;
+  GError *error = NULL;
+  gint64 start;
+
+  modems = nui_ofono_get_objects_finish(G_DBUS_CONNECTION(object), res,
+                                        &error);
+
+  if (!modems)
+  {
+    if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+    {
+      g_warning("Error getting OFONO modems [%s]", error->message);
+      _trace(user_data, "GetModemsError", "/",
+             g_variant_new_string(error->message));
+    }
+
+    g_error_free(error);
+    return;
+  }
+
+  monitor = user_data;
+  priv = PRIVATE(monitor);
+  start = g_get_monotonic_time();
+
+  _trace(monitor, "GetModems", "/", modems);
+  _modems_parse(monitor, modems);
+  g_variant_unref(modems);
+
+  priv->stats.modems_enumerated = start - priv->start_time;
+  _histogram_add(&priv->stats.modems_parse, start);
+
+  g_debug("Modems enumerated %" G_GINT64_FORMAT " us after start, "
+          "main loop blocked for %" G_GINT64_FORMAT " us",
+          start - priv->start_time, g_get_monotonic_time() - start);
+}
+
+static void
+_ofono_bus_ready_cb(GObject *object, GAsyncResult *res, gpointer user_data)
+{
+  NuiCallMonitor *monitor;
+  NuiCallMonitorPrivate *priv;
+  GDBusConnection *ofono;
+  GError *error = NULL;
+
+  ofono = g_bus_get_finish(res, &error);
+
+  if (!ofono)
+  {
+    if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+      g_warning("Error connecting to OFONO bus [%s]", error->message);
+
+    g_error_free(error);
+    return;
+  }
+
+  monitor = user_data;
+  priv = PRIVATE(monitor);
+  priv->ofono = ofono;
+
+  /* one match rule for all the calls on all the modems, calls are looked up
+   * by object path when the signal arrives.
+   */
+  priv->call_property_changed_id = _subscribed(
+        monitor,
+        g_dbus_connection_signal_subscribe(
+          ofono, NUI_OFONO_SERVICE, NUI_OFONO_VOICECALL_INTERFACE_NAME,
+          "PropertyChanged", NULL, OFONO_VOICE_CALL_PROPERTY_STATE,
+          G_DBUS_SIGNAL_FLAGS_NONE, _call_property_changed_cb, monitor,
+          NULL));
+
+  priv->modem_added_id = _subscribed(
+        monitor,
+        nui_ofono_subscribe_object_added(
+          ofono, "/", NUI_OFONO_MANAGER_INTERFACE_NAME, "ModemAdded",
+          _modem_added_cb, monitor));
+  priv->modem_removed_id = _subscribed(
+        monitor,
+        nui_ofono_subscribe_object_removed(
+          ofono, "/", NUI_OFONO_MANAGER_INTERFACE_NAME, "ModemRemoved",
+          _modem_removed_cb, monitor));
+
+  priv->stats.round_trips++;
+  nui_ofono_get_objects(ofono, "/", NUI_OFONO_MANAGER_INTERFACE_NAME,
+                        "GetModems", priv->cancellable, _modems_ready_cb,
+                        monitor);
+}
+
+static void
+_resync_modems_ready_cb(GObject *object, GAsyncResult *res,
+                        gpointer user_data)
+{
+  GVariant *modems;
+  GError *error = NULL;
+
+  modems = nui_ofono_get_objects_finish(G_DBUS_CONNECTION(object), res,
+                                        &error);
+
+  if (!modems)
+  {
+    if (g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+    {
+      g_error_free(error);
+      return;
+    }
+
+    g_warning("Error getting OFONO modems [%s]", error->message);
+    _trace(user_data, "ResyncGetModemsError", "/",
+           g_variant_new_string(error->message));
+    g_error_free(error);
+  }
+  else
+  {
+    _trace(user_data, "ResyncGetModems", "/", modems);
+    _modems_parse(user_data, modems);
+    g_variant_unref(modems);
+  }
+
+  _resync_step_done(user_data);
+}
+
+static gboolean
+_resync_timeout_cb(gpointer user_data)
+{
+  NuiCallMonitorPrivate *priv = PRIVATE(user_data);
+
+  g_debug("OFONO did not come back, dropping call status");
+
+  g_source_unref(priv->resync_timeout);
+  priv->resync_timeout = NULL;
+  _resync_finish(user_data);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+_ofono_appeared_cb(GDBusConnection *connection, const gchar *name,
+                   const gchar *name_owner, gpointer user_data)
+{
+  NuiCallMonitor *monitor = user_data;
+  NuiCallMonitorPrivate *priv = PRIVATE(monitor);
+
+  _trace(monitor, "Appeared", name_owner, NULL);
+  g_debug("OFONO appeared as %s", name_owner);
+
+  priv->ofono_present = TRUE;
+
+  if (!priv->ofono_lost)
+    return;
+
+  priv->ofono_lost = FALSE;
+  _resync_timeout_remove(monitor);
+
+  /* no bus yet, initial discovery will take care */
+  if (!priv->ofono && !priv->offline)
+  {
+    if (priv->resyncing)
+      _resync_finish(monitor);
+
+    return;
+  }
+
+  /* GetModems plus one GetCalls per voice capable modem */
+  priv->resyncing = TRUE;
+  priv->resync_pending++;
+  priv->stats.round_trips++;
+
+  if (priv->ofono)
+  {
+    nui_ofono_get_objects(priv->ofono, "/", NUI_OFONO_MANAGER_INTERFACE_NAME,
+                          "GetModems", priv->resync_cancellable,
+                          _resync_modems_ready_cb, monitor);
+  }
+}
+
+static void
+_ofono_vanished_cb(GDBusConnection *connection, const gchar *name,
+                   gpointer user_data)
+{
+  NuiCallMonitor *monitor = user_data;
+  NuiCallMonitorPrivate *priv = PRIVATE(monitor);
+
+  _trace(monitor, "Vanished", NULL, NULL);
+  priv->ofono_lost = TRUE;
+
+  if (!priv->ofono_present)
+    return;
+
+  g_warning("OFONO vanished, invalidating call state");
+
+  priv->ofono_present = FALSE;
+
+  /* hold status changes back, oFono is likely to be restarted */
+  priv->resyncing = TRUE;
+  priv->resync_pending = 0;
+
+  g_cancellable_cancel(priv->resync_cancellable);
+  g_object_unref(priv->resync_cancellable);
+  priv->resync_cancellable = g_cancellable_new();
+
+  g_hash_table_remove_all(priv->calls);
+  g_hash_table_remove_all(priv->modems);
+  g_warn_if_fail(priv->active == 0);
+  priv->active = 0;
+
+  if (!priv->resync_timeout)
+  {
+    priv->resync_timeout = g_timeout_source_new_seconds(OFONO_RESYNC_TIMEOUT);
+    g_source_set_callback(priv->resync_timeout, _resync_timeout_cb, monitor,
+                          NULL);
+    g_source_attach(priv->resync_timeout,
+                    priv->context ? priv->context : priv->owner_context);
+  }
+}
+
+static void
+_monitor_start(NuiCallMonitor *monitor)
+{
+  NuiCallMonitorPrivate *priv = PRIVATE(monitor);
+  const gchar *trace = g_getenv(NUI_CALL_MONITOR_TRACE_ENV);
+
+  priv->start_time = g_get_monotonic_time();
+
+  if (trace && *trace)
+  {
+    int fd = g_open(trace, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0600);
+    int err = errno;
+
+    if (fd != -1)
+    {
+      priv->trace = fdopen(fd, "a");
+      err = errno;
+
+      if (!priv->trace)
+        close(fd);
+    }
+
+    if (priv->trace)
+      fprintf(priv->trace, NUI_CALL_MONITOR_TRACE_HEADER "\n");
+    else
+    {
+      g_warning("Unable to open call monitor trace %s [%s]", trace,
+                g_strerror(err));
+    }
+  }
+
+  g_bus_get(NUI_OFONO_BUS_TYPE, priv->cancellable, _ofono_bus_ready_cb,
+            monitor);
+
+  /* the name and the paths are fixed, only one instance can have them */
+  if (priv->export)
+  {
+    g_bus_get(G_BUS_TYPE_SESSION, priv->cancellable, _session_bus_ready_cb,
+              monitor);
+  }
+
+  priv->ofono_watch_id = g_bus_watch_name(
+        NUI_OFONO_BUS_TYPE, NUI_OFONO_SERVICE, G_BUS_NAME_WATCHER_FLAGS_NONE,
+        _ofono_appeared_cb, _ofono_vanished_cb, monitor, NULL);
+}
+
+static void
+_monitor_stop(NuiCallMonitor *monitor)
+{
+  NuiCallMonitorPrivate *priv = PRIVATE(monitor);
+
+  g_cancellable_cancel(priv->cancellable);
+  g_object_unref(priv->cancellable);
+
+  if (priv->ofono_watch_id)
+    g_bus_unwatch_name(priv->ofono_watch_id);
+
+  g_cancellable_cancel(priv->resync_cancellable);
+  g_object_unref(priv->resync_cancellable);
+  _resync_timeout_remove(monitor);
+
+  if (priv->session_bus)
+  {
+    if (priv->bus_name_id)
+      g_bus_unown_name(priv->bus_name_id);
+
+    if (priv->stats_id)
+    {
+      g_dbus_connection_unregister_object(priv->session_bus,
+                                          priv->stats_id);
+    }
+
+    if (priv->state_id)
+    {
+      g_dbus_connection_unregister_object(priv->session_bus,
+                                          priv->state_id);
+    }
+
+    if (priv->exported)
+      g_variant_unref(priv->exported);
+
+    g_object_unref(priv->session_bus);
+  }
+
+  /* calls first, they unlink themselves from their modems */
+  g_hash_table_unref(priv->calls);
+  g_hash_table_unref(priv->modems);
+
+  if (priv->ofono)
+  {
+    _unsubscribe(monitor, &priv->call_property_changed_id);
+    _unsubscribe(monitor, &priv->modem_added_id);
+    _unsubscribe(monitor, &priv->modem_removed_id);
+    g_object_unref(priv->ofono);
+  }
+
+  if (priv->trace)
+    fclose(priv->trace);
+}
+
+static gpointer
+_monitor_thread(gpointer data)
+{
+  NuiCallMonitor *monitor = data;
+  NuiCallMonitorPrivate *priv = PRIVATE(monitor);
+
+  g_main_context_push_thread_default(priv->context);
+
+  _monitor_start(monitor);
+  g_main_loop_run(priv->loop);
+  _monitor_stop(monitor);
+
+  /* let pending cancellations and unsubscriptions dispatch */
+  while (g_main_context_iteration(priv->context, FALSE))
+    ;
+
+  g_main_context_pop_thread_default(priv->context);
+
+  return NULL;
+}
+
+static gboolean
+_monitor_quit_cb(gpointer user_data)
+{
+  g_main_loop_quit(user_data);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+nui_call_monitor_init(NuiCallMonitor *monitor)
+{
+  NuiCallMonitorPrivate *priv = PRIVATE(monitor);
+
+  priv->cancellable = g_cancellable_new();
+  priv->resync_cancellable = g_cancellable_new();
+  /* keys are owned by the records */
+  priv->modems = g_hash_table_new_full(
+        g_str_hash, g_str_equal, NULL, _modem_destroy);
+  priv->calls = g_hash_table_new_full(
+        g_str_hash, g_str_equal, NULL, _call_destroy);
+
+  g_mutex_init(&priv->lock);
+  priv->pending_status = -1;
+  priv->messages = g_ptr_array_new_with_free_func(
+        (GDestroyNotify)g_variant_unref);
+  priv->owner_context = g_main_context_ref_thread_default();
+}
+
+static void
+nui_call_monitor_constructed(GObject *object)
+{
+  NuiCallMonitorPrivate *priv = PRIVATE(object);
+
+  G_OBJECT_CLASS(nui_call_monitor_parent_class)->constructed(object);
+
+  if (priv->offline)
+    priv->threaded = FALSE;
+  else if (priv->threaded)
+  {
+    priv->context = g_main_context_new();
+    priv->loop = g_main_loop_new(priv->context, FALSE);
+    priv->thread = g_thread_new("nui-call-monitor", _monitor_thread, object);
+  }
+  else
+    _monitor_start(NUI_CALL_MONITOR(object));
+}
+
+static void
+nui_call_monitor_set_property(GObject *object, guint property_id,
+                              const GValue *value, GParamSpec *pspec)
+{
+  NuiCallMonitorPrivate *priv = PRIVATE(object);
+
+  switch (property_id)
+  {
+    case PROP_THREADED:
+    {
+      priv->threaded = g_value_get_boolean(value);
+      break;
+    }
+    case PROP_OFFLINE:
+    {
+      priv->offline = g_value_get_boolean(value);
+      break;
+    }
+    case PROP_EXPORT:
+    {
+      priv->export = g_value_get_boolean(value);
+      break;
+    }
+    default:
+    {
+      G_OBJECT_WARN_INVALID_PROPERTY_ID(object, property_id, pspec);
+      break;
+    }
+  }
+}
+
+static void
+nui_call_monitor_get_property(GObject *object, guint property_id,
+                              GValue *value, GParamSpec *pspec)
+{
+  NuiCallMonitorPrivate *priv = PRIVATE(object);
+
+  switch (property_id)
+  {
+    case PROP_THREADED:
+    {
+      g_value_set_boolean(value, priv->threaded);
+      break;
+    }
+    case PROP_OFFLINE:
+    {
+      g_value_set_boolean(value, priv->offline);
+      break;
+    }
+    case PROP_EXPORT:
+    {
+      g_value_set_boolean(value, priv->export);
+      break;
+    }
+    default:
+    {
+      G_OBJECT_WARN_INVALID_PROPERTY_ID(object, property_id, pspec);
+      break;
+    }
+  }
+}
+
+static void
+nui_call_monitor_dispose(GObject *object)
+{
+  NuiCallMonitorPrivate *priv = PRIVATE(object);
+
+  if (!priv->disposed)
+  {
+    /* mark first, so nothing the worker posts gets emitted anymore */
+    priv->disposed = TRUE;
+
+    if (priv->thread)
+    {
+      GSource *source = g_idle_source_new();
+
+      g_source_set_callback(source, _monitor_quit_cb, priv->loop, NULL);
+      g_source_attach(source, priv->context);
+      g_source_unref(source);
+
+      g_thread_join(priv->thread);
+      priv->thread = NULL;
+      g_main_loop_unref(priv->loop);
+      g_main_context_unref(priv->context);
+    }
+    else
+      _monitor_stop(NUI_CALL_MONITOR(object));
+
+    G_OBJECT_CLASS(nui_call_monitor_parent_class)->dispose(object);
+  }
+}
+
+static void
+nui_call_monitor_finalize(GObject *object)
+{
+  NuiCallMonitorPrivate *priv = PRIVATE(object);
+
+  if (priv->snapshot)
+    g_variant_unref(priv->snapshot);
+
+  g_ptr_array_unref(priv->messages);
+  g_mutex_clear(&priv->lock);
+  g_main_context_unref(priv->owner_context);
+
+  G_OBJECT_CLASS(nui_call_monitor_parent_class)->finalize(object);
+}
+
+static void
+nui_call_monitor_class_init(NuiCallMonitorClass *klass)
+{
   GObjectClass *object_class = G_OBJECT_CLASS(klass);
+  int i;
 
+  object_class->constructed = nui_call_monitor_constructed;
+  object_class->set_property = nui_call_monitor_set_property;
+  object_class->get_property = nui_call_monitor_get_property;
   object_class->dispose = nui_call_monitor_dispose;
+  object_class->finalize = nui_call_monitor_finalize;
+
+  g_object_class_install_property(
+        object_class, PROP_THREADED,
+        g_param_spec_boolean(
+          "threaded", "Threaded",
+          "Handle oFono in a worker thread with its own main context",
+          FALSE,
+          G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY |
+          G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property(
+        object_class, PROP_OFFLINE,
+        g_param_spec_boolean(
+          "offline", "Offline",
+          "Do not connect to oFono, events come from a replayed trace",
+          FALSE,
+          G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY |
+          G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property(
+        object_class, PROP_EXPORT,
+        g_param_spec_boolean(
+          "export", "Export",
+          "Serve the stats and the call state on the session bus",
+          FALSE,
+          G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY |
+          G_PARAM_STATIC_STRINGS));
 
   signals[STATUS_CHAGED] =
       g_signal_new(
@@ -530,9 +1992,298 @@ nui_call_monitor_class_init(NuiCallMonitorClass *klass)
         g_cclosure_marshal_VOID__BOOLEAN,
         G_TYPE_NONE,
         1, G_TYPE_BOOLEAN);
+
+  /* a{sau}, modem path to number of calls in each NuiCallState */
+  signals[CALLS_CHANGED] =
+      g_signal_new(
+        "calls-changed",
+        G_TYPE_FROM_CLASS(klass),
+        G_SIGNAL_RUN_LAST, 0, NULL, NULL,
+        g_cclosure_marshal_VOID__VARIANT,
+        G_TYPE_NONE,
+        1, G_TYPE_VARIANT);
+
+  /* a(osba{sv}), modem path, text, class 0 flag and oFono message info of
+   * the SMS received within one main loop iteration
+   */
+  signals[MESSAGES_RECEIVED] =
+      g_signal_new(
+        "messages-received",
+        G_TYPE_FROM_CLASS(klass),
+        G_SIGNAL_RUN_LAST, 0, NULL, NULL,
+        g_cclosure_marshal_VOID__VARIANT,
+        G_TYPE_NONE,
+        1, G_TYPE_VARIANT);
+
+  for (i = 1; i < NUI_CALL_STATE_LAST; i++)
+    call_state_quarks[i] = g_quark_from_static_string(call_state_names[i]);
 }
 
 gpointer nui_call_monitor_new()
 {
-  return g_object_new(NUI_TYPE_CALL_MONITOR, NULL);
+  return g_object_new(NUI_TYPE_CALL_MONITOR,
+#ifdef NUI_CALL_MONITOR_THREADED
+                      "threaded", TRUE,
+#endif
+                      NULL);
+}
+
+NuiCallMonitor *
+nui_call_monitor_dup_default()
+{
+  /* never released, the module can't be unloaded anyway as it registers
+   * static types, so plugin reloads get the already discovered state.
+   */
+  static NuiCallMonitor *monitor = NULL;
+
+  if (!monitor)
+  {
+    monitor = g_object_new(NUI_TYPE_CALL_MONITOR,
+#ifdef NUI_CALL_MONITOR_THREADED
+                           "threaded", TRUE,
+#endif
+                           "export", TRUE,
+                           NULL);
+  }
+
+  return g_object_ref(monitor);
+}
+
+gboolean
+nui_call_monitor_get_status(NuiCallMonitor *monitor)
+{
+  NuiCallMonitorPrivate *priv;
+
+  g_return_val_if_fail(NUI_IS_CALL_MONITOR(monitor), FALSE);
+
+  priv = PRIVATE(monitor);
+
+  return priv->threaded ? priv->reported_status : priv->status;
+}
+
+GVariant *
+nui_call_monitor_dup_calls(NuiCallMonitor *monitor)
+{
+  NuiCallMonitorPrivate *priv;
+  GVariant *snapshot = NULL;
+
+  g_return_val_if_fail(NUI_IS_CALL_MONITOR(monitor), NULL);
+
+  priv = PRIVATE(monitor);
+
+  if (!priv->threaded)
+    return g_variant_ref_sink(_calls_snapshot(monitor));
+
+  /* the tables belong to the worker, return the last state it posted */
+  g_mutex_lock(&priv->lock);
+
+  if (priv->snapshot)
+    snapshot = g_variant_ref(priv->snapshot);
+
+  g_mutex_unlock(&priv->lock);
+
+  if (!snapshot)
+    snapshot = g_variant_ref_sink(g_variant_new_array(G_VARIANT_TYPE("{sau}"),
+                                                      NULL, 0));
+
+  return snapshot;
+}
+
+gint64
+nui_call_monitor_get_active_since(NuiCallMonitor *monitor)
+{
+  NuiCallMonitorPrivate *priv;
+  gint64 since;
+
+  g_return_val_if_fail(NUI_IS_CALL_MONITOR(monitor), 0);
+
+  priv = PRIVATE(monitor);
+  g_mutex_lock(&priv->lock);
+  since = priv->active_since;
+  g_mutex_unlock(&priv->lock);
+
+  return since;
+}
+
+static void
+_replay_event(NuiCallMonitor *monitor, const gchar *event, const gchar *path,
+              GVariant *value)
+{
+  NuiCallMonitorPrivate *priv = PRIVATE(monitor);
+  NuiModem *modem = g_hash_table_lookup(priv->modems, path);
+  const gchar *s;
+  GVariant *v;
+
+  if (!strcmp(event, "Appeared"))
+    _ofono_appeared_cb(NULL, NUI_OFONO_SERVICE, path, monitor);
+  else if (!strcmp(event, "Vanished"))
+    _ofono_vanished_cb(NULL, NUI_OFONO_SERVICE, monitor);
+  else if (!strcmp(event, "ModemRemoved"))
+    _modem_removed_cb(path, monitor);
+  else if (!value)
+    g_warning("Trace event %s without a value", event);
+  else if (!strcmp(event, "CallPropertyChanged"))
+  {
+    _call_property_changed_cb(NULL, NUI_OFONO_SERVICE, path,
+                              NUI_OFONO_VOICECALL_INTERFACE_NAME,
+                              "PropertyChanged", value, monitor);
+  }
+  else if (!strcmp(event, "ModemAdded"))
+    _modem_added_cb(path, value, monitor);
+  else if (!strcmp(event, "GetModems"))
+    _modems_parse(monitor, value);
+  else if (!strcmp(event, "ResyncGetModems"))
+  {
+    _modems_parse(monitor, value);
+    _resync_step_done(monitor);
+  }
+  else if (!strcmp(event, "GetModemsError"))
+    g_debug("Replayed GetModems failure");
+  else if (!strcmp(event, "ResyncGetModemsError"))
+    _resync_step_done(monitor);
+  else if (!modem)
+    g_debug("Trace event %s for unknown modem %s", event, path);
+  else if (!strcmp(event, "ModemPropertyChanged"))
+  {
+    _modem_property_changed_cb(path, OFONO_MODEM_PROPERTY_INTERFACES, value,
+                               modem);
+  }
+  else if (!strcmp(event, "CallAdded"))
+  {
+    g_variant_get(value, "(&o@a{sv})", &s, &v);
+    _vcm_call_added_cb(s, v, modem);
+    g_variant_unref(v);
+  }
+  else if (!strcmp(event, "CallRemoved"))
+  {
+    g_variant_get(value, "(&o)", &s);
+    _vcm_call_removed_cb(s, modem);
+  }
+  else if (!strcmp(event, "GetCalls"))
+    _vcm_calls_parse(modem, value);
+  else if (!strcmp(event, "GetCallsError"))
+    _modem_resync_done(modem);
+  else if (!strcmp(event, "IncomingMessage") ||
+           !strcmp(event, "ImmediateMessage"))
+  {
+    g_variant_get(value, "(&s@a{sv})", &s, &v);
+    _mm_message(modem, s, v, !strcmp(event, "ImmediateMessage"));
+    g_variant_unref(v);
+  }
+  else
+    g_warning("Unknown trace event %s", event);
+}
+
+static gboolean
+_replay_wait_cb(gpointer user_data)
+{
+  *(gboolean *)user_data = TRUE;
+
+  return G_SOURCE_REMOVE;
+}
+
+/* sources attached by the events replayed so far, like the resync timeout
+ * or the posted messages, get dispatched meanwhile
+ */
+static void
+_replay_wait(NuiCallMonitor *monitor, gint64 delay)
+{
+  GMainContext *context = PRIVATE(monitor)->owner_context;
+  GSource *source = g_timeout_source_new(delay / 1000);
+  gboolean done = FALSE;
+
+  g_source_set_callback(source, _replay_wait_cb, &done, NULL);
+  g_source_attach(source, context);
+
+  while (!done)
+    g_main_context_iteration(context, TRUE);
+
+  g_source_unref(source);
+}
+
+gboolean
+nui_call_monitor_replay(NuiCallMonitor *monitor, const gchar *filename,
+                        gboolean realtime, GError **error)
+{
+  GFile *file;
+  GFileInputStream *input;
+  GDataInputStream *data;
+  gint64 last = 0;
+  gint64 last_replayed = 0;
+  GError *read_error = NULL;
+  gchar *line;
+  guint n = 0;
+
+  g_return_val_if_fail(NUI_IS_CALL_MONITOR(monitor), FALSE);
+  g_return_val_if_fail(PRIVATE(monitor)->offline, FALSE);
+
+  file = g_file_new_for_path(filename);
+  input = g_file_read(file, NULL, error);
+  g_object_unref(file);
+
+  if (!input)
+    return FALSE;
+
+  data = g_data_input_stream_new(G_INPUT_STREAM(input));
+  g_object_unref(input);
+
+  while ((line = g_data_input_stream_read_line(data, NULL, NULL,
+                                               &read_error)))
+  {
+    gchar **fields = g_strsplit(line, " ", 4);
+    GVariant *value = NULL;
+    gint64 time;
+
+    n++;
+
+    if (line[0] == '#' || g_strv_length(fields) != 4)
+      goto next;
+
+    time = g_ascii_strtoll(fields[0], NULL, 10);
+
+    if (strcmp(fields[3], "-"))
+    {
+      GError *parse_error = NULL;
+
+      value = g_variant_parse(NULL, fields[3], NULL, NULL, &parse_error);
+
+      if (!value)
+      {
+        g_warning("Trace line %u, %s", n, parse_error->message);
+        g_error_free(parse_error);
+        goto next;
+      }
+    }
+
+    /* keep the recorded spacing between events */
+    if (realtime && last && time > last)
+    {
+      gint64 delay = (time - last) - (g_get_monotonic_time() - last_replayed);
+
+      if (delay > 0)
+        _replay_wait(monitor, delay);
+    }
+
+    last = time;
+    last_replayed = g_get_monotonic_time();
+
+    _replay_event(monitor, fields[1], fields[2], value);
+
+    if (value)
+      g_variant_unref(value);
+
+next:
+    g_strfreev(fields);
+    g_free(line);
+  }
+
+  g_object_unref(data);
+
+  if (read_error)
+  {
+    g_propagate_error(error, read_error);
+    return FALSE;
+  }
+
+  return TRUE;
 }
@@ -32,10 +32,48 @@ G_BEGIN_DECLS
 typedef struct _NuiCallMonitorClass NuiCallMonitorClass;
 typedef struct _NuiCallMonitor NuiCallMonitor;
 
+typedef enum
+{
+  NUI_CALL_STATE_UNKNOWN,
+  NUI_CALL_STATE_INCOMING,
+  NUI_CALL_STATE_DIALING,
+  NUI_CALL_STATE_ALERTING,
+  NUI_CALL_STATE_ACTIVE,
+  NUI_CALL_STATE_HELD,
+  NUI_CALL_STATE_WAITING,
+  NUI_CALL_STATE_DISCONNECTED,
+  NUI_CALL_STATE_LAST
+} NuiCallState;
+
 GType nui_call_monitor_get_type(void) G_GNUC_CONST;
 
 gpointer nui_call_monitor_new();
 
+/* process wide instance, shared by all the consumers, the only one that is
+ * exported on the session bus
+ */
+NuiCallMonitor *nui_call_monitor_dup_default();
+
+/* TRUE if there is an active or held call */
+gboolean nui_call_monitor_get_status(NuiCallMonitor *monitor);
+
+/* a{sau}, the same snapshot "calls-changed" is emitted with */
+GVariant *nui_call_monitor_dup_calls(NuiCallMonitor *monitor);
+
+/* g_get_monotonic_time() the oldest active or held call got connected at, 0
+ * if there is none, updated before "calls-changed" is emitted
+ */
+gint64 nui_call_monitor_get_active_since(NuiCallMonitor *monitor);
+
+/* feeds a trace recorded with NUI_CALL_MONITOR_TRACE set into a monitor
+ * created with "offline" set, signals are emitted while replaying. realtime
+ * keeps the recorded delays, running the thread-default main context of the
+ * monitor meanwhile, otherwise events are replayed back to back.
+ */
+gboolean nui_call_monitor_replay(NuiCallMonitor *monitor,
+                                 const gchar *filename, gboolean realtime,
+                                 GError **error);
+
 G_END_DECLS
 
 #endif /* __NUI_CALL_MONITOR_H__ */
@@ -0,0 +1,121 @@
+/*
+ * nui-call-timer.c
+ *
+ * Copyright (C) 2024 Ivaylo Dimitrov <ivo.g.dimitrov.75@gmail.com>
+ *
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "config.h"
+
+#include <glib.h>
+
+#include "nui-call-timer.h"
+
+struct _NuiCallTimer
+{
+  NuiCallTimerFunc tick;
+  gpointer user_data;
+  gint64 active_since;
+  gboolean visible;
+  guint id;
+  guint wakeups;
+};
+
+static void
+_tick(NuiCallTimer *timer)
+{
+  timer->tick((g_get_monotonic_time() - timer->active_since) /
+              G_USEC_PER_SEC, timer->user_data);
+}
+
+static gboolean
+_tick_cb(gpointer user_data)
+{
+  NuiCallTimer *timer = user_data;
+
+  timer->wakeups++;
+  _tick(timer);
+
+  return G_SOURCE_CONTINUE;
+}
+
+static void
+_update(NuiCallTimer *timer)
+{
+  gboolean run = timer->active_since && timer->visible;
+
+  if (run && !timer->id)
+  {
+    _tick(timer);
+    timer->id = g_timeout_add_seconds(1, _tick_cb, timer);
+  }
+  else if (!run && timer->id)
+  {
+    g_source_remove(timer->id);
+    timer->id = 0;
+  }
+}
+
+NuiCallTimer *
+nui_call_timer_new(NuiCallTimerFunc tick, gpointer user_data)
+{
+  NuiCallTimer *timer;
+
+  g_return_val_if_fail(tick != NULL, NULL);
+
+  timer = g_slice_new0(NuiCallTimer);
+  timer->tick = tick;
+  timer->user_data = user_data;
+
+  return timer;
+}
+
+void
+nui_call_timer_free(NuiCallTimer *timer)
+{
+  if (timer->id)
+    g_source_remove(timer->id);
+
+  g_slice_free(NuiCallTimer, timer);
+}
+
+void
+nui_call_timer_set_active_since(NuiCallTimer *timer, gint64 active_since)
+{
+  if (active_since == timer->active_since)
+    return;
+
+  timer->active_since = active_since;
+  _update(timer);
+}
+
+void
+nui_call_timer_set_visible(NuiCallTimer *timer, gboolean visible)
+{
+  timer->visible = visible;
+  _update(timer);
+}
+
+gboolean
+nui_call_timer_is_running(NuiCallTimer *timer)
+{
+  return timer->id != 0;
+}
+
+guint
+nui_call_timer_get_wakeups(NuiCallTimer *timer)
+{
+  return timer->wakeups;
+}
@@ -0,0 +1,49 @@
+/*
+ * nui-call-timer.h
+ *
+ * Copyright (C) 2024 Ivaylo Dimitrov <ivo.g.dimitrov.75@gmail.com>
+ *
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __NUI_CALL_TIMER_H__
+#define __NUI_CALL_TIMER_H__
+
+G_BEGIN_DECLS
+
+typedef struct _NuiCallTimer NuiCallTimer;
+
+/* duration of the ongoing call, in seconds */
+typedef void (*NuiCallTimerFunc)(gint64 duration, gpointer user_data);
+
+/* ticks once a second, on the second boundary shared by all the
+ * g_timeout_add_seconds() sources, but only while there is a call and
+ * somebody can see its duration
+ */
+NuiCallTimer *nui_call_timer_new(NuiCallTimerFunc tick, gpointer user_data);
+void nui_call_timer_free(NuiCallTimer *timer);
+
+/* monotonic time the call went active, 0 if there is none */
+void nui_call_timer_set_active_since(NuiCallTimer *timer,
+                                     gint64 active_since);
+void nui_call_timer_set_visible(NuiCallTimer *timer, gboolean visible);
+
+gboolean nui_call_timer_is_running(NuiCallTimer *timer);
+
+/* times the timer woke the process up */
+guint nui_call_timer_get_wakeups(NuiCallTimer *timer);
+
+G_END_DECLS
+
+#endif /* __NUI_CALL_TIMER_H__ */
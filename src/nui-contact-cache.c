@@ -0,0 +1,472 @@
+/*
+ * nui-contact-cache.c
+ *
+ * Copyright (C) 2024 Ivaylo Dimitrov <ivo.g.dimitrov.75@gmail.com>
+ *
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <telepathy-glib/telepathy-glib.h>
+
+#include "nui-contact-cache.h"
+
+/* phone numbers are compared by that many trailing digits, so national and
+ * international forms of the same number match
+ */
+#define NUI_CONTACT_CACHE_PHONE_DIGITS 9
+
+/* seconds an id without a name is remembered */
+#define NUI_CONTACT_CACHE_NEGATIVE_TTL 300
+
+typedef struct
+{
+  NuiContactCache *cache;
+  gchar *key;
+  gchar *account;
+  gchar *id;
+  /* NULL for negative entries */
+  gchar *name;
+  TpContact *contact;
+  gint64 expires;
+  GList link;
+} NuiContactCacheEntry;
+
+struct _NuiContactCache
+{
+  guint size;
+  /* key to NuiContactCacheEntry */
+  GHashTable *entries;
+  /* most recently used first */
+  GQueue lru;
+  /* keys being resolved */
+  GHashTable *pending;
+  GCancellable *cancellable;
+  NuiContactCacheResolvedFunc resolved;
+  gpointer user_data;
+  /* replaces Telepathy if set */
+  NuiContactCacheResolveFunc resolve;
+  gpointer resolve_data;
+  guint hits;
+  guint misses;
+};
+
+typedef struct
+{
+  NuiContactCache *cache;
+  GCancellable *cancellable;
+  gchar *key;
+  gchar *account;
+  gchar *id;
+} NuiContactCachePrefetch;
+
+gchar *
+nui_contact_cache_normalize(const gchar *id)
+{
+  const gchar *p;
+  GString *digits;
+  gsize len;
+
+  if (!id || !*id)
+    return g_strdup("");
+
+  for (p = id; *p; p++)
+  {
+    if (!strchr("+0123456789 -().", *p))
+      return g_utf8_casefold(id, -1);
+  }
+
+  digits = g_string_new(NULL);
+
+  for (p = id; *p; p++)
+  {
+    if (g_ascii_isdigit(*p))
+      g_string_append_c(digits, *p);
+  }
+
+  len = digits->len;
+
+  if (!len)
+  {
+    g_string_free(digits, TRUE);
+    return g_strdup(id);
+  }
+
+  if (len > NUI_CONTACT_CACHE_PHONE_DIGITS)
+    g_string_erase(digits, 0, len - NUI_CONTACT_CACHE_PHONE_DIGITS);
+
+  return g_string_free(digits, FALSE);
+}
+
+static gchar *
+_make_key(const gchar *account, const gchar *id)
+{
+  gchar *normalized = nui_contact_cache_normalize(id);
+  gchar *key = g_strconcat(account, " ", normalized, NULL);
+
+  g_free(normalized);
+
+  return key;
+}
+
+static void
+_entry_free(gpointer data)
+{
+  NuiContactCacheEntry *entry = data;
+
+  g_queue_unlink(&entry->cache->lru, &entry->link);
+
+  if (entry->contact)
+  {
+    g_signal_handlers_disconnect_matched(entry->contact, G_SIGNAL_MATCH_DATA,
+                                         0, 0, NULL, NULL, entry);
+    g_object_unref(entry->contact);
+  }
+
+  g_free(entry->key);
+  g_free(entry->account);
+  g_free(entry->id);
+  g_free(entry->name);
+  g_slice_free(NuiContactCacheEntry, entry);
+}
+
+static const gchar *
+_contact_name(TpContact *contact)
+{
+  const gchar *alias = tp_contact_get_alias(contact);
+
+  /* CMs fall back to the id when there is no name */
+  if (!alias || !*alias || !g_strcmp0(alias, tp_contact_get_identifier(contact)))
+    return NULL;
+
+  return alias;
+}
+
+static NuiContactCacheEntry *
+_entry_insert(NuiContactCache *cache, const gchar *account, const gchar *id,
+              const gchar *name)
+{
+  NuiContactCacheEntry *entry = g_slice_new0(NuiContactCacheEntry);
+
+  entry->cache = cache;
+  entry->key = _make_key(account, id);
+  entry->account = g_strdup(account);
+  entry->id = g_strdup(id);
+  entry->name = g_strdup(name);
+  entry->link.data = entry;
+
+  if (!name)
+  {
+    entry->expires = g_get_monotonic_time() +
+        NUI_CONTACT_CACHE_NEGATIVE_TTL * G_USEC_PER_SEC;
+  }
+
+  g_hash_table_replace(cache->entries, entry->key, entry);
+  g_queue_push_head_link(&cache->lru, &entry->link);
+
+  while (cache->lru.length > cache->size)
+  {
+    NuiContactCacheEntry *last = g_queue_peek_tail(&cache->lru);
+
+    g_hash_table_remove(cache->entries, last->key);
+  }
+
+  return entry;
+}
+
+static void
+_contact_alias_changed_cb(TpContact *contact, GParamSpec *pspec,
+                          gpointer user_data)
+{
+  NuiContactCacheEntry *entry = user_data;
+  NuiContactCache *cache = entry->cache;
+  const gchar *name = _contact_name(contact);
+  gchar *account;
+  gchar *id;
+
+  if (!g_strcmp0(entry->name, name))
+    return;
+
+  account = g_strdup(entry->account);
+  id = g_strdup(entry->id);
+
+  if (name)
+  {
+    g_free(entry->name);
+    entry->name = g_strdup(name);
+  }
+  else
+    g_hash_table_remove(cache->entries, entry->key);
+
+  if (cache->resolved)
+    cache->resolved(account, id, name, cache->user_data);
+
+  g_free(account);
+  g_free(id);
+}
+
+NuiContactCache *
+nui_contact_cache_new(guint size, NuiContactCacheResolvedFunc resolved,
+                      gpointer user_data)
+{
+  NuiContactCache *cache;
+
+  g_return_val_if_fail(size > 0, NULL);
+
+  cache = g_slice_new0(NuiContactCache);
+  cache->size = size;
+  cache->entries = g_hash_table_new_full(g_str_hash, g_str_equal, NULL,
+                                         _entry_free);
+  g_queue_init(&cache->lru);
+  cache->pending = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                         NULL);
+  cache->cancellable = g_cancellable_new();
+  cache->resolved = resolved;
+  cache->user_data = user_data;
+
+  return cache;
+}
+
+void
+nui_contact_cache_free(NuiContactCache *cache)
+{
+  g_cancellable_cancel(cache->cancellable);
+  g_object_unref(cache->cancellable);
+  g_hash_table_unref(cache->pending);
+  g_hash_table_unref(cache->entries);
+  g_slice_free(NuiContactCache, cache);
+}
+
+gboolean
+nui_contact_cache_lookup(NuiContactCache *cache, const gchar *account,
+                         const gchar *id, const gchar **name)
+{
+  NuiContactCacheEntry *entry;
+  gchar *key = _make_key(account, id);
+
+  entry = g_hash_table_lookup(cache->entries, key);
+  g_free(key);
+
+  if (entry && entry->expires && entry->expires < g_get_monotonic_time())
+  {
+    g_hash_table_remove(cache->entries, entry->key);
+    entry = NULL;
+  }
+
+  if (!entry)
+  {
+    cache->misses++;
+    return FALSE;
+  }
+
+  cache->hits++;
+  g_queue_unlink(&cache->lru, &entry->link);
+  g_queue_push_head_link(&cache->lru, &entry->link);
+
+  if (name)
+    *name = entry->name;
+
+  return TRUE;
+}
+
+void
+nui_contact_cache_add_contact(NuiContactCache *cache, const gchar *account,
+                              TpContact *contact)
+{
+  NuiContactCacheEntry *entry;
+  const gchar *name = _contact_name(contact);
+
+  entry = _entry_insert(cache, account, tp_contact_get_identifier(contact),
+                        name);
+
+  if (name)
+  {
+    entry->contact = g_object_ref(contact);
+    g_signal_connect(contact, "notify::alias",
+                     G_CALLBACK(_contact_alias_changed_cb), entry);
+  }
+}
+
+static void
+_prefetch_ready_cb(GObject *object, GAsyncResult *res, gpointer user_data)
+{
+  NuiContactCachePrefetch *prefetch = user_data;
+  GError *error = NULL;
+  TpContact *contact;
+
+  contact = tp_connection_dup_contact_by_id_finish(TP_CONNECTION(object), res,
+                                                   &error);
+
+  /* the lookup itself cannot be cancelled, but the cache may be gone or
+   * the id invalidated meanwhile
+   */
+  if (!g_cancellable_is_cancelled(prefetch->cancellable) &&
+      g_hash_table_remove(prefetch->cache->pending, prefetch->key))
+  {
+    NuiContactCache *cache = prefetch->cache;
+    const gchar *name = NULL;
+
+    if (contact)
+    {
+      nui_contact_cache_add_contact(cache, prefetch->account, contact);
+      name = _contact_name(contact);
+    }
+    else
+    {
+      g_debug("Unable to resolve %s [%s]", prefetch->id, error->message);
+      _entry_insert(cache, prefetch->account, prefetch->id, NULL);
+    }
+
+    if (cache->resolved)
+      cache->resolved(prefetch->account, prefetch->id, name, cache->user_data);
+  }
+
+  if (contact)
+    g_object_unref(contact);
+  else
+    g_error_free(error);
+
+  g_object_unref(prefetch->cancellable);
+  g_free(prefetch->key);
+  g_free(prefetch->account);
+  g_free(prefetch->id);
+  g_slice_free(NuiContactCachePrefetch, prefetch);
+}
+
+void
+nui_contact_cache_prefetch(NuiContactCache *cache, TpConnection *connection,
+                           const gchar *account, const gchar *id)
+{
+  static const TpContactFeature features[] = { TP_CONTACT_FEATURE_ALIAS };
+  NuiContactCachePrefetch *prefetch;
+  gchar *key;
+
+  g_return_if_fail(cache->resolve || TP_IS_CONNECTION(connection));
+
+  key = _make_key(account, id);
+
+  if (g_hash_table_contains(cache->pending, key) ||
+      g_hash_table_contains(cache->entries, key))
+  {
+    g_free(key);
+    return;
+  }
+
+  if (cache->resolve)
+  {
+    g_hash_table_add(cache->pending, key);
+    cache->resolve(cache, account, id, cache->resolve_data);
+
+    return;
+  }
+
+  g_hash_table_add(cache->pending, g_strdup(key));
+
+  prefetch = g_slice_new(NuiContactCachePrefetch);
+  prefetch->cache = cache;
+  prefetch->cancellable = g_object_ref(cache->cancellable);
+  prefetch->key = key;
+  prefetch->account = g_strdup(account);
+  prefetch->id = g_strdup(id);
+
+  tp_connection_dup_contact_by_id_async(connection, id,
+                                        G_N_ELEMENTS(features), features,
+                                        _prefetch_ready_cb, prefetch);
+}
+
+void
+nui_contact_cache_set_resolver(NuiContactCache *cache,
+                               NuiContactCacheResolveFunc resolve,
+                               gpointer user_data)
+{
+  cache->resolve = resolve;
+  cache->resolve_data = user_data;
+}
+
+void
+nui_contact_cache_resolved(NuiContactCache *cache, const gchar *account,
+                           const gchar *id, const gchar *name)
+{
+  gchar *key = _make_key(account, id);
+  gboolean pending = g_hash_table_remove(cache->pending, key);
+
+  g_free(key);
+
+  /* invalidated while being resolved, the answer may be stale already */
+  if (!pending)
+  {
+    g_debug("Dropping late resolve of %s", id);
+    return;
+  }
+
+  _entry_insert(cache, account, id, name);
+
+  if (cache->resolved)
+    cache->resolved(account, id, name, cache->user_data);
+}
+
+void
+nui_contact_cache_invalidate(NuiContactCache *cache, const gchar *account,
+                             const gchar *id)
+{
+  GHashTableIter iter;
+  NuiContactCacheEntry *entry;
+  const gchar *pending;
+  gchar *prefix;
+
+  /* resolves in flight are forgotten too, their answers are dropped */
+  if (id)
+  {
+    gchar *key = _make_key(account, id);
+
+    g_hash_table_remove(cache->entries, key);
+    g_hash_table_remove(cache->pending, key);
+    g_free(key);
+
+    return;
+  }
+
+  g_hash_table_iter_init(&iter, cache->entries);
+
+  while (g_hash_table_iter_next(&iter, NULL, (gpointer *)&entry))
+  {
+    if (!g_strcmp0(entry->account, account))
+      g_hash_table_iter_remove(&iter);
+  }
+
+  prefix = g_strconcat(account, " ", NULL);
+  g_hash_table_iter_init(&iter, cache->pending);
+
+  while (g_hash_table_iter_next(&iter, (gpointer *)&pending, NULL))
+  {
+    if (g_str_has_prefix(pending, prefix))
+      g_hash_table_iter_remove(&iter);
+  }
+
+  g_free(prefix);
+}
+
+void
+nui_contact_cache_get_stats(NuiContactCache *cache, guint *hits,
+                            guint *misses)
+{
+  if (hits)
+    *hits = cache->hits;
+
+  if (misses)
+    *misses = cache->misses;
+}
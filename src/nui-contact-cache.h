@@ -0,0 +1,95 @@
+/*
+ * nui-contact-cache.h
+ *
+ * Copyright (C) 2024 Ivaylo Dimitrov <ivo.g.dimitrov.75@gmail.com>
+ *
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __NUI_CONTACT_CACHE_H__
+#define __NUI_CONTACT_CACHE_H__
+
+G_BEGIN_DECLS
+
+typedef struct _NuiContactCache NuiContactCache;
+
+/* called when a prefetched id was resolved, name is NULL if the contact
+ * has no name other than its id
+ */
+typedef void (*NuiContactCacheResolvedFunc)(const gchar *account,
+                                            const gchar *id,
+                                            const gchar *name,
+                                            gpointer user_data);
+
+/* resolves id in place of Telepathy, nui_contact_cache_resolved() is to be
+ * called once the name is known, from within the call or later
+ */
+typedef void (*NuiContactCacheResolveFunc)(NuiContactCache *cache,
+                                           const gchar *account,
+                                           const gchar *id,
+                                           gpointer user_data);
+
+/* the form ids are compared in, the trailing digits of phone numbers and
+ * other ids casefolded. free with g_free()
+ */
+gchar *nui_contact_cache_normalize(const gchar *id);
+
+NuiContactCache *nui_contact_cache_new(guint size,
+                                       NuiContactCacheResolvedFunc resolved,
+                                       gpointer user_data);
+void nui_contact_cache_free(NuiContactCache *cache);
+
+/* returns TRUE if the id is cached, *name is NULL for negative entries and
+ * stays valid until the next call into the cache
+ */
+gboolean nui_contact_cache_lookup(NuiContactCache *cache,
+                                  const gchar *account, const gchar *id,
+                                  const gchar **name);
+
+/* keeps the name up to date with the contact alias */
+void nui_contact_cache_add_contact(NuiContactCache *cache,
+                                   const gchar *account, TpContact *contact);
+
+/* resolves ids that are not cached yet, ids already being resolved are
+ * skipped. connection may be NULL if a resolver is set.
+ */
+void nui_contact_cache_prefetch(NuiContactCache *cache,
+                                TpConnection *connection,
+                                const gchar *account, const gchar *id);
+
+/* address book to resolve ids with instead of the contacts of the
+ * connection, NULL goes back to Telepathy
+ */
+void nui_contact_cache_set_resolver(NuiContactCache *cache,
+                                    NuiContactCacheResolveFunc resolve,
+                                    gpointer user_data);
+
+/* completes a resolve started by the resolver, name NULL if the address
+ * book has none. ignored if the id was invalidated meanwhile
+ */
+void nui_contact_cache_resolved(NuiContactCache *cache, const gchar *account,
+                                const gchar *id, const gchar *name);
+
+/* id NULL drops all the entries of the account. ids being resolved are
+ * resolved again on the next prefetch, late answers are ignored
+ */
+void nui_contact_cache_invalidate(NuiContactCache *cache,
+                                  const gchar *account, const gchar *id);
+
+void nui_contact_cache_get_stats(NuiContactCache *cache, guint *hits,
+                                 guint *misses);
+
+G_END_DECLS
+
+#endif /* __NUI_CONTACT_CACHE_H__ */
@@ -0,0 +1,1306 @@
+/*
+ * nui-core.c
+ *
+ * Copyright (C) 2024 Ivaylo Dimitrov <ivo.g.dimitrov.75@gmail.com>
+ *
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "config.h"
+
+#include <telepathy-glib/telepathy-glib.h>
+#include <telepathy-glib/telepathy-glib-dbus.h>
+#include <glib/gi18n-lib.h>
+
+#include "nui-core.h"
+#include "nui-call-monitor.h"
+#include "nui-counters.h"
+#include "nui-contact-cache.h"
+#include "nui-sms-filter.h"
+
+#define NUI_CLIENT_NAME "NotificationUI"
+
+#define NOTIFICATIONS_SERVICE "org.freedesktop.Notifications"
+#define NOTIFICATIONS_PATH "/org/freedesktop/Notifications"
+#define NOTIFICATIONS_INTERFACE_NAME "org.freedesktop.Notifications"
+
+/* events of the same type from the same contact that arrive within that many
+ * seconds of each other are shown as one notification
+ */
+#define NUI_CORE_COALESCE_WINDOW 60
+
+/* minimum time between two updates of the same notification, in ms */
+#define NUI_CORE_UPDATE_INTERVAL 1000
+
+/* seconds after startup or a change before the counters are checked against
+ * the channels and the open notifications
+ */
+#define NUI_CORE_RECONCILE_DELAY 30
+
+/* number of remote ids a display name is remembered for */
+#define NUI_CORE_CONTACT_CACHE_SIZE 64
+
+/* ms an SMS from oFono waits for the same one to come through Telepathy */
+#define NUI_CORE_SMS_HOLD 2000
+
+/* protocol of the accounts the SMS of the modem come through, ring */
+#define NUI_CORE_SMS_PROTOCOL "tel"
+
+struct _NuiCore
+{
+  GObject parent;
+};
+
+struct _NuiCoreClass
+{
+  GObjectClass parent_class;
+};
+
+struct _NuiCorePrivate
+{
+  TpAccountManager *am;
+  /* the accounts could not be looked up, there is no ring to wait for */
+  gboolean am_failed;
+  TpBaseClient *observer;
+  /* TpChannel to NuiCoreChannel */
+  GHashTable *channels;
+  /* channels and events collected during the current main loop iteration */
+  GPtrArray *pending_channels;
+  GPtrArray *pending_events;
+  guint batch_id;
+  /* group key to NuiCoreGroup */
+  GHashTable *groups;
+  guint flush_id;
+  /* monotonic time flush_id fires at */
+  gint64 flush_time;
+  guint notifications_created;
+  guint notifications_updated;
+  NuiCounters *counters;
+  guint reconcile_id;
+  /* nothing stored, counted from the recovered channels right away */
+  gboolean reconcile_now;
+  NuiContactCache *contacts;
+  /* SMS straight from oFono */
+  NuiCallMonitor *call_monitor;
+  NuiSmsFilter *sms_filter;
+  GDBusConnection *session_bus;
+  guint closed_id;
+  guint daemon_watch_id;
+  /* the notification daemon was looked up, notifications can be sent */
+  gboolean daemon_known;
+  GCancellable *cancellable;
+  gboolean disposed;
+};
+
+typedef struct _NuiCorePrivate NuiCorePrivate;
+
+#define PRIVATE(o) \
+    ((NuiCorePrivate *)nui_core_get_instance_private((NuiCore *)(o)))
+
+G_DEFINE_TYPE_WITH_PRIVATE(
+  NuiCore,
+  nui_core,
+  G_TYPE_OBJECT
+);
+
+enum
+{
+  COUNTERS_CHANGED,
+  LAST_SIGNAL
+};
+
+static guint signals[LAST_SIGNAL] = { 0 };
+
+typedef struct
+{
+  NuiCore *core;
+  TpChannel *channel;
+  TpAccount *account;
+  gboolean answered;
+  /* observed again after a restart, pending messages were already seen */
+  gboolean recovered;
+} NuiCoreChannel;
+
+typedef enum
+{
+  NUI_CORE_EVENT_MESSAGE,
+  NUI_CORE_EVENT_MISSED_CALL
+} NuiCoreEventType;
+
+typedef struct
+{
+  NuiCoreEventType type;
+  gchar *account;
+  TpConnection *connection;
+  TpContact *contact;
+  gchar *remote_id;
+  /* display name, resolved when the batch is processed */
+  gchar *alias;
+  gchar *text;
+  /* SMS straight from oFono, there is no channel it is pending in */
+  gboolean ofono;
+} NuiCoreEvent;
+
+typedef struct
+{
+  gchar *key;
+  NuiCoreEventType type;
+  gchar *account;
+  gchar *remote_id;
+  gchar *alias;
+  gchar *text;
+  guint count;
+  guint notified_count;
+  /* notification id, 0 if not shown yet */
+  guint32 id;
+  gboolean dirty;
+  gboolean in_flight;
+  gint64 last_event;
+  gint64 last_update;
+} NuiCoreGroup;
+
+static void
+_event_free(gpointer data)
+{
+  NuiCoreEvent *event = data;
+
+  g_free(event->account);
+  g_clear_object(&event->connection);
+  g_clear_object(&event->contact);
+  g_free(event->remote_id);
+  g_free(event->alias);
+  g_free(event->text);
+  g_slice_free(NuiCoreEvent, event);
+}
+
+static NuiCoreEvent *
+_event_new(NuiCoreEventType type, NuiCoreChannel *chan, TpContact *contact,
+           const gchar *text)
+{
+  NuiCoreEvent *event = g_slice_new0(NuiCoreEvent);
+  TpConnection *connection = tp_channel_get_connection(chan->channel);
+
+  event->type = type;
+  event->account = g_strdup(tp_proxy_get_object_path(chan->account));
+
+  if (connection)
+    event->connection = g_object_ref(connection);
+
+  if (contact)
+  {
+    event->contact = g_object_ref(contact);
+    event->remote_id = g_strdup(tp_contact_get_identifier(contact));
+  }
+  else
+    event->remote_id = g_strdup(tp_channel_get_identifier(chan->channel));
+
+  event->text = g_strdup(text);
+
+  return event;
+}
+
+static void
+_group_free(gpointer data)
+{
+  NuiCoreGroup *group = data;
+
+  g_free(group->key);
+  g_free(group->account);
+  g_free(group->remote_id);
+  g_free(group->alias);
+  g_free(group->text);
+  g_slice_free(NuiCoreGroup, group);
+}
+
+static gchar *
+_group_body(NuiCoreGroup *group)
+{
+  if (group->type == NUI_CORE_EVENT_MISSED_CALL)
+  {
+    if (group->count > 1)
+    {
+      return g_strdup_printf(
+            g_dngettext(GETTEXT_PACKAGE, "nui_fi_missed_calls",
+                        "nui_fi_missed_calls", group->count), group->count);
+    }
+
+    return g_strdup(g_dgettext(GETTEXT_PACKAGE, "nui_fi_missed_call"));
+  }
+
+  if (group->count > 1)
+  {
+    return g_strdup_printf(
+          g_dngettext(GETTEXT_PACKAGE, "nui_fi_new_messages",
+                      "nui_fi_new_messages", group->count), group->count);
+  }
+
+  return g_strdup(group->text ? group->text : "");
+}
+
+typedef struct
+{
+  NuiCore *core;
+  gchar *key;
+} NuiCoreNotifyData;
+
+static void _groups_flush(NuiCore *core);
+
+static void
+_notify_ready_cb(GObject *object, GAsyncResult *res, gpointer user_data)
+{
+  NuiCoreNotifyData *data = user_data;
+  GError *error = NULL;
+  GVariant *reply;
+
+  reply = g_dbus_connection_call_finish(G_DBUS_CONNECTION(object), res,
+                                        &error);
+
+  if (reply || !g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+  {
+    NuiCorePrivate *priv = PRIVATE(data->core);
+    NuiCoreGroup *group = g_hash_table_lookup(priv->groups, data->key);
+
+    if (group)
+    {
+      group->in_flight = FALSE;
+
+      if (reply)
+      {
+        g_variant_get(reply, "(u)", &group->id);
+
+        if (group->type == NUI_CORE_EVENT_MISSED_CALL)
+        {
+          nui_counters_set_missed(priv->counters, group->id,
+                                  group->notified_count);
+        }
+      }
+    }
+
+    /* updates that arrived while waiting for the id */
+    _groups_flush(data->core);
+  }
+
+  if (reply)
+    g_variant_unref(reply);
+  else
+  {
+    if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+      g_warning("Error showing notification [%s]", error->message);
+
+    g_error_free(error);
+  }
+
+  g_free(data->key);
+  g_slice_free(NuiCoreNotifyData, data);
+}
+
+static void
+_group_notify(NuiCore *core, NuiCoreGroup *group)
+{
+  NuiCorePrivate *priv = PRIVATE(core);
+  NuiCoreNotifyData *data;
+  GVariantBuilder hints;
+  const gchar *category;
+  const gchar *icon;
+  gchar *body;
+
+  if (group->type == NUI_CORE_EVENT_MISSED_CALL)
+  {
+    category = "missed-call";
+    icon = "general_missed";
+  }
+  else
+  {
+    category = "chat-message";
+    icon = "general_chat";
+  }
+
+  if (group->id)
+    priv->notifications_updated++;
+  else
+    priv->notifications_created++;
+
+  g_variant_builder_init(&hints, G_VARIANT_TYPE_VARDICT);
+  g_variant_builder_add(&hints, "{sv}", "category",
+                        g_variant_new_string(category));
+
+  data = g_slice_new(NuiCoreNotifyData);
+  data->core = core;
+  data->key = g_strdup(group->key);
+  body = _group_body(group);
+
+  g_dbus_connection_call(
+        priv->session_bus, NOTIFICATIONS_SERVICE, NOTIFICATIONS_PATH,
+        NOTIFICATIONS_INTERFACE_NAME, "Notify",
+        g_variant_new("(susssasa{sv}i)", PACKAGE_NAME, group->id, icon,
+                      group->alias ? group->alias : "", body, NULL, &hints,
+                      -1),
+        G_VARIANT_TYPE("(u)"), G_DBUS_CALL_FLAGS_NONE, -1, priv->cancellable,
+        _notify_ready_cb, data);
+
+  g_free(body);
+  group->notified_count = group->count;
+  group->dirty = FALSE;
+  group->in_flight = TRUE;
+  group->last_update = g_get_monotonic_time();
+}
+
+static gboolean
+_groups_flush_cb(gpointer user_data)
+{
+  PRIVATE(user_data)->flush_id = 0;
+  _groups_flush(user_data);
+
+  return G_SOURCE_REMOVE;
+}
+
+/* a burst is over once nothing came within the window, the next event
+ * starts a new notification
+ */
+static gboolean
+_group_is_stale(NuiCoreGroup *group, gint64 now)
+{
+  return !group->dirty && !group->in_flight &&
+      now - group->last_event > NUI_CORE_COALESCE_WINDOW * G_USEC_PER_SEC;
+}
+
+static void
+_groups_flush(NuiCore *core)
+{
+  NuiCorePrivate *priv = PRIVATE(core);
+  gint64 now = g_get_monotonic_time();
+  gint64 next = 0;
+  GHashTableIter iter;
+  NuiCoreGroup *group;
+
+  g_hash_table_iter_init(&iter, priv->groups);
+
+  while (g_hash_table_iter_next(&iter, NULL, (gpointer *)&group))
+  {
+    gint64 due;
+
+    if (group->in_flight)
+      continue;
+
+    if (!group->dirty)
+    {
+      if (_group_is_stale(group, now))
+      {
+        g_hash_table_iter_remove(&iter);
+        continue;
+      }
+
+      /* wake up once the group expires, not at the next event */
+      due = group->last_event + NUI_CORE_COALESCE_WINDOW * G_USEC_PER_SEC;
+    }
+    else
+    {
+      due = group->last_update + NUI_CORE_UPDATE_INTERVAL * 1000;
+
+      if (!group->last_update || due <= now)
+      {
+        _group_notify(core, group);
+        continue;
+      }
+    }
+
+    if (!next || due < next)
+      next = due;
+  }
+
+  /* an expiry timer must not hold back a rate limited update */
+  if (priv->flush_id && (!next || next < priv->flush_time))
+  {
+    g_source_remove(priv->flush_id);
+    priv->flush_id = 0;
+  }
+
+  if (next && !priv->flush_id)
+  {
+    priv->flush_time = next;
+    priv->flush_id = g_timeout_add((next - now) / 1000 + 1, _groups_flush_cb,
+                                   core);
+  }
+}
+
+static void
+_event_resolve(NuiCore *core, NuiCoreEvent *event)
+{
+  NuiCorePrivate *priv = PRIVATE(core);
+  const gchar *name;
+
+  if (nui_contact_cache_lookup(priv->contacts, event->account,
+                               event->remote_id, &name))
+  {
+    event->alias = g_strdup(name ? name : event->remote_id);
+  }
+  else if (event->contact)
+  {
+    nui_contact_cache_add_contact(priv->contacts, event->account,
+                                  event->contact);
+    event->alias = g_strdup(tp_contact_get_alias(event->contact));
+  }
+  else
+  {
+    /* shown with the id for now, updated when the name is known */
+    if (event->connection)
+    {
+      nui_contact_cache_prefetch(priv->contacts, event->connection,
+                                 event->account, event->remote_id);
+    }
+
+    event->alias = g_strdup(event->remote_id);
+  }
+}
+
+static void
+_contact_resolved_cb(const gchar *account, const gchar *id,
+                     const gchar *name, gpointer user_data)
+{
+  NuiCorePrivate *priv = PRIVATE(user_data);
+  GHashTableIter iter;
+  NuiCoreGroup *group;
+
+  if (!name)
+    return;
+
+  g_hash_table_iter_init(&iter, priv->groups);
+
+  while (g_hash_table_iter_next(&iter, NULL, (gpointer *)&group))
+  {
+    if (!g_strcmp0(group->remote_id, id) &&
+        !g_strcmp0(group->account, account) &&
+        g_strcmp0(group->alias, name))
+    {
+      g_free(group->alias);
+      group->alias = g_strdup(name);
+      group->dirty = TRUE;
+    }
+  }
+
+  if (priv->daemon_known)
+    _groups_flush(user_data);
+}
+
+static void
+_event_coalesce(NuiCore *core, NuiCoreEvent *event)
+{
+  NuiCorePrivate *priv = PRIVATE(core);
+  gint64 now = g_get_monotonic_time();
+  NuiCoreGroup *group;
+  gchar *key;
+
+  key = g_strdup_printf("%d:%s:%s", event->type, event->account,
+                        event->remote_id ? event->remote_id : "");
+  group = g_hash_table_lookup(priv->groups, key);
+
+  /* the expiry timer may not have run yet */
+  if (group && _group_is_stale(group, now))
+  {
+    g_hash_table_remove(priv->groups, key);
+    group = NULL;
+  }
+
+  if (!group)
+  {
+    group = g_slice_new0(NuiCoreGroup);
+    group->key = key;
+    group->type = event->type;
+    group->account = g_strdup(event->account);
+    group->remote_id = g_strdup(event->remote_id);
+    g_hash_table_insert(priv->groups, key, group);
+  }
+  else
+    g_free(key);
+
+  g_free(group->alias);
+  group->alias = g_strdup(event->alias);
+  g_free(group->text);
+  group->text = g_strdup(event->text);
+  group->count++;
+  group->dirty = TRUE;
+
+  /* unread messages are the ones pending in channels, reconcile counts
+   * them the same way
+   */
+  if (event->type == NUI_CORE_EVENT_MISSED_CALL)
+    nui_counters_add(priv->counters, NUI_COUNTER_MISSED_CALLS, 1);
+  else if (!event->ofono)
+    nui_counters_add(priv->counters, NUI_COUNTER_UNREAD_MESSAGES, 1);
+  group->last_event = now;
+}
+
+static void
+_counters_reconcile(NuiCore *core)
+{
+  NuiCorePrivate *priv = PRIVATE(core);
+  GHashTableIter iter;
+  NuiCoreChannel *chan;
+  NuiCoreGroup *group;
+  gboolean changed = FALSE;
+  guint unread = 0;
+  guint missed;
+
+  if (priv->reconcile_id)
+  {
+    g_source_remove(priv->reconcile_id);
+    priv->reconcile_id = 0;
+  }
+
+  priv->reconcile_now = FALSE;
+
+  /* pending messages of the observed channels are what is really unread */
+  g_hash_table_iter_init(&iter, priv->channels);
+
+  while (g_hash_table_iter_next(&iter, NULL, (gpointer *)&chan))
+  {
+    GList *messages, *l;
+
+    if (!TP_IS_TEXT_CHANNEL(chan->channel))
+      continue;
+
+    messages = tp_text_channel_dup_pending_messages(
+          TP_TEXT_CHANNEL(chan->channel));
+
+    for (l = messages; l; l = l->next)
+    {
+      if (!tp_message_is_delivery_report(l->data))
+        unread++;
+    }
+
+    g_list_free_full(messages, g_object_unref);
+  }
+
+  if (nui_counters_get(priv->counters, NUI_COUNTER_UNREAD_MESSAGES) != unread)
+  {
+    g_debug("Unread messages reconciled to %u", unread);
+    nui_counters_set(priv->counters, NUI_COUNTER_UNREAD_MESSAGES, unread);
+    changed = TRUE;
+  }
+
+  /* missed calls are the ones the open notifications show, plus the ones
+   * not shown yet
+   */
+  missed = nui_counters_get_missed_total(priv->counters);
+  g_hash_table_iter_init(&iter, priv->groups);
+
+  while (g_hash_table_iter_next(&iter, NULL, (gpointer *)&group))
+  {
+    if (group->type == NUI_CORE_EVENT_MISSED_CALL)
+    {
+      guint shown = nui_counters_get_missed(priv->counters, group->id);
+
+      if (group->count > shown)
+        missed += group->count - shown;
+    }
+  }
+
+  if (nui_counters_get(priv->counters, NUI_COUNTER_MISSED_CALLS) != missed)
+  {
+    g_debug("Missed calls reconciled to %u", missed);
+    nui_counters_set(priv->counters, NUI_COUNTER_MISSED_CALLS, missed);
+    changed = TRUE;
+  }
+
+  if (changed)
+    g_signal_emit(core, signals[COUNTERS_CHANGED], 0);
+}
+
+static gboolean
+_counters_reconcile_cb(gpointer user_data)
+{
+  NuiCorePrivate *priv = PRIVATE(user_data);
+
+  priv->reconcile_id = 0;
+
+  /* events not counted yet, the batch schedules another check */
+  if (!priv->batch_id)
+    _counters_reconcile(user_data);
+
+  return G_SOURCE_REMOVE;
+}
+
+/* the counters are kept incrementally, checking them is left for when
+ * things calmed down
+ */
+static void
+_counters_reconcile_schedule(NuiCore *core)
+{
+  NuiCorePrivate *priv = PRIVATE(core);
+
+  if (!priv->reconcile_id)
+  {
+    priv->reconcile_id = g_timeout_add_seconds_full(
+          G_PRIORITY_LOW, NUI_CORE_RECONCILE_DELAY, _counters_reconcile_cb,
+          core, NULL);
+  }
+}
+
+static void
+_notification_closed_cb(GDBusConnection *connection,
+                        const gchar *sender_name, const gchar *object_path,
+                        const gchar *interface_name, const gchar *signal_name,
+                        GVariant *parameters, gpointer user_data)
+{
+  NuiCorePrivate *priv = PRIVATE(user_data);
+  GHashTableIter iter;
+  NuiCoreGroup *group;
+  guint missed;
+  guint32 id;
+
+  if (!g_variant_is_of_type(parameters, G_VARIANT_TYPE("(uu)")))
+    return;
+
+  g_variant_get(parameters, "(uu)", &id, NULL);
+
+  /* closing a missed-call notification means the calls were seen */
+  missed = nui_counters_get_missed(priv->counters, id);
+
+  if (missed)
+  {
+    /* a slot never holds more than was counted */
+    missed = MIN(missed, nui_counters_get(priv->counters,
+                                          NUI_COUNTER_MISSED_CALLS));
+    nui_counters_add(priv->counters, NUI_COUNTER_MISSED_CALLS,
+                     -(gint)MIN(missed, G_MAXINT));
+    nui_counters_set_missed(priv->counters, id, 0);
+    g_signal_emit(user_data, signals[COUNTERS_CHANGED], 0);
+    _counters_reconcile_schedule(user_data);
+  }
+
+  g_hash_table_iter_init(&iter, priv->groups);
+
+  while (g_hash_table_iter_next(&iter, NULL, (gpointer *)&group))
+  {
+    if (group->id == id)
+    {
+      if (group->in_flight)
+        group->id = 0;
+      else
+        g_hash_table_iter_remove(&iter);
+
+      break;
+    }
+  }
+}
+
+static void
+_channel_free(gpointer data)
+{
+  NuiCoreChannel *chan = data;
+
+  g_signal_handlers_disconnect_matched(chan->channel, G_SIGNAL_MATCH_DATA,
+                                       0, 0, NULL, NULL, chan);
+  g_object_unref(chan->channel);
+  g_object_unref(chan->account);
+  g_slice_free(NuiCoreChannel, chan);
+}
+
+static gboolean _batch_cb(gpointer user_data);
+
+static void
+_batch_schedule(NuiCore *core)
+{
+  NuiCorePrivate *priv = PRIVATE(core);
+
+  /* everything arriving in the same main loop iteration is one batch */
+  if (!priv->batch_id && priv->daemon_known)
+    priv->batch_id = g_idle_add(_batch_cb, core);
+}
+
+static void
+_message_add(NuiCoreChannel *chan, TpSignalledMessage *message)
+{
+  NuiCorePrivate *priv = PRIVATE(chan->core);
+  TpMessage *msg = TP_MESSAGE(message);
+  NuiCoreEvent *event;
+  gchar *text;
+
+  if (tp_message_is_delivery_report(msg))
+    return;
+
+  text = tp_message_to_text(msg, NULL);
+  event = _event_new(NUI_CORE_EVENT_MESSAGE, chan,
+                     tp_signalled_message_get_sender(msg), text);
+  g_free(text);
+
+  /* the oFono copy of an SMS is not shown again, IM from the same number
+   * on another account is no SMS
+   */
+  if (!g_strcmp0(tp_account_get_protocol_name(chan->account),
+                 NUI_CORE_SMS_PROTOCOL))
+  {
+    nui_sms_filter_seen(priv->sms_filter, event->remote_id);
+  }
+
+  g_ptr_array_add(priv->pending_events, event);
+}
+
+static void
+_message_received_cb(TpTextChannel *channel, TpSignalledMessage *message,
+                     gpointer user_data)
+{
+  NuiCoreChannel *chan = user_data;
+
+  _message_add(chan, message);
+  _batch_schedule(chan->core);
+}
+
+static void
+_pending_message_removed_cb(TpTextChannel *channel,
+                           TpSignalledMessage *message, gpointer user_data)
+{
+  NuiCoreChannel *chan = user_data;
+
+  if (tp_message_is_delivery_report(TP_MESSAGE(message)))
+    return;
+
+  nui_counters_add(PRIVATE(chan->core)->counters,
+                   NUI_COUNTER_UNREAD_MESSAGES, -1);
+  g_signal_emit(chan->core, signals[COUNTERS_CHANGED], 0);
+  _counters_reconcile_schedule(chan->core);
+}
+
+static void
+_call_state_changed_cb(TpCallChannel *channel, guint state, guint flags,
+                       TpCallStateReason *reason, GHashTable *details,
+                       gpointer user_data)
+{
+  NuiCoreChannel *chan = user_data;
+
+  if (state == TP_CALL_STATE_ACCEPTED || state == TP_CALL_STATE_ACTIVE)
+    chan->answered = TRUE;
+}
+
+static void
+_channel_invalidated_cb(TpProxy *proxy, guint domain, gint code,
+                        gchar *message, gpointer user_data)
+{
+  NuiCoreChannel *chan = user_data;
+  NuiCore *core = chan->core;
+  NuiCorePrivate *priv = PRIVATE(core);
+
+  if (TP_IS_CALL_CHANNEL(chan->channel) && !chan->answered)
+  {
+    g_ptr_array_add(priv->pending_events,
+                    _event_new(NUI_CORE_EVENT_MISSED_CALL, chan,
+                               tp_channel_get_target_contact(chan->channel),
+                               NULL));
+    _batch_schedule(core);
+  }
+
+  /* closed before the batch got to it, chan is about to be freed */
+  g_ptr_array_remove(priv->pending_channels, chan);
+  g_hash_table_remove(priv->channels, chan->channel);
+}
+
+/* called for the channels observed since the last batch */
+static void
+_channel_process(NuiCoreChannel *chan)
+{
+  if (TP_IS_TEXT_CHANNEL(chan->channel))
+  {
+    TpTextChannel *text = TP_TEXT_CHANNEL(chan->channel);
+
+    if (!chan->recovered)
+    {
+      GList *messages = tp_text_channel_dup_pending_messages(text);
+      GList *l;
+
+      for (l = messages; l; l = l->next)
+        _message_add(chan, l->data);
+
+      g_list_free_full(messages, g_object_unref);
+    }
+
+    g_signal_connect(text, "message-received",
+                     G_CALLBACK(_message_received_cb), chan);
+    g_signal_connect(text, "pending-message-removed",
+                     G_CALLBACK(_pending_message_removed_cb), chan);
+  }
+}
+
+/* called right away, a channel may go before the batch runs and a call
+ * still has to be told missed or not then
+ */
+static void
+_channel_watch(NuiCoreChannel *chan)
+{
+  g_signal_connect(chan->channel, "invalidated",
+                   G_CALLBACK(_channel_invalidated_cb), chan);
+
+  if (TP_IS_CALL_CHANNEL(chan->channel))
+  {
+    TpCallChannel *call = TP_CALL_CHANNEL(chan->channel);
+    TpCallState state = tp_call_channel_get_state(call, NULL, NULL, NULL);
+
+    chan->answered = tp_channel_get_requested(chan->channel) ||
+        state == TP_CALL_STATE_ACCEPTED || state == TP_CALL_STATE_ACTIVE;
+    g_signal_connect(call, "state-changed",
+                     G_CALLBACK(_call_state_changed_cb), chan);
+  }
+}
+
+static gboolean
+_batch_cb(gpointer user_data)
+{
+  NuiCore *core = user_data;
+  NuiCorePrivate *priv = PRIVATE(core);
+  GPtrArray *events;
+  guint channels;
+  guint i;
+
+  priv->batch_id = 0;
+  channels = priv->pending_channels->len;
+
+  for (i = 0; i < channels; i++)
+    _channel_process(g_ptr_array_index(priv->pending_channels, i));
+
+  g_ptr_array_set_size(priv->pending_channels, 0);
+
+  events = priv->pending_events;
+  priv->pending_events = g_ptr_array_new_with_free_func(_event_free);
+
+  g_debug("Processing %u channel events", events->len);
+
+  for (i = 0; i < events->len; i++)
+  {
+    NuiCoreEvent *event = g_ptr_array_index(events, i);
+
+    _event_resolve(core, event);
+    _event_coalesce(core, event);
+  }
+
+  if (events->len)
+  {
+    guint hits, misses;
+
+    nui_contact_cache_get_stats(priv->contacts, &hits, &misses);
+    g_debug("Contact cache %u hits, %u misses", hits, misses);
+    g_signal_emit(core, signals[COUNTERS_CHANGED], 0);
+  }
+
+  _groups_flush(core);
+
+  if (channels && priv->reconcile_now)
+    _counters_reconcile(core);
+  else if (channels || events->len)
+    _counters_reconcile_schedule(core);
+
+  g_ptr_array_unref(events);
+
+  g_debug("%u notifications created, %u updated",
+          priv->notifications_created, priv->notifications_updated);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+_observe_channels_cb(TpSimpleObserver *observer, TpAccount *account,
+                     TpConnection *connection, GList *channels,
+                     TpChannelDispatchOperation *dispatch_operation,
+                     GList *requests, TpObserveChannelsContext *context,
+                     gpointer user_data)
+{
+  NuiCore *core = user_data;
+  NuiCorePrivate *priv = PRIVATE(core);
+  GList *l;
+
+  for (l = channels; l; l = l->next)
+  {
+    TpChannel *channel = l->data;
+    NuiCoreChannel *chan;
+
+    if (g_hash_table_lookup(priv->channels, channel))
+      continue;
+
+    chan = g_slice_new0(NuiCoreChannel);
+    chan->core = core;
+    chan->channel = g_object_ref(channel);
+    chan->account = g_object_ref(account);
+    chan->recovered = tp_observe_channels_context_is_recovering(context);
+    g_hash_table_insert(priv->channels, channel, chan);
+    g_ptr_array_add(priv->pending_channels, chan);
+    _channel_watch(chan);
+  }
+
+  /* features are already prepared by the factory, nothing to wait for */
+  tp_observe_channels_context_accept(context);
+  _batch_schedule(core);
+}
+
+static void
+_observer_add_filter(TpBaseClient *client, const gchar *channel_type)
+{
+  tp_base_client_take_observer_filter(
+        client,
+        tp_asv_new(
+          TP_PROP_CHANNEL_CHANNEL_TYPE, G_TYPE_STRING, channel_type,
+          TP_PROP_CHANNEL_TARGET_HANDLE_TYPE, G_TYPE_UINT,
+          TP_HANDLE_TYPE_CONTACT,
+          NULL));
+}
+
+/* TRUE until the accounts are known, the hold is short anyway */
+static gboolean
+_sms_account_online(NuiCore *core)
+{
+  TpAccountManager *am = PRIVATE(core)->am;
+  GList *accounts, *l;
+  gboolean online = FALSE;
+
+  if (PRIVATE(core)->am_failed)
+    return FALSE;
+
+  if (!tp_proxy_is_prepared(am, TP_ACCOUNT_MANAGER_FEATURE_CORE))
+    return TRUE;
+
+  accounts = tp_account_manager_dup_valid_accounts(am);
+
+  for (l = accounts; l && !online; l = l->next)
+  {
+    online = !g_strcmp0(tp_account_get_protocol_name(l->data),
+                        NUI_CORE_SMS_PROTOCOL) &&
+        tp_account_get_connection_status(l->data, NULL) ==
+        TP_CONNECTION_STATUS_CONNECTED;
+  }
+
+  g_list_free_full(accounts, g_object_unref);
+
+  return online;
+}
+
+static void
+_messages_received_cb(NuiCallMonitor *monitor, GVariant *messages,
+                      gpointer user_data)
+{
+  NuiCore *core = user_data;
+  NuiCorePrivate *priv = PRIVATE(core);
+  GVariantIter i;
+  const gchar *modem;
+  const gchar *text;
+  gboolean immediate;
+  GVariant *info;
+  gboolean hold;
+
+  /* nothing to wait for if ring cannot deliver them */
+  hold = _sms_account_online(core);
+
+  /* the monitor already batches them per main loop iteration, the filter
+   * hands them over in bursts as well
+   */
+  g_variant_iter_init(&i, messages);
+
+  while (g_variant_iter_loop(&i, "(&o&sb@a{sv})", &modem, &text, &immediate,
+                             &info))
+  {
+    NuiCoreEvent *event;
+    gchar *sender;
+
+    /* there is no one to group it under or to show it from */
+    if (!g_variant_lookup(info, "Sender", "s", &sender))
+    {
+      g_debug("SMS on %s without sender ignored", modem);
+      continue;
+    }
+
+    event = g_slice_new0(NuiCoreEvent);
+    event->type = NUI_CORE_EVENT_MESSAGE;
+    event->account = g_strdup(modem);
+    event->remote_id = sender;
+    event->text = g_strdup(text);
+    event->ofono = TRUE;
+
+    /* the same SMS usually comes through the ring text channel too */
+    if (hold)
+      nui_sms_filter_hold(priv->sms_filter, event->remote_id, event);
+    else
+      g_ptr_array_add(priv->pending_events, event);
+  }
+
+  if (!hold)
+    _batch_schedule(core);
+}
+
+static void
+_sms_released_cb(gpointer message, gpointer user_data)
+{
+  g_ptr_array_add(PRIVATE(user_data)->pending_events, message);
+  _batch_schedule(user_data);
+}
+
+static void
+_am_prepared_cb(GObject *object, GAsyncResult *res, gpointer user_data)
+{
+  GError *error = NULL;
+
+  /* until then oFono SMS are held as if ring was online, without mission
+   * control there is nothing to hold them for
+   */
+  if (!tp_proxy_prepare_finish(object, res, &error))
+  {
+    g_debug("Account manager not available [%s]", error->message);
+    g_error_free(error);
+    PRIVATE(user_data)->am_failed = TRUE;
+  }
+
+  g_object_unref(user_data);
+}
+
+static void
+_account_removed_cb(TpAccountManager *am, TpAccount *account,
+                    gpointer user_data)
+{
+  nui_contact_cache_invalidate(PRIVATE(user_data)->contacts,
+                               tp_proxy_get_object_path(account), NULL);
+}
+
+/* a new daemon does not know the ids the old one gave out, there is
+ * nothing open anymore
+ */
+static void
+_daemon_changed(NuiCore *core, const gchar *owner)
+{
+  NuiCorePrivate *priv = PRIVATE(core);
+  GHashTableIter iter;
+  NuiCoreGroup *group;
+
+  if (!priv->daemon_known)
+  {
+    /* ids stored by a previous run are only dropped if they are stale,
+     * nothing was shown by this one yet
+     */
+    priv->daemon_known = TRUE;
+
+    if (nui_counters_set_missed_owner(priv->counters, owner))
+      _counters_reconcile(core);
+
+    _batch_schedule(core);
+
+    return;
+  }
+
+  if (!nui_counters_set_missed_owner(priv->counters, owner))
+    return;
+
+  g_debug("Notification daemon changed to %s", owner ? owner : "none");
+
+  g_hash_table_iter_init(&iter, priv->groups);
+
+  while (g_hash_table_iter_next(&iter, NULL, (gpointer *)&group))
+  {
+    /* the id in the reply is the one of the new daemon */
+    if (group->in_flight)
+      group->id = 0;
+    else
+      g_hash_table_iter_remove(&iter);
+  }
+
+  _counters_reconcile(core);
+}
+
+static void
+_daemon_appeared_cb(GDBusConnection *connection, const gchar *name,
+                    const gchar *name_owner, gpointer user_data)
+{
+  _daemon_changed(user_data, name_owner);
+}
+
+static void
+_daemon_vanished_cb(GDBusConnection *connection, const gchar *name,
+                    gpointer user_data)
+{
+  _daemon_changed(user_data, NULL);
+}
+
+static void
+_session_bus_ready_cb(GObject *object, GAsyncResult *res, gpointer user_data)
+{
+  GDBusConnection *connection;
+  GError *error = NULL;
+
+  connection = g_bus_get_finish(res, &error);
+
+  if (!connection)
+  {
+    if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+      g_warning("Error getting session bus [%s]", error->message);
+
+    g_error_free(error);
+    return;
+  }
+
+  PRIVATE(user_data)->session_bus = connection;
+  PRIVATE(user_data)->closed_id = g_dbus_connection_signal_subscribe(
+        connection, NOTIFICATIONS_SERVICE, NOTIFICATIONS_INTERFACE_NAME,
+        "NotificationClosed", NOTIFICATIONS_PATH, NULL,
+        G_DBUS_SIGNAL_FLAGS_NONE, _notification_closed_cb, user_data, NULL);
+
+  /* batches wait for the first answer, so every id stored from now on
+   * belongs to a known daemon
+   */
+  PRIVATE(user_data)->daemon_watch_id = g_bus_watch_name_on_connection(
+        connection, NOTIFICATIONS_SERVICE, G_BUS_NAME_WATCHER_FLAGS_NONE,
+        _daemon_appeared_cb, _daemon_vanished_cb, user_data, NULL);
+}
+
+static void
+nui_core_init(NuiCore *core)
+{
+  NuiCorePrivate *priv = PRIVATE(core);
+  TpSimpleClientFactory *factory;
+  GError *error = NULL;
+
+  priv->channels = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+                                         NULL, _channel_free);
+  priv->pending_channels = g_ptr_array_new();
+  priv->pending_events = g_ptr_array_new_with_free_func(_event_free);
+  priv->groups = g_hash_table_new_full(g_str_hash, g_str_equal, NULL,
+                                       _group_free);
+  priv->cancellable = g_cancellable_new();
+
+  /* stored counters are served right away, checked when the system is idle */
+  priv->counters = nui_counters_open();
+  priv->reconcile_now = nui_counters_is_fresh(priv->counters);
+  priv->contacts = nui_contact_cache_new(NUI_CORE_CONTACT_CACHE_SIZE,
+                                         _contact_resolved_cb, core);
+  _counters_reconcile_schedule(core);
+  priv->sms_filter = nui_sms_filter_new(NUI_CORE_SMS_HOLD, _sms_released_cb,
+                                        _event_free, core);
+
+  g_bus_get(G_BUS_TYPE_SESSION, priv->cancellable, _session_bus_ready_cb,
+            core);
+
+  priv->call_monitor = nui_call_monitor_dup_default();
+  g_signal_connect(priv->call_monitor, "messages-received",
+                   G_CALLBACK(_messages_received_cb), core);
+
+  /* one account manager and one set of features for all the channels */
+  priv->am = tp_account_manager_dup();
+  factory = tp_proxy_get_factory(priv->am);
+  tp_simple_client_factory_add_channel_features_varargs(
+        factory, TP_CHANNEL_FEATURE_CONTACTS, 0);
+  tp_simple_client_factory_add_contact_features_varargs(
+        factory, TP_CONTACT_FEATURE_ALIAS, TP_CONTACT_FEATURE_INVALID);
+  g_signal_connect(priv->am, "account-removed",
+                   G_CALLBACK(_account_removed_cb), core);
+  tp_proxy_prepare_async(priv->am, NULL, _am_prepared_cb,
+                         g_object_ref(core));
+
+  /* observer only, an approver would have to pick a handler for every
+   * channel. there is nothing to pick from without the messaging UI, and
+   * approving right away would take incoming calls from the call UI
+   */
+  priv->observer = tp_simple_observer_new_with_am(
+        priv->am, TRUE, NUI_CLIENT_NAME, FALSE, _observe_channels_cb, core,
+        NULL);
+
+  _observer_add_filter(priv->observer, TP_IFACE_CHANNEL_TYPE_TEXT);
+  _observer_add_filter(priv->observer, TP_IFACE_CHANNEL_TYPE_CALL);
+
+  if (!tp_base_client_register(priv->observer, &error))
+  {
+    g_warning("Error registering %s observer [%s]", NUI_CLIENT_NAME,
+              error->message);
+    g_error_free(error);
+  }
+}
+
+static void
+nui_core_dispose(GObject *object)
+{
+  NuiCorePrivate *priv = PRIVATE(object);
+
+  if (!priv->disposed)
+  {
+    g_cancellable_cancel(priv->cancellable);
+    g_object_unref(priv->cancellable);
+
+    if (priv->batch_id)
+      g_source_remove(priv->batch_id);
+
+    if (priv->flush_id)
+      g_source_remove(priv->flush_id);
+
+    if (priv->reconcile_id)
+      g_source_remove(priv->reconcile_id);
+
+    tp_base_client_unregister(priv->observer);
+    g_object_unref(priv->observer);
+
+    g_ptr_array_unref(priv->pending_events);
+    g_ptr_array_unref(priv->pending_channels);
+    g_hash_table_unref(priv->channels);
+    g_hash_table_unref(priv->groups);
+    g_signal_handlers_disconnect_by_func(priv->am, _account_removed_cb,
+                                         object);
+    g_signal_handlers_disconnect_by_func(priv->call_monitor,
+                                         _messages_received_cb, object);
+    g_object_unref(priv->call_monitor);
+    nui_sms_filter_free(priv->sms_filter);
+    nui_counters_close(priv->counters);
+    nui_contact_cache_free(priv->contacts);
+    g_object_unref(priv->am);
+
+    if (priv->session_bus)
+    {
+      g_bus_unwatch_name(priv->daemon_watch_id);
+      g_dbus_connection_signal_unsubscribe(priv->session_bus,
+                                           priv->closed_id);
+      g_object_unref(priv->session_bus);
+    }
+
+    priv->disposed = TRUE;
+    G_OBJECT_CLASS(nui_core_parent_class)->dispose(object);
+  }
+}
+
+static void
+nui_core_class_init(NuiCoreClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS(klass);
+
+  object_class->dispose = nui_core_dispose;
+
+  signals[COUNTERS_CHANGED] =
+      g_signal_new(
+        "counters-changed",
+        G_TYPE_FROM_CLASS(klass),
+        G_SIGNAL_RUN_LAST, 0, NULL, NULL,
+        g_cclosure_marshal_VOID__VOID,
+        G_TYPE_NONE,
+        0);
+}
+
+gpointer nui_core_new()
+{
+  return g_object_new(NUI_TYPE_CORE, NULL);
+}
+
+guint
+nui_core_get_unread_messages(NuiCore *core)
+{
+  g_return_val_if_fail(NUI_IS_CORE(core), 0);
+
+  return nui_counters_get(PRIVATE(core)->counters,
+                          NUI_COUNTER_UNREAD_MESSAGES);
+}
+
+guint
+nui_core_get_missed_calls(NuiCore *core)
+{
+  g_return_val_if_fail(NUI_IS_CORE(core), 0);
+
+  return nui_counters_get(PRIVATE(core)->counters, NUI_COUNTER_MISSED_CALLS);
+}
@@ -36,6 +36,10 @@ GType nui_core_get_type(void) G_GNUC_CONST;
 
 gpointer nui_core_new();
 
+/* persisted across restarts, "counters-changed" is emitted on change */
+guint nui_core_get_unread_messages(NuiCore *core);
+guint nui_core_get_missed_calls(NuiCore *core);
+
 G_END_DECLS
 
 #endif /* __NUI_CORE_H__ */
@@ -0,0 +1,305 @@
+/*
+ * nui-counters.c
+ *
+ * Copyright (C) 2024 Ivaylo Dimitrov <ivo.g.dimitrov.75@gmail.com>
+ *
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "config.h"
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "nui-counters.h"
+
+#define NUI_COUNTERS_MAGIC 0x4e554943 /* NUIC */
+#define NUI_COUNTERS_VERSION 3
+
+/* missed-call notifications remembered, the oldest goes when full */
+#define NUI_COUNTERS_MISSED_MAX 32
+
+/* room for a D-Bus unique name */
+#define NUI_COUNTERS_OWNER_MAX 64
+
+typedef struct
+{
+  /* notification id, 0 for a free slot */
+  guint32 id;
+  guint32 count;
+  /* order the slots were taken in, ids are not */
+  guint32 serial;
+} NuiCountersMissed;
+
+typedef struct
+{
+  guint32 magic;
+  guint32 version;
+  guint32 counts[NUI_COUNTER_LAST];
+  NuiCountersMissed missed[NUI_COUNTERS_MISSED_MAX];
+  guint32 missed_serial;
+  /* notification daemon the missed ids were given by */
+  gchar missed_owner[NUI_COUNTERS_OWNER_MAX];
+} NuiCountersFile;
+
+struct _NuiCounters
+{
+  NuiCountersFile *file;
+  gboolean mapped;
+  gboolean fresh;
+};
+
+static void
+_counters_reset(NuiCounters *counters)
+{
+  memset(counters->file, 0, sizeof(*counters->file));
+  counters->file->magic = NUI_COUNTERS_MAGIC;
+  counters->file->version = NUI_COUNTERS_VERSION;
+  counters->fresh = TRUE;
+}
+
+static NuiCountersFile *
+_counters_map(void)
+{
+  NuiCountersFile *file = NULL;
+  gchar *dir;
+  gchar *path;
+  int fd;
+
+  dir = g_build_filename(g_get_user_cache_dir(), PACKAGE_NAME, NULL);
+  path = g_build_filename(dir, "counters", NULL);
+
+  if (g_mkdir_with_parents(dir, 0700))
+  {
+    g_warning("Unable to create %s [%s]", dir, g_strerror(errno));
+    goto out;
+  }
+
+  fd = g_open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+
+  if (fd == -1)
+  {
+    g_warning("Unable to open %s [%s]", path, g_strerror(errno));
+    goto out;
+  }
+
+  /* extends a new file with zeroes, which fails the magic check below */
+  if (ftruncate(fd, sizeof(*file)) == 0)
+  {
+    file = mmap(NULL, sizeof(*file), PROT_READ | PROT_WRITE, MAP_SHARED, fd,
+                0);
+
+    if (file == MAP_FAILED)
+    {
+      g_warning("Unable to map %s [%s]", path, g_strerror(errno));
+      file = NULL;
+    }
+  }
+  else
+    g_warning("Unable to resize %s [%s]", path, g_strerror(errno));
+
+  close(fd);
+
+out:
+  g_free(path);
+  g_free(dir);
+
+  return file;
+}
+
+NuiCounters *
+nui_counters_open(void)
+{
+  NuiCounters *counters = g_slice_new0(NuiCounters);
+
+  counters->file = _counters_map();
+
+  if (counters->file)
+    counters->mapped = TRUE;
+  else
+    counters->file = g_slice_new0(NuiCountersFile);
+
+  if (counters->file->magic != NUI_COUNTERS_MAGIC ||
+      counters->file->version != NUI_COUNTERS_VERSION)
+  {
+    _counters_reset(counters);
+  }
+
+  return counters;
+}
+
+void
+nui_counters_close(NuiCounters *counters)
+{
+  if (counters->mapped)
+    munmap(counters->file, sizeof(*counters->file));
+  else
+    g_slice_free(NuiCountersFile, counters->file);
+
+  g_slice_free(NuiCounters, counters);
+}
+
+guint
+nui_counters_get(NuiCounters *counters, NuiCounter counter)
+{
+  g_return_val_if_fail(counter < NUI_COUNTER_LAST, 0);
+
+  return counters->file->counts[counter];
+}
+
+void
+nui_counters_add(NuiCounters *counters, NuiCounter counter, gint delta)
+{
+  guint32 *count;
+
+  g_return_if_fail(counter < NUI_COUNTER_LAST);
+
+  count = &counters->file->counts[counter];
+
+  if (delta < 0 && (guint32)-delta > *count)
+    *count = 0;
+  else
+    *count += delta;
+}
+
+void
+nui_counters_set(NuiCounters *counters, NuiCounter counter, guint value)
+{
+  g_return_if_fail(counter < NUI_COUNTER_LAST);
+
+  counters->file->counts[counter] = value;
+}
+
+gboolean
+nui_counters_is_fresh(NuiCounters *counters)
+{
+  return counters->fresh;
+}
+
+static NuiCountersMissed *
+_missed_find(NuiCounters *counters, guint32 id)
+{
+  NuiCountersMissed *missed = counters->file->missed;
+  int i;
+
+  for (i = 0; i < NUI_COUNTERS_MISSED_MAX; i++)
+  {
+    if (missed[i].id == id)
+      return &missed[i];
+  }
+
+  return NULL;
+}
+
+void
+nui_counters_set_missed(NuiCounters *counters, guint32 id, guint count)
+{
+  NuiCountersMissed *missed;
+
+  g_return_if_fail(id != 0);
+
+  missed = _missed_find(counters, id);
+
+  if (!count)
+  {
+    if (missed)
+      missed->id = missed->count = 0;
+
+    return;
+  }
+
+  if (missed)
+  {
+    missed->count = count;
+    return;
+  }
+
+  missed = _missed_find(counters, 0);
+
+  if (!missed)
+  {
+    int i;
+
+    missed = &counters->file->missed[0];
+
+    for (i = 1; i < NUI_COUNTERS_MISSED_MAX; i++)
+    {
+      /* wraps around, the distance to the newest tells the age */
+      if (counters->file->missed_serial - counters->file->missed[i].serial >
+          counters->file->missed_serial - missed->serial)
+      {
+        missed = &counters->file->missed[i];
+      }
+    }
+  }
+
+  missed->id = id;
+  missed->count = count;
+  missed->serial = ++counters->file->missed_serial;
+}
+
+guint
+nui_counters_get_missed(NuiCounters *counters, guint32 id)
+{
+  NuiCountersMissed *missed;
+
+  if (!id)
+    return 0;
+
+  missed = _missed_find(counters, id);
+
+  return missed ? missed->count : 0;
+}
+
+guint
+nui_counters_get_missed_total(NuiCounters *counters)
+{
+  guint total = 0;
+  int i;
+
+  for (i = 0; i < NUI_COUNTERS_MISSED_MAX; i++)
+    total += counters->file->missed[i].count;
+
+  return total;
+}
+
+gboolean
+nui_counters_set_missed_owner(NuiCounters *counters, const gchar *owner)
+{
+  NuiCountersFile *file = counters->file;
+
+  if (!owner)
+    owner = "";
+
+  if (strlen(owner) >= sizeof(file->missed_owner))
+  {
+    g_warning("Notification daemon name %s too long", owner);
+    owner = "";
+  }
+
+  if (!strcmp(file->missed_owner, owner))
+    return FALSE;
+
+  /* the notifications went with the daemon */
+  memset(file->missed, 0, sizeof(file->missed));
+  g_strlcpy(file->missed_owner, owner, sizeof(file->missed_owner));
+
+  return TRUE;
+}
@@ -0,0 +1,67 @@
+/*
+ * nui-counters.h
+ *
+ * Copyright (C) 2024 Ivaylo Dimitrov <ivo.g.dimitrov.75@gmail.com>
+ *
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __NUI_COUNTERS_H__
+#define __NUI_COUNTERS_H__
+
+G_BEGIN_DECLS
+
+typedef enum
+{
+  NUI_COUNTER_UNREAD_MESSAGES,
+  NUI_COUNTER_MISSED_CALLS,
+  NUI_COUNTER_LAST
+} NuiCounter;
+
+typedef struct _NuiCounters NuiCounters;
+
+/* counters are kept in a memory-mapped file under the user cache dir, so
+ * they are available right after a restart. falls back to in-memory
+ * counters if the file cannot be mapped.
+ */
+NuiCounters *nui_counters_open(void);
+void nui_counters_close(NuiCounters *counters);
+
+guint nui_counters_get(NuiCounters *counters, NuiCounter counter);
+void nui_counters_add(NuiCounters *counters, NuiCounter counter, gint delta);
+void nui_counters_set(NuiCounters *counters, NuiCounter counter, guint value);
+
+/* TRUE if the stored values could not be trusted and were reset, there is
+ * nothing to serve until they are rebuilt
+ */
+gboolean nui_counters_is_fresh(NuiCounters *counters);
+
+/* missed-call notification id shows count calls, 0 once it is closed. kept
+ * in the file, so closing it after a restart still counts.
+ */
+void nui_counters_set_missed(NuiCounters *counters, guint32 id, guint count);
+guint nui_counters_get_missed(NuiCounters *counters, guint32 id);
+
+/* calls shown by all the open missed-call notifications */
+guint nui_counters_get_missed_total(NuiCounters *counters);
+
+/* unique name of the notification daemon, NULL if there is none. the
+ * missed-call ids of another daemon are dropped, TRUE if that happened
+ */
+gboolean nui_counters_set_missed_owner(NuiCounters *counters,
+                                       const gchar *owner);
+
+G_END_DECLS
+
+#endif /* __NUI_COUNTERS_H__ */
@@ -0,0 +1,208 @@
+/*
+ * nui-icon-cache.c
+ *
+ * Copyright (C) 2024 Ivaylo Dimitrov <ivo.g.dimitrov.75@gmail.com>
+ *
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "config.h"
+
+#include <gtk/gtk.h>
+
+#include "nui-icon-cache.h"
+
+/* overlays composited over the base icon, a missing one leaves it as is */
+static const gchar *variant_overlays[NUI_ICON_VARIANT_LAST] =
+{
+  NULL,
+  "call_status_held",
+  "call_status_incoming",
+  "call_status_multiparty"
+};
+
+#define SIM_BADGE_FORMAT "call_status_sim%u"
+/* numberless badge for the SIMs above NUI_ICON_CACHE_SIMS */
+#define SIM_BADGE_GENERIC "call_status_sim"
+
+/* slot of the generic badge, after the numbered ones */
+#define SIM_GENERIC (NUI_ICON_CACHE_SIMS + 1)
+
+typedef struct
+{
+  GdkPixbuf *icons[NUI_ICON_VARIANT_LAST][SIM_GENERIC + 1];
+} NuiIconCacheEntry;
+
+/* "name:size" to NuiIconCacheEntry, for the default icon theme only, so
+ * dropping everything on theme change is what keys it by theme
+ */
+static GHashTable *cache = NULL;
+
+/* "name:size" of the icons the theme does not have, so they are not looked
+ * up and warned about on every update, the theme may provide them once it
+ * changes
+ */
+static GHashTable *misses = NULL;
+
+static void
+_entry_free(gpointer data)
+{
+  NuiIconCacheEntry *entry = data;
+  int i;
+  int j;
+
+  for (i = 0; i < NUI_ICON_VARIANT_LAST; i++)
+  {
+    for (j = 0; j <= SIM_GENERIC; j++)
+    {
+      if (entry->icons[i][j])
+        g_object_unref(entry->icons[i][j]);
+    }
+  }
+
+  g_slice_free(NuiIconCacheEntry, entry);
+}
+
+static void
+_icon_theme_changed_cb(GtkIconTheme *theme, gpointer user_data)
+{
+  g_debug("Icon theme changed, dropping cached icons");
+
+  g_hash_table_remove_all(cache);
+  g_hash_table_remove_all(misses);
+}
+
+static GdkPixbuf *
+_icon_load(const gchar *icon_name, gint size)
+{
+  return gtk_icon_theme_load_icon(gtk_icon_theme_get_default(), icon_name,
+                                  size, 0, NULL);
+}
+
+static GdkPixbuf *
+_icon_composite(GdkPixbuf *base, const gchar *overlay_name, gint size)
+{
+  GdkPixbuf *overlay;
+  GdkPixbuf *icon;
+  gint width;
+  gint height;
+
+  if (!base || !overlay_name)
+    return base ? g_object_ref(base) : NULL;
+
+  overlay = _icon_load(overlay_name, size);
+
+  if (!overlay)
+    return g_object_ref(base);
+
+  width = gdk_pixbuf_get_width(base);
+  height = gdk_pixbuf_get_height(base);
+  icon = gdk_pixbuf_copy(base);
+
+  gdk_pixbuf_composite(overlay, icon, 0, 0, width, height, 0, 0,
+                       (double)width / gdk_pixbuf_get_width(overlay),
+                       (double)height / gdk_pixbuf_get_height(overlay),
+                       GDK_INTERP_BILINEAR, 255);
+  g_object_unref(overlay);
+
+  return icon;
+}
+
+static NuiIconCacheEntry *
+_entry_new(const gchar *icon_name, gint size)
+{
+  NuiIconCacheEntry *entry;
+  GdkPixbuf *base = _icon_load(icon_name, size);
+  guint sim;
+  int i;
+
+  if (!base)
+    return NULL;
+
+  entry = g_slice_new0(NuiIconCacheEntry);
+
+  for (i = 0; i < NUI_ICON_VARIANT_LAST; i++)
+  {
+    GdkPixbuf *icon = _icon_composite(base, variant_overlays[i], size);
+
+    entry->icons[i][0] = icon;
+
+    for (sim = 1; sim <= NUI_ICON_CACHE_SIMS; sim++)
+    {
+      gchar *badge = g_strdup_printf(SIM_BADGE_FORMAT, sim);
+
+      entry->icons[i][sim] = _icon_composite(icon, badge, size);
+      g_free(badge);
+    }
+
+    entry->icons[i][SIM_GENERIC] = _icon_composite(icon, SIM_BADGE_GENERIC,
+                                                   size);
+  }
+
+  g_object_unref(base);
+
+  return entry;
+}
+
+GdkPixbuf *
+nui_icon_cache_get(const gchar *icon_name, gint size, NuiIconVariant variant,
+                   guint sim)
+{
+  NuiIconCacheEntry *entry;
+  gchar *key;
+
+  g_return_val_if_fail(icon_name != NULL, NULL);
+  g_return_val_if_fail(variant < NUI_ICON_VARIANT_LAST, NULL);
+
+  if (!cache)
+  {
+    cache = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                  _entry_free);
+    misses = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    g_signal_connect(gtk_icon_theme_get_default(), "changed",
+                     G_CALLBACK(_icon_theme_changed_cb), NULL);
+  }
+
+  if (sim > NUI_ICON_CACHE_SIMS)
+    sim = SIM_GENERIC;
+
+  key = g_strdup_printf("%s:%d", icon_name, size);
+  entry = g_hash_table_lookup(cache, key);
+
+  if (!entry)
+  {
+    if (g_hash_table_contains(misses, key))
+    {
+      g_free(key);
+      return NULL;
+    }
+
+    /* all the variants at once, switching between them is a lookup */
+    entry = _entry_new(icon_name, size);
+
+    if (!entry)
+    {
+      g_warning("Unable to load icon %s", icon_name);
+      g_hash_table_add(misses, key);
+
+      return NULL;
+    }
+
+    g_hash_table_insert(cache, key, entry);
+  }
+  else
+    g_free(key);
+
+  return entry->icons[variant][sim];
+}
@@ -0,0 +1,47 @@
+/*
+ * nui-icon-cache.h
+ *
+ * Copyright (C) 2024 Ivaylo Dimitrov <ivo.g.dimitrov.75@gmail.com>
+ *
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __NUI_ICON_CACHE_H__
+#define __NUI_ICON_CACHE_H__
+
+G_BEGIN_DECLS
+
+/* highest SIM number a badge is pre-rendered for */
+#define NUI_ICON_CACHE_SIMS 2
+
+typedef enum
+{
+  NUI_ICON_VARIANT_ACTIVE,
+  NUI_ICON_VARIANT_HELD,
+  NUI_ICON_VARIANT_INCOMING,
+  NUI_ICON_VARIANT_MULTIPARTY,
+  NUI_ICON_VARIANT_LAST
+} NuiIconVariant;
+
+/* returned pixbuf is owned by the cache and stays valid until the icon
+ * theme changes, sim 0 means no SIM badge, SIMs above NUI_ICON_CACHE_SIMS
+ * get a badge without a number. NULL if the theme has no icon_name, it is
+ * looked up again once the theme changes.
+ */
+GdkPixbuf *nui_icon_cache_get(const gchar *icon_name, gint size,
+                              NuiIconVariant variant, guint sim);
+
+G_END_DECLS
+
+#endif /* __NUI_ICON_CACHE_H__ */
@@ -0,0 +1,203 @@
+/*
+ * nui-ofono.c
+ *
+ * Copyright (C) 2024 Ivaylo Dimitrov <ivo.g.dimitrov.75@gmail.com>
+ *
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "config.h"
+
+#include <gio/gio.h>
+
+#include "nui-ofono.h"
+
+typedef struct
+{
+  GCallback func;
+  gpointer user_data;
+} NuiOfonoClosure;
+
+static gpointer
+_closure_new(GCallback func, gpointer user_data)
+{
+  NuiOfonoClosure *closure = g_slice_new(NuiOfonoClosure);
+
+  closure->func = func;
+  closure->user_data = user_data;
+
+  return closure;
+}
+
+static void
+_closure_free(gpointer data)
+{
+  g_slice_free(NuiOfonoClosure, data);
+}
+
+static void
+_object_added_cb(GDBusConnection *connection, const gchar *sender,
+                 const gchar *path, const gchar *interface,
+                 const gchar *signal, GVariant *parameters,
+                 gpointer user_data)
+{
+  NuiOfonoClosure *closure = user_data;
+  const gchar *object_path;
+  GVariant *properties;
+
+  if (!g_variant_is_of_type(parameters, G_VARIANT_TYPE("(oa{sv})")))
+    return;
+
+  g_variant_get(parameters, "(&o@a{sv})", &object_path, &properties);
+  ((NuiOfonoObjectAddedFunc)closure->func)(object_path, properties,
+                                           closure->user_data);
+  g_variant_unref(properties);
+}
+
+static void
+_object_removed_cb(GDBusConnection *connection, const gchar *sender,
+                   const gchar *path, const gchar *interface,
+                   const gchar *signal, GVariant *parameters,
+                   gpointer user_data)
+{
+  NuiOfonoClosure *closure = user_data;
+  const gchar *object_path;
+
+  if (!g_variant_is_of_type(parameters, G_VARIANT_TYPE("(o)")))
+    return;
+
+  g_variant_get(parameters, "(&o)", &object_path);
+  ((NuiOfonoObjectRemovedFunc)closure->func)(object_path, closure->user_data);
+}
+
+static void
+_property_changed_cb(GDBusConnection *connection, const gchar *sender,
+                     const gchar *path, const gchar *interface,
+                     const gchar *signal, GVariant *parameters,
+                     gpointer user_data)
+{
+  NuiOfonoClosure *closure = user_data;
+  const gchar *name;
+  GVariant *value;
+
+  if (!g_variant_is_of_type(parameters, G_VARIANT_TYPE("(sv)")))
+    return;
+
+  g_variant_get(parameters, "(&sv)", &name, &value);
+  ((NuiOfonoPropertyChangedFunc)closure->func)(path, name, value,
+                                               closure->user_data);
+  g_variant_unref(value);
+}
+
+static void
+_message_cb(GDBusConnection *connection, const gchar *sender,
+            const gchar *path, const gchar *interface,
+            const gchar *signal, GVariant *parameters, gpointer user_data)
+{
+  NuiOfonoClosure *closure = user_data;
+  const gchar *message;
+  GVariant *info;
+
+  if (!g_variant_is_of_type(parameters, G_VARIANT_TYPE("(sa{sv})")))
+    return;
+
+  g_variant_get(parameters, "(&s@a{sv})", &message, &info);
+  ((NuiOfonoMessageFunc)closure->func)(path, message, info,
+                                       closure->user_data);
+  g_variant_unref(info);
+}
+
+guint
+nui_ofono_subscribe_object_added(GDBusConnection *connection,
+                                 const gchar *path,
+                                 const gchar *interface_name,
+                                 const gchar *signal_name,
+                                 NuiOfonoObjectAddedFunc func,
+                                 gpointer user_data)
+{
+  return g_dbus_connection_signal_subscribe(
+        connection, NUI_OFONO_SERVICE, interface_name, signal_name, path,
+        NULL, G_DBUS_SIGNAL_FLAGS_NONE, _object_added_cb,
+        _closure_new(G_CALLBACK(func), user_data), _closure_free);
+}
+
+guint
+nui_ofono_subscribe_object_removed(GDBusConnection *connection,
+                                   const gchar *path,
+                                   const gchar *interface_name,
+                                   const gchar *signal_name,
+                                   NuiOfonoObjectRemovedFunc func,
+                                   gpointer user_data)
+{
+  return g_dbus_connection_signal_subscribe(
+        connection, NUI_OFONO_SERVICE, interface_name, signal_name, path,
+        NULL, G_DBUS_SIGNAL_FLAGS_NONE, _object_removed_cb,
+        _closure_new(G_CALLBACK(func), user_data), _closure_free);
+}
+
+guint
+nui_ofono_subscribe_property_changed(GDBusConnection *connection,
+                                     const gchar *path,
+                                     const gchar *interface_name,
+                                     const gchar *name,
+                                     NuiOfonoPropertyChangedFunc func,
+                                     gpointer user_data)
+{
+  return g_dbus_connection_signal_subscribe(
+        connection, NUI_OFONO_SERVICE, interface_name, "PropertyChanged",
+        path, name, G_DBUS_SIGNAL_FLAGS_NONE, _property_changed_cb,
+        _closure_new(G_CALLBACK(func), user_data), _closure_free);
+}
+
+guint
+nui_ofono_subscribe_message(GDBusConnection *connection, const gchar *path,
+                            const gchar *interface_name,
+                            const gchar *signal_name,
+                            NuiOfonoMessageFunc func, gpointer user_data)
+{
+  return g_dbus_connection_signal_subscribe(
+        connection, NUI_OFONO_SERVICE, interface_name, signal_name, path,
+        NULL, G_DBUS_SIGNAL_FLAGS_NONE, _message_cb,
+        _closure_new(G_CALLBACK(func), user_data), _closure_free);
+}
+
+void
+nui_ofono_get_objects(GDBusConnection *connection, const gchar *path,
+                      const gchar *interface_name, const gchar *method_name,
+                      GCancellable *cancellable, GAsyncReadyCallback callback,
+                      gpointer user_data)
+{
+  g_dbus_connection_call(connection, NUI_OFONO_SERVICE, path, interface_name,
+                         method_name, NULL, G_VARIANT_TYPE("(a(oa{sv}))"),
+                         G_DBUS_CALL_FLAGS_NONE, -1, cancellable, callback,
+                         user_data);
+}
+
+GVariant *
+nui_ofono_get_objects_finish(GDBusConnection *connection, GAsyncResult *res,
+                             GError **error)
+{
+  GVariant *reply;
+  GVariant *objects;
+
+  reply = g_dbus_connection_call_finish(connection, res, error);
+
+  if (!reply)
+    return NULL;
+
+  objects = g_variant_get_child_value(reply, 0);
+  g_variant_unref(reply);
+
+  return objects;
+}
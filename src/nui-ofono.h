@@ -0,0 +1,106 @@
+/*
+ * nui-ofono.h
+ *
+ * Copyright (C) 2024 Ivaylo Dimitrov <ivo.g.dimitrov.75@gmail.com>
+ *
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __NUI_OFONO_H__
+#define __NUI_OFONO_H__
+
+G_BEGIN_DECLS
+
+#define NUI_OFONO_BUS_TYPE G_BUS_TYPE_SYSTEM
+#define NUI_OFONO_SERVICE "org.ofono"
+
+#define NUI_OFONO_(interface) NUI_OFONO_SERVICE "." interface
+#define NUI_OFONO_MANAGER_INTERFACE_NAME NUI_OFONO_("Manager")
+#define NUI_OFONO_MODEM_INTERFACE_NAME NUI_OFONO_("Modem")
+#define NUI_OFONO_VOICECALL_MANAGER_INTERFACE_NAME \
+    NUI_OFONO_("VoiceCallManager")
+#define NUI_OFONO_VOICECALL_INTERFACE_NAME NUI_OFONO_("VoiceCall")
+#define NUI_OFONO_MESSAGE_MANAGER_INTERFACE_NAME NUI_OFONO_("MessageManager")
+
+/* bare bindings for the few oFono calls and signals the plugin uses, no
+ * proxies and no GTypes, signals are delivered in the thread-default main
+ * context of the caller of the subscribe function.
+ */
+
+/* (oa{sv}) signals, like ModemAdded or CallAdded */
+typedef void (*NuiOfonoObjectAddedFunc)(const gchar *path,
+                                        GVariant *properties,
+                                        gpointer user_data);
+
+/* (o) signals, like ModemRemoved or CallRemoved */
+typedef void (*NuiOfonoObjectRemovedFunc)(const gchar *path,
+                                          gpointer user_data);
+
+/* PropertyChanged, value is unboxed, path is the emitting object */
+typedef void (*NuiOfonoPropertyChangedFunc)(const gchar *path,
+                                            const gchar *name,
+                                            GVariant *value,
+                                            gpointer user_data);
+
+/* (sa{sv}) signals, like IncomingMessage or ImmediateMessage, path is the
+ * emitting object
+ */
+typedef void (*NuiOfonoMessageFunc)(const gchar *path,
+                                    const gchar *message,
+                                    GVariant *info,
+                                    gpointer user_data);
+
+guint nui_ofono_subscribe_object_added(GDBusConnection *connection,
+                                       const gchar *path,
+                                       const gchar *interface_name,
+                                       const gchar *signal_name,
+                                       NuiOfonoObjectAddedFunc func,
+                                       gpointer user_data);
+
+guint nui_ofono_subscribe_object_removed(GDBusConnection *connection,
+                                         const gchar *path,
+                                         const gchar *interface_name,
+                                         const gchar *signal_name,
+                                         NuiOfonoObjectRemovedFunc func,
+                                         gpointer user_data);
+
+/* path NULL matches all objects, name NULL all properties */
+guint nui_ofono_subscribe_property_changed(GDBusConnection *connection,
+                                           const gchar *path,
+                                           const gchar *interface_name,
+                                           const gchar *name,
+                                           NuiOfonoPropertyChangedFunc func,
+                                           gpointer user_data);
+
+guint nui_ofono_subscribe_message(GDBusConnection *connection,
+                                  const gchar *path,
+                                  const gchar *interface_name,
+                                  const gchar *signal_name,
+                                  NuiOfonoMessageFunc func,
+                                  gpointer user_data);
+
+/* a(oa{sv}) methods, like GetModems or GetCalls */
+void nui_ofono_get_objects(GDBusConnection *connection, const gchar *path,
+                           const gchar *interface_name,
+                           const gchar *method_name,
+                           GCancellable *cancellable,
+                           GAsyncReadyCallback callback, gpointer user_data);
+
+/* returns a(oa{sv}) */
+GVariant *nui_ofono_get_objects_finish(GDBusConnection *connection,
+                                       GAsyncResult *res, GError **error);
+
+G_END_DECLS
+
+#endif /* __NUI_OFONO_H__ */
@@ -0,0 +1,240 @@
+/*
+ * nui-sms-filter.c
+ *
+ * Copyright (C) 2024 Ivaylo Dimitrov <ivo.g.dimitrov.75@gmail.com>
+ *
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "config.h"
+
+#include <telepathy-glib/telepathy-glib.h>
+
+#include "nui-contact-cache.h"
+#include "nui-sms-filter.h"
+
+typedef struct
+{
+  gchar *sender;
+  /* NULL for the ones seen through Telepathy */
+  gpointer message;
+  gint64 time;
+} NuiSmsFilterEntry;
+
+struct _NuiSmsFilter
+{
+  guint hold;
+  NuiSmsFilterReleaseFunc release;
+  GDestroyNotify destroy;
+  gpointer user_data;
+  GMainContext *context;
+  GSource *source;
+  /* NuiSmsFilterEntry, oldest first */
+  GQueue held;
+  GQueue seen;
+  guint released;
+  guint dropped;
+};
+
+static void
+_entry_free(NuiSmsFilter *filter, NuiSmsFilterEntry *entry)
+{
+  if (entry->message && filter->destroy)
+    filter->destroy(entry->message);
+
+  g_free(entry->sender);
+  g_slice_free(NuiSmsFilterEntry, entry);
+}
+
+static NuiSmsFilterEntry *
+_entry_new(const gchar *sender, gpointer message)
+{
+  NuiSmsFilterEntry *entry = g_slice_new(NuiSmsFilterEntry);
+
+  entry->sender = nui_contact_cache_normalize(sender);
+  entry->message = message;
+  entry->time = g_get_monotonic_time();
+
+  return entry;
+}
+
+/* removes and returns the oldest entry from sender */
+static NuiSmsFilterEntry *
+_entry_take(GQueue *queue, const gchar *sender)
+{
+  GList *l;
+
+  for (l = queue->head; l; l = l->next)
+  {
+    NuiSmsFilterEntry *entry = l->data;
+
+    if (!g_strcmp0(entry->sender, sender))
+    {
+      g_queue_delete_link(queue, l);
+      return entry;
+    }
+  }
+
+  return NULL;
+}
+
+static void _expire_schedule(NuiSmsFilter *filter);
+
+static gboolean
+_expire_cb(gpointer user_data)
+{
+  NuiSmsFilter *filter = user_data;
+  gint64 limit = g_get_monotonic_time() - filter->hold * 1000;
+  NuiSmsFilterEntry *entry;
+
+  g_source_unref(filter->source);
+  filter->source = NULL;
+
+  while ((entry = g_queue_peek_head(&filter->seen)) && entry->time <= limit)
+    _entry_free(filter, g_queue_pop_head(&filter->seen));
+
+  while ((entry = g_queue_peek_head(&filter->held)) && entry->time <= limit)
+  {
+    gpointer message = entry->message;
+
+    g_queue_pop_head(&filter->held);
+    entry->message = NULL;
+    _entry_free(filter, entry);
+    filter->released++;
+    filter->release(message, filter->user_data);
+  }
+
+  _expire_schedule(filter);
+
+  return G_SOURCE_REMOVE;
+}
+
+/* one timer for the oldest entry of both queues */
+static void
+_expire_schedule(NuiSmsFilter *filter)
+{
+  NuiSmsFilterEntry *held = g_queue_peek_head(&filter->held);
+  NuiSmsFilterEntry *seen = g_queue_peek_head(&filter->seen);
+  gint64 due;
+  gint64 now;
+
+  if (filter->source || (!held && !seen))
+    return;
+
+  if (held && seen)
+    due = MIN(held->time, seen->time);
+  else
+    due = held ? held->time : seen->time;
+
+  due += filter->hold * 1000;
+  now = g_get_monotonic_time();
+
+  filter->source = g_timeout_source_new(due > now ? (due - now) / 1000 + 1 :
+                                        0);
+  g_source_set_callback(filter->source, _expire_cb, filter, NULL);
+  g_source_attach(filter->source, filter->context);
+}
+
+NuiSmsFilter *
+nui_sms_filter_new(guint hold, NuiSmsFilterReleaseFunc release,
+                   GDestroyNotify destroy, gpointer user_data)
+{
+  NuiSmsFilter *filter;
+
+  g_return_val_if_fail(release != NULL, NULL);
+
+  filter = g_slice_new0(NuiSmsFilter);
+  filter->hold = hold;
+  filter->release = release;
+  filter->destroy = destroy;
+  filter->user_data = user_data;
+  filter->context = g_main_context_ref_thread_default();
+  g_queue_init(&filter->held);
+  g_queue_init(&filter->seen);
+
+  return filter;
+}
+
+void
+nui_sms_filter_free(NuiSmsFilter *filter)
+{
+  NuiSmsFilterEntry *entry;
+
+  if (filter->source)
+  {
+    g_source_destroy(filter->source);
+    g_source_unref(filter->source);
+  }
+
+  while ((entry = g_queue_pop_head(&filter->held)))
+    _entry_free(filter, entry);
+
+  while ((entry = g_queue_pop_head(&filter->seen)))
+    _entry_free(filter, entry);
+
+  g_main_context_unref(filter->context);
+  g_slice_free(NuiSmsFilter, filter);
+}
+
+void
+nui_sms_filter_hold(NuiSmsFilter *filter, const gchar *sender,
+                    gpointer message)
+{
+  NuiSmsFilterEntry *entry = _entry_new(sender, message);
+  NuiSmsFilterEntry *seen = _entry_take(&filter->seen, entry->sender);
+
+  /* Telepathy was first */
+  if (seen)
+  {
+    _entry_free(filter, seen);
+    _entry_free(filter, entry);
+    filter->dropped++;
+
+    return;
+  }
+
+  g_queue_push_tail(&filter->held, entry);
+  _expire_schedule(filter);
+}
+
+void
+nui_sms_filter_seen(NuiSmsFilter *filter, const gchar *sender)
+{
+  NuiSmsFilterEntry *entry = _entry_new(sender, NULL);
+  NuiSmsFilterEntry *held = _entry_take(&filter->held, entry->sender);
+
+  if (held)
+  {
+    _entry_free(filter, held);
+    _entry_free(filter, entry);
+    filter->dropped++;
+
+    return;
+  }
+
+  /* oFono may still be on its way */
+  g_queue_push_tail(&filter->seen, entry);
+  _expire_schedule(filter);
+}
+
+void
+nui_sms_filter_get_stats(NuiSmsFilter *filter, guint *released,
+                         guint *dropped)
+{
+  if (released)
+    *released = filter->released;
+
+  if (dropped)
+    *dropped = filter->dropped;
+}
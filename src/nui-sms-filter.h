@@ -0,0 +1,51 @@
+/*
+ * nui-sms-filter.h
+ *
+ * Copyright (C) 2024 Ivaylo Dimitrov <ivo.g.dimitrov.75@gmail.com>
+ *
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __NUI_SMS_FILTER_H__
+#define __NUI_SMS_FILTER_H__
+
+G_BEGIN_DECLS
+
+typedef struct _NuiSmsFilter NuiSmsFilter;
+
+/* message was not seen through Telepathy, the callee owns it */
+typedef void (*NuiSmsFilterReleaseFunc)(gpointer message, gpointer user_data);
+
+/* SMS straight from oFono are held for hold ms and dropped if the same one
+ * came through a Telepathy channel meanwhile, or shortly before. messages
+ * are matched one for one by normalized sender. release and the timer run
+ * in the thread-default main context of the caller of nui_sms_filter_new().
+ */
+NuiSmsFilter *nui_sms_filter_new(guint hold, NuiSmsFilterReleaseFunc release,
+                                 GDestroyNotify destroy, gpointer user_data);
+void nui_sms_filter_free(NuiSmsFilter *filter);
+
+/* an SMS from sender came from oFono, message is released or destroyed */
+void nui_sms_filter_hold(NuiSmsFilter *filter, const gchar *sender,
+                         gpointer message);
+
+/* an SMS from sender came through Telepathy */
+void nui_sms_filter_seen(NuiSmsFilter *filter, const gchar *sender);
+
+void nui_sms_filter_get_stats(NuiSmsFilter *filter, guint *released,
+                              guint *dropped);
+
+G_END_DECLS
+
+#endif /* __NUI_SMS_FILTER_H__ */
@@ -25,6 +25,11 @@
 
 #include "nui-core.h"
 #include "nui-call-monitor.h"
+#include "nui-call-timer.h"
+#include "nui-icon-cache.h"
+#include "nui-status-updater.h"
+
+#define CALL_ICON_NAME "general_call_status"
 
 typedef struct _NuiStatusPlugin NuiStatusPlugin;
 typedef struct _NuiStatusPluginClass NuiStatusPluginClass;
@@ -44,7 +49,20 @@ struct _NuiStatusPluginPrivate
 {
   NuiCore *core;
   NuiCallMonitor *call_monitor;
-  GdkPixbuf *call_icon;
+  /* what the status area icon should be and what it currently is */
+  gboolean in_call;
+  NuiIconVariant icon_variant;
+  guint icon_sim;
+  GdkPixbuf *status_area_icon;
+  NuiStatusUpdater *updater;
+  /* status menu items, the plugin is shown while any of them is */
+  GtkWidget *box;
+  /* missed calls and unread messages */
+  GtkWidget *counters_button;
+  /* duration of the ongoing call */
+  GtkWidget *duration_button;
+  NuiCallTimer *call_timer;
+  guint start_id;
   gboolean disposed;
 };
 
@@ -65,33 +83,239 @@ HD_DEFINE_PLUGIN_MODULE_EXTENDED(
     G_ADD_PRIVATE_DYNAMIC(NuiStatusPlugin), , );
 
 
+static gboolean
+apply_call_indicator(gpointer user_data)
+{
+  NuiStatusPlugin *plugin = user_data;
+  NuiStatusPluginPrivate *priv = PRIVATE(plugin);
+  GdkPixbuf *icon = NULL;
+
+  /* icons are decoded the first time they are actually shown */
+  if (priv->in_call)
+  {
+    icon = nui_icon_cache_get(CALL_ICON_NAME, HILDON_ICON_PIXEL_SIZE_XSMALL,
+                              priv->icon_variant, priv->icon_sim);
+  }
+
+  if (icon == priv->status_area_icon)
+    return FALSE;
+
+  hd_status_plugin_item_set_status_area_icon(HD_STATUS_PLUGIN_ITEM(plugin),
+                                             icon);
+
+  if (priv->status_area_icon)
+    g_object_unref(priv->status_area_icon);
+
+  priv->status_area_icon = icon ? g_object_ref(icon) : NULL;
+
+  return TRUE;
+}
+
 static void
-set_call_indicator(NuiStatusPlugin *plugin, gboolean set)
+set_call_indicator(NuiStatusPlugin *plugin, gboolean set,
+                   NuiIconVariant variant, guint sim)
 {
+  NuiStatusPluginPrivate *priv;
+
   g_return_if_fail(plugin != NULL);
 
-  if (set)
+  priv = PRIVATE(plugin);
+  priv->in_call = set;
+  priv->icon_variant = variant;
+  priv->icon_sim = sim;
+
+  nui_status_updater_request(priv->updater);
+}
+
+static gint
+compare_modem_path(gconstpointer a, gconstpointer b)
+{
+  return g_strcmp0(*(const gchar **)a, *(const gchar **)b);
+}
+
+static void
+update_call_indicator(NuiStatusPlugin *plugin, GVariant *calls)
+{
+  guint counts[NUI_CALL_STATE_LAST] = { 0 };
+  const gchar *call_modem = NULL;
+  GPtrArray *modems = g_ptr_array_new();
+  NuiIconVariant variant;
+  GVariantIter i;
+  const gchar *path;
+  GVariant *v;
+  guint active;
+  guint incoming;
+  guint sim = 0;
+
+  g_variant_iter_init(&i, calls);
+
+  while (g_variant_iter_next(&i, "{&s@au}", &path, &v))
+  {
+    const guint32 *c;
+    gsize n;
+    gsize j;
+
+    c = g_variant_get_fixed_array(v, &n, sizeof(guint32));
+
+    for (j = 0; j < n && j < NUI_CALL_STATE_LAST; j++)
+      counts[j] += c[j];
+
+    if (n == NUI_CALL_STATE_LAST &&
+        (c[NUI_CALL_STATE_ACTIVE] || c[NUI_CALL_STATE_HELD] ||
+         c[NUI_CALL_STATE_INCOMING] || c[NUI_CALL_STATE_WAITING]))
+    {
+      call_modem = path;
+    }
+
+    g_ptr_array_add(modems, (gpointer)path);
+    g_variant_unref(v);
+  }
+
+  active = counts[NUI_CALL_STATE_ACTIVE] + counts[NUI_CALL_STATE_HELD];
+  incoming = counts[NUI_CALL_STATE_INCOMING] + counts[NUI_CALL_STATE_WAITING];
+
+  if (incoming)
+    variant = NUI_ICON_VARIANT_INCOMING;
+  else if (active > 1)
+    variant = NUI_ICON_VARIANT_MULTIPARTY;
+  else if (counts[NUI_CALL_STATE_HELD])
+    variant = NUI_ICON_VARIANT_HELD;
+  else
+    variant = NUI_ICON_VARIANT_ACTIVE;
+
+  /* badge with the SIM number only if there is more than one */
+  if (call_modem && modems->len > 1)
   {
-    NuiStatusPluginPrivate *priv = PRIVATE(plugin);
+    g_ptr_array_sort(modems, compare_modem_path);
 
-    g_return_if_fail(priv->call_icon != NULL);
+    for (sim = 0; sim < modems->len; sim++)
+    {
+      if (g_ptr_array_index(modems, sim) == call_modem)
+        break;
+    }
+
+    sim++;
+  }
 
-    hd_status_plugin_item_set_status_area_icon(
-          HD_STATUS_PLUGIN_ITEM(plugin), priv->call_icon);
+  g_ptr_array_free(modems, TRUE);
+
+  set_call_indicator(plugin, active || incoming, variant, sim);
+}
+
+static void
+show_call_duration(gint64 duration, gpointer user_data)
+{
+  NuiStatusPluginPrivate *priv = PRIVATE(user_data);
+  gchar *value;
+
+  if (duration >= 3600)
+  {
+    value = g_strdup_printf("%d:%02d:%02d", (gint)(duration / 3600),
+                            (gint)(duration / 60 % 60), (gint)(duration % 60));
   }
   else
   {
-    hd_status_plugin_item_set_status_area_icon(
-          HD_STATUS_PLUGIN_ITEM(plugin), NULL);
+    value = g_strdup_printf("%02d:%02d", (gint)(duration / 60),
+                            (gint)(duration % 60));
   }
+
+  hildon_button_set_value(HILDON_BUTTON(priv->duration_button), value);
+  g_free(value);
+}
+
+static void
+duration_button_mapped_cb(GtkWidget *widget, gpointer user_data)
+{
+  NuiStatusPluginPrivate *priv = PRIVATE(user_data);
+
+  /* wake up once a second only while somebody can see the duration */
+  nui_call_timer_set_visible(priv->call_timer, gtk_widget_get_mapped(widget));
 }
 
 static void
-call_status_changed_cb(int a1, gboolean in_call, gpointer user_data)
+update_visibility(NuiStatusPlugin *plugin)
+{
+  NuiStatusPluginPrivate *priv = PRIVATE(plugin);
+  GList *children = gtk_container_get_children(GTK_CONTAINER(priv->box));
+  gboolean visible = FALSE;
+  GList *l;
+
+  for (l = children; l && !visible; l = l->next)
+    visible = gtk_widget_get_visible(l->data);
+
+  g_list_free(children);
+  gtk_widget_set_visible(GTK_WIDGET(plugin), visible);
+}
+
+static void
+set_call_duration(NuiStatusPlugin *plugin, gint64 active_since)
+{
+  NuiStatusPluginPrivate *priv = PRIVATE(plugin);
+
+  gtk_widget_set_visible(priv->duration_button, active_since != 0);
+  nui_call_timer_set_active_since(priv->call_timer, active_since);
+  update_visibility(plugin);
+}
+
+static void
+update_counters(NuiStatusPlugin *plugin)
+{
+  NuiStatusPluginPrivate *priv = PRIVATE(plugin);
+  guint missed = nui_core_get_missed_calls(priv->core);
+  guint unread = nui_core_get_unread_messages(priv->core);
+  gchar *calls = NULL;
+  gchar *messages = NULL;
+
+  if (missed)
+  {
+    calls = g_strdup_printf(
+          g_dngettext(GETTEXT_PACKAGE, "nui_fi_missed_calls",
+                      "nui_fi_missed_calls", missed), missed);
+  }
+
+  if (unread)
+  {
+    messages = g_strdup_printf(
+          g_dngettext(GETTEXT_PACKAGE, "nui_fi_new_messages",
+                      "nui_fi_new_messages", unread), unread);
+  }
+
+  /* whichever there is goes first */
+  hildon_button_set_title(HILDON_BUTTON(priv->counters_button),
+                          calls ? calls : messages);
+  hildon_button_set_value(HILDON_BUTTON(priv->counters_button),
+                          calls ? messages : NULL);
+  g_free(calls);
+  g_free(messages);
+
+  gtk_widget_set_visible(priv->counters_button, missed || unread);
+  update_visibility(plugin);
+}
+
+static void
+counters_changed_cb(NuiCore *core, gpointer user_data)
+{
+  update_counters(user_data);
+}
+
+static void
+calls_changed_cb(NuiCallMonitor *monitor, GVariant *calls, gpointer user_data)
 {
   g_return_if_fail(NUI_STATUS_IS_PLUGIN(user_data));
 
-  set_call_indicator(NUI_STATUS_PLUGIN(user_data), in_call);
+  update_call_indicator(NUI_STATUS_PLUGIN(user_data), calls);
+  set_call_duration(NUI_STATUS_PLUGIN(user_data),
+                    nui_call_monitor_get_active_since(monitor));
+}
+
+static void
+icon_theme_changed_cb(GtkIconTheme *theme, gpointer user_data)
+{
+  NuiStatusPlugin *plugin = user_data;
+  NuiStatusPluginPrivate *priv = PRIVATE(plugin);
+
+  set_call_indicator(plugin, priv->in_call, priv->icon_variant,
+                     priv->icon_sim);
 }
 
 static void
@@ -107,8 +331,35 @@ nui_status_plugin_dispose(GObject *object)
   if (priv->disposed)
     return;
 
+  if (priv->start_id)
+  {
+    g_source_remove(priv->start_id);
+    priv->start_id = 0;
+  }
+
+  if (priv->updater)
+  {
+    nui_status_updater_free(priv->updater);
+    priv->updater = NULL;
+  }
+
+  if (priv->duration_button)
+  {
+    g_signal_handlers_disconnect_by_func(priv->duration_button,
+                                         duration_button_mapped_cb, object);
+    priv->duration_button = NULL;
+  }
+
+  if (priv->call_timer)
+  {
+    nui_call_timer_free(priv->call_timer);
+    priv->call_timer = NULL;
+  }
+
   if (priv->core)
   {
+    g_signal_handlers_disconnect_by_func(priv->core, counters_changed_cb,
+                                         object);
     g_object_unref(priv->core);
     priv->core = NULL;
   }
@@ -116,16 +367,19 @@ nui_status_plugin_dispose(GObject *object)
   if (priv->call_monitor)
   {
     g_signal_handlers_disconnect_by_func(priv->call_monitor,
-                                         call_status_changed_cb,
+                                         calls_changed_cb,
                                          object);
     g_object_unref(priv->call_monitor);
     priv->call_monitor = NULL;
   }
 
-  if (priv->call_icon)
+  g_signal_handlers_disconnect_by_func(gtk_icon_theme_get_default(),
+                                       icon_theme_changed_cb, object);
+
+  if (priv->status_area_icon)
   {
-    g_object_unref(priv->call_icon);
-    priv->call_icon = NULL;
+    g_object_unref(priv->status_area_icon);
+    priv->status_area_icon = NULL;
   }
 
   priv->disposed = TRUE;
@@ -139,43 +393,95 @@ nui_status_plugin_class_init(NuiStatusPluginClass *klass)
   G_OBJECT_CLASS(klass)->dispose = nui_status_plugin_dispose;
 }
 
-static void
-nui_status_plugin_init(NuiStatusPlugin *plugin)
+static gboolean
+nui_status_plugin_start_cb(gpointer user_data)
 {
+  NuiStatusPlugin *plugin = user_data;
   NuiStatusPluginPrivate *priv = PRIVATE(plugin);
-  GError *error = NULL;
-  GtkIconInfo *info;
+  gint64 start = g_get_monotonic_time();
+
+  priv->start_id = 0;
 
+  /* the default domain belongs to hildon-desktop, strings are looked up
+   * in ours explicitly
+   */
   bindtextdomain(GETTEXT_PACKAGE, LOCALEDIR);
   bind_textdomain_codeset(GETTEXT_PACKAGE, "UTF-8");
-  textdomain("rtcom-messaging-ui");
 
-  priv->disposed = FALSE;
-  //priv->core = NUI_CORE(nui_core_new());
-  priv->call_monitor = NUI_CALL_MONITOR(nui_call_monitor_new());
+  /* no point in updating the status area while the display is off */
+  priv->updater = nui_status_updater_new(NUI_STATUS_UPDATE_DELAY,
+                                         apply_call_indicator, plugin);
+
+  priv->box = gtk_vbox_new(FALSE, 0);
+  gtk_container_add(GTK_CONTAINER(plugin), priv->box);
+  gtk_widget_show(priv->box);
+
+  /* the stored counters are there right away, no need to wait for the
+   * event log
+   */
+  priv->core = NUI_CORE(nui_core_new());
+  priv->counters_button = hildon_button_new(
+        HILDON_SIZE_FINGER_HEIGHT | HILDON_SIZE_AUTO_WIDTH,
+        HILDON_BUTTON_ARRANGEMENT_VERTICAL);
+  hildon_button_set_style(HILDON_BUTTON(priv->counters_button),
+                          HILDON_BUTTON_STYLE_PICKER);
+  gtk_box_pack_start(GTK_BOX(priv->box), priv->counters_button, FALSE, FALSE,
+                     0);
+  g_signal_connect(priv->core, "counters-changed",
+                   G_CALLBACK(counters_changed_cb), plugin);
+  update_counters(plugin);
+
+  priv->call_timer = nui_call_timer_new(show_call_duration, plugin);
+  priv->duration_button = hildon_button_new_with_text(
+        HILDON_SIZE_FINGER_HEIGHT | HILDON_SIZE_AUTO_WIDTH,
+        HILDON_BUTTON_ARRANGEMENT_VERTICAL, g_dgettext(GETTEXT_PACKAGE, "nui_ti_call"), NULL);
+  hildon_button_set_style(HILDON_BUTTON(priv->duration_button),
+                          HILDON_BUTTON_STYLE_PICKER);
+  g_signal_connect(priv->duration_button, "map",
+                   G_CALLBACK(duration_button_mapped_cb), plugin);
+  g_signal_connect(priv->duration_button, "unmap",
+                   G_CALLBACK(duration_button_mapped_cb), plugin);
+  gtk_box_pack_start(GTK_BOX(priv->box), priv->duration_button, FALSE, FALSE,
+                     0);
+
+  priv->call_monitor = nui_call_monitor_dup_default();
 
   if (priv->call_monitor)
   {
-    g_signal_connect(priv->call_monitor, "status-changed",
-                     G_CALLBACK(call_status_changed_cb), plugin);
+    GVariant *calls;
+
+    g_signal_connect(priv->call_monitor, "calls-changed",
+                     G_CALLBACK(calls_changed_cb), plugin);
+
+    /* the monitor might have been around before us */
+    calls = nui_call_monitor_dup_calls(priv->call_monitor);
+    update_call_indicator(plugin, calls);
+    g_variant_unref(calls);
+    set_call_duration(
+          plugin, nui_call_monitor_get_active_since(priv->call_monitor));
   }
 
-  info = gtk_icon_theme_lookup_icon(gtk_icon_theme_get_default(),
-                                    "general_call_status",
-                                    HILDON_ICON_PIXEL_SIZE_XSMALL, 0);
+  g_signal_connect(gtk_icon_theme_get_default(), "changed",
+                   G_CALLBACK(icon_theme_changed_cb), plugin);
 
-  if (info)
-  {
-    const gchar *icon_file = gtk_icon_info_get_filename(info);
+  g_debug("Deferred start took %" G_GINT64_FORMAT " us",
+          g_get_monotonic_time() - start);
 
-    if (icon_file)
-    {
-      priv->call_icon = gdk_pixbuf_new_from_file(icon_file, &error);
+  return G_SOURCE_REMOVE;
+}
 
-      if (error)
-        g_error_free(error);
-    }
+static void
+nui_status_plugin_init(NuiStatusPlugin *plugin)
+{
+  NuiStatusPluginPrivate *priv = PRIVATE(plugin);
+  gint64 start = g_get_monotonic_time();
 
-    gtk_icon_info_free(info);
-  }
+  priv->disposed = FALSE;
+
+  /* do not hold hildon-desktop startup, oFono discovery can wait */
+  priv->start_id = g_idle_add_full(G_PRIORITY_LOW, nui_status_plugin_start_cb,
+                                   plugin, NULL);
+
+  g_debug("Plugin init took %" G_GINT64_FORMAT " us",
+          g_get_monotonic_time() - start);
 }
@@ -0,0 +1,265 @@
+/*
+ * nui-status-updater.c
+ *
+ * Copyright (C) 2024 Ivaylo Dimitrov <ivo.g.dimitrov.75@gmail.com>
+ *
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "config.h"
+
+#include <gio/gio.h>
+
+#include "nui-status-updater.h"
+
+#define MCE_SERVICE "com.nokia.mce"
+#define MCE_REQUEST_PATH "/com/nokia/mce/request"
+#define MCE_REQUEST_IF "com.nokia.mce.request"
+#define MCE_SIGNAL_PATH "/com/nokia/mce/signal"
+#define MCE_SIGNAL_IF "com.nokia.mce.signal"
+#define MCE_DISPLAY_STATUS_GET "get_display_status"
+#define MCE_DISPLAY_SIG "display_status_ind"
+#define MCE_DISPLAY_OFF_STRING "off"
+
+struct _NuiStatusUpdater
+{
+  guint delay;
+  NuiStatusUpdaterApplyFunc apply;
+  gpointer user_data;
+  GMainContext *context;
+  GSource *source;
+  /* the UI is not visible, updates are held back until it is */
+  gboolean display_off;
+  gboolean pending;
+  GDBusConnection *system_bus;
+  guint display_status_id;
+  GCancellable *cancellable;
+  guint requested;
+  guint applied;
+};
+
+static gboolean
+_update_cb(gpointer user_data)
+{
+  NuiStatusUpdater *updater = user_data;
+
+  g_source_unref(updater->source);
+  updater->source = NULL;
+
+  if (updater->apply(updater->user_data))
+  {
+    updater->applied++;
+
+    g_debug("Status updates requested %u, applied %u", updater->requested,
+            updater->applied);
+  }
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+_update_schedule(NuiStatusUpdater *updater)
+{
+  if (updater->source)
+    return;
+
+  if (updater->delay)
+    updater->source = g_timeout_source_new(updater->delay);
+  else
+    updater->source = g_idle_source_new();
+
+  g_source_set_callback(updater->source, _update_cb, updater, NULL);
+  g_source_attach(updater->source, updater->context);
+}
+
+static void
+_update_cancel(NuiStatusUpdater *updater)
+{
+  if (updater->source)
+  {
+    g_source_destroy(updater->source);
+    g_source_unref(updater->source);
+    updater->source = NULL;
+  }
+}
+
+static void
+_display_status_set(NuiStatusUpdater *updater, const gchar *status)
+{
+  gboolean off = !g_strcmp0(status, MCE_DISPLAY_OFF_STRING);
+
+  if (off == updater->display_off)
+    return;
+
+  g_debug("Display %s", status);
+
+  updater->display_off = off;
+
+  if (off)
+  {
+    if (updater->source)
+    {
+      _update_cancel(updater);
+      updater->pending = TRUE;
+    }
+  }
+  else if (updater->pending)
+  {
+    /* only the last state matters, whatever happened while blanked */
+    updater->pending = FALSE;
+    _update_schedule(updater);
+  }
+}
+
+static void
+_display_status_ind_cb(GDBusConnection *connection, const gchar *sender_name,
+                       const gchar *object_path, const gchar *interface_name,
+                       const gchar *signal_name, GVariant *parameters,
+                       gpointer user_data)
+{
+  const gchar *status;
+
+  if (!g_variant_is_of_type(parameters, G_VARIANT_TYPE("(s)")))
+    return;
+
+  g_variant_get(parameters, "(&s)", &status);
+  _display_status_set(user_data, status);
+}
+
+static void
+_get_display_status_cb(GObject *object, GAsyncResult *res,
+                       gpointer user_data)
+{
+  GError *error = NULL;
+  GVariant *reply;
+  const gchar *status;
+
+  reply = g_dbus_connection_call_finish(G_DBUS_CONNECTION(object), res,
+                                        &error);
+
+  if (!reply)
+  {
+    if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+      g_warning("Error getting display status [%s]", error->message);
+
+    g_error_free(error);
+    return;
+  }
+
+  g_variant_get(reply, "(&s)", &status);
+  _display_status_set(user_data, status);
+  g_variant_unref(reply);
+}
+
+static void
+_system_bus_ready_cb(GObject *object, GAsyncResult *res, gpointer user_data)
+{
+  NuiStatusUpdater *updater;
+  GDBusConnection *connection;
+  GError *error = NULL;
+
+  connection = g_bus_get_finish(res, &error);
+
+  if (!connection)
+  {
+    if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+      g_warning("Error getting system bus [%s]", error->message);
+
+    g_error_free(error);
+    return;
+  }
+
+  updater = user_data;
+  updater->system_bus = connection;
+  updater->display_status_id = g_dbus_connection_signal_subscribe(
+        connection, MCE_SERVICE, MCE_SIGNAL_IF, MCE_DISPLAY_SIG,
+        MCE_SIGNAL_PATH, NULL, G_DBUS_SIGNAL_FLAGS_NONE,
+        _display_status_ind_cb, updater, NULL);
+
+  g_dbus_connection_call(connection, MCE_SERVICE, MCE_REQUEST_PATH,
+                         MCE_REQUEST_IF, MCE_DISPLAY_STATUS_GET, NULL,
+                         G_VARIANT_TYPE("(s)"), G_DBUS_CALL_FLAGS_NONE, -1,
+                         updater->cancellable, _get_display_status_cb,
+                         updater);
+}
+
+NuiStatusUpdater *
+nui_status_updater_new(guint delay, NuiStatusUpdaterApplyFunc apply,
+                       gpointer user_data)
+{
+  NuiStatusUpdater *updater;
+
+  g_return_val_if_fail(apply != NULL, NULL);
+
+  updater = g_slice_new0(NuiStatusUpdater);
+  updater->delay = delay;
+  updater->apply = apply;
+  updater->user_data = user_data;
+  updater->context = g_main_context_ref_thread_default();
+
+  /* no point in updating what can not be seen while the display is off */
+  updater->cancellable = g_cancellable_new();
+  g_bus_get(G_BUS_TYPE_SYSTEM, updater->cancellable, _system_bus_ready_cb,
+            updater);
+
+  return updater;
+}
+
+void
+nui_status_updater_free(NuiStatusUpdater *updater)
+{
+  _update_cancel(updater);
+
+  g_cancellable_cancel(updater->cancellable);
+  g_object_unref(updater->cancellable);
+
+  if (updater->system_bus)
+  {
+    g_dbus_connection_signal_unsubscribe(updater->system_bus,
+                                         updater->display_status_id);
+    g_object_unref(updater->system_bus);
+  }
+
+  g_main_context_unref(updater->context);
+  g_slice_free(NuiStatusUpdater, updater);
+}
+
+void
+nui_status_updater_request(NuiStatusUpdater *updater)
+{
+  updater->requested++;
+
+  /* state changes come in bursts, update once per burst */
+  if (updater->display_off)
+    updater->pending = TRUE;
+  else
+    _update_schedule(updater);
+}
+
+gboolean
+nui_status_updater_get_display_off(NuiStatusUpdater *updater)
+{
+  return updater->display_off;
+}
+
+void
+nui_status_updater_get_stats(NuiStatusUpdater *updater, guint *requested,
+                             guint *applied)
+{
+  if (requested)
+    *requested = updater->requested;
+
+  if (applied)
+    *applied = updater->applied;
+}
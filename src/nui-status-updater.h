@@ -0,0 +1,51 @@
+/*
+ * nui-status-updater.h
+ *
+ * Copyright (C) 2024 Ivaylo Dimitrov <ivo.g.dimitrov.75@gmail.com>
+ *
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __NUI_STATUS_UPDATER_H__
+#define __NUI_STATUS_UPDATER_H__
+
+G_BEGIN_DECLS
+
+typedef struct _NuiStatusUpdater NuiStatusUpdater;
+
+/* brings the UI up to date with the latest requested state, returns TRUE if
+ * anything on screen changed
+ */
+typedef gboolean (*NuiStatusUpdaterApplyFunc)(gpointer user_data);
+
+/* coalesces update requests made within delay ms, 0 meaning within the same
+ * main loop iteration, and holds them back while MCE reports the display
+ * off. runs in the thread-default main context of the caller.
+ */
+NuiStatusUpdater *nui_status_updater_new(guint delay,
+                                         NuiStatusUpdaterApplyFunc apply,
+                                         gpointer user_data);
+void nui_status_updater_free(NuiStatusUpdater *updater);
+
+void nui_status_updater_request(NuiStatusUpdater *updater);
+
+gboolean nui_status_updater_get_display_off(NuiStatusUpdater *updater);
+
+/* requests made and updates that changed something on screen */
+void nui_status_updater_get_stats(NuiStatusUpdater *updater,
+                                  guint *requested, guint *applied);
+
+G_END_DECLS
+
+#endif /* __NUI_STATUS_UPDATER_H__ */
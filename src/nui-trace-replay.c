@@ -0,0 +1,157 @@
+/*
+ * nui-trace-replay.c
+ *
+ * Copyright (C) 2024 Ivaylo Dimitrov <ivo.g.dimitrov.75@gmail.com>
+ *
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "config.h"
+
+#include <gio/gio.h>
+
+#include <stdio.h>
+
+#include "nui-call-monitor.h"
+
+/* replays a trace recorded with NUI_CALL_MONITOR_TRACE into an offline
+ * NuiCallMonitor and reports what it emitted and how long it took
+ */
+
+static gboolean realtime = FALSE;
+static gboolean verbose = FALSE;
+
+static GOptionEntry entries[] =
+{
+  { "realtime", 'r', 0, G_OPTION_ARG_NONE, &realtime,
+    "Keep the recorded delays between events", NULL },
+  { "verbose", 'v', 0, G_OPTION_ARG_NONE, &verbose,
+    "Print every signal the monitor emits", NULL },
+  { NULL }
+};
+
+typedef struct
+{
+  guint status_changes;
+  guint calls_changes;
+  guint messages;
+  gboolean status;
+} ReplayResult;
+
+static void
+status_changed_cb(NuiCallMonitor *monitor, gboolean status,
+                  gpointer user_data)
+{
+  ReplayResult *result = user_data;
+
+  result->status_changes++;
+  result->status = status;
+
+  if (verbose)
+    printf("status-changed %s\n", status ? "TRUE" : "FALSE");
+}
+
+static void
+calls_changed_cb(NuiCallMonitor *monitor, GVariant *calls, gpointer user_data)
+{
+  ReplayResult *result = user_data;
+
+  result->calls_changes++;
+
+  if (verbose)
+  {
+    gchar *s = g_variant_print(calls, FALSE);
+
+    printf("calls-changed %s\n", s);
+    g_free(s);
+  }
+}
+
+static void
+messages_received_cb(NuiCallMonitor *monitor, GVariant *messages,
+                     gpointer user_data)
+{
+  ReplayResult *result = user_data;
+
+  result->messages += g_variant_n_children(messages);
+
+  if (verbose)
+  {
+    gchar *s = g_variant_print(messages, FALSE);
+
+    printf("messages-received %s\n", s);
+    g_free(s);
+  }
+}
+
+int
+main(int argc, char **argv)
+{
+  ReplayResult result = { 0 };
+  GOptionContext *context;
+  NuiCallMonitor *monitor;
+  GError *error = NULL;
+  gint64 start;
+  gint64 elapsed;
+
+  context = g_option_context_new("TRACE - replay a call monitor trace");
+  g_option_context_add_main_entries(context, entries, NULL);
+
+  if (!g_option_context_parse(context, &argc, &argv, &error) || argc != 2)
+  {
+    g_printerr("%s\n", error ? error->message :
+               "exactly one trace file is expected");
+    g_clear_error(&error);
+    g_option_context_free(context);
+
+    return 1;
+  }
+
+  g_option_context_free(context);
+
+  monitor = g_object_new(NUI_TYPE_CALL_MONITOR, "offline", TRUE, NULL);
+  g_signal_connect(monitor, "status-changed",
+                   G_CALLBACK(status_changed_cb), &result);
+  g_signal_connect(monitor, "calls-changed",
+                   G_CALLBACK(calls_changed_cb), &result);
+  g_signal_connect(monitor, "messages-received",
+                   G_CALLBACK(messages_received_cb), &result);
+
+  start = g_get_monotonic_time();
+
+  if (!nui_call_monitor_replay(monitor, argv[1], realtime, &error))
+  {
+    g_printerr("Replaying %s failed: %s\n", argv[1], error->message);
+    g_error_free(error);
+    g_object_unref(monitor);
+
+    return 1;
+  }
+
+  /* messages are handed over from an idle */
+  while (g_main_context_iteration(NULL, FALSE))
+    ;
+
+  elapsed = g_get_monotonic_time() - start;
+
+  printf("status changes %u, calls changes %u, messages %u, "
+         "final status %s\n", result.status_changes, result.calls_changes,
+         result.messages,
+         nui_call_monitor_get_status(monitor) ? "active" : "idle");
+  printf("replayed in %" G_GINT64_FORMAT " us\n", elapsed);
+
+  g_object_unref(monitor);
+
+  return 0;
+}
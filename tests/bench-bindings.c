@@ -0,0 +1,230 @@
+/*
+ * bench-bindings.c
+ *
+ * Copyright (C) 2024 Ivaylo Dimitrov <ivo.g.dimitrov.75@gmail.com>
+ *
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "config.h"
+
+#include <gio/gio.h>
+#include <gmodule.h>
+
+#include <link.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* compares the gdbus-codegen oFono wrappers with the nui-ofono bindings,
+ * both built as modules of their own: code size, relocations, GTypes
+ * registered on first use and dlopen() time. prints one JSON object per
+ * module on stdout.
+ */
+
+static gint runs = 200;
+
+static GOptionEntry entries[] =
+{
+  { "runs", 'r', 0, G_OPTION_ARG_INT, &runs,
+    "dlopen()/dlclose() cycles the load time is the median of", "N" },
+  { NULL }
+};
+
+typedef struct
+{
+  const gchar *name;
+  gsize text;
+  gsize relocations;
+  guint types;
+  gint64 load_ns;
+} Result;
+
+/* executable bytes and dynamic relocations, what size(1) and readelf -r
+ * would report
+ */
+static void
+_elf_parse(const gchar *path, Result *result)
+{
+  const ElfW(Ehdr) *ehdr;
+  const ElfW(Shdr) *shdr;
+  GError *error = NULL;
+  gchar *data;
+  gsize len;
+  guint i;
+
+  if (!g_file_get_contents(path, &data, &len, &error))
+    g_error("%s", error->message);
+
+  ehdr = (const ElfW(Ehdr) *)data;
+
+  if (len < sizeof(*ehdr) || memcmp(ehdr->e_ident, ELFMAG, SELFMAG) ||
+      ehdr->e_ident[EI_CLASS] != (sizeof(gpointer) == 8 ? ELFCLASS64 :
+                                  ELFCLASS32) ||
+      ehdr->e_shoff + ehdr->e_shnum * sizeof(*shdr) > len)
+  {
+    g_error("%s is not a native ELF object", path);
+  }
+
+  shdr = (const ElfW(Shdr) *)(data + ehdr->e_shoff);
+
+  for (i = 0; i < ehdr->e_shnum; i++)
+  {
+    if (shdr[i].sh_flags & SHF_EXECINSTR)
+      result->text += shdr[i].sh_size;
+
+    if ((shdr[i].sh_type == SHT_RELA || shdr[i].sh_type == SHT_REL) &&
+        shdr[i].sh_entsize)
+    {
+      result->relocations += shdr[i].sh_size / shdr[i].sh_entsize;
+    }
+  }
+
+  g_free(data);
+}
+
+static guint
+_types_count(void)
+{
+  /* where gdbus-codegen puts its types */
+  GType roots[] =
+  {
+    G_TYPE_INTERFACE,
+    G_TYPE_DBUS_PROXY,
+    G_TYPE_DBUS_INTERFACE_SKELETON
+  };
+  guint total = 0;
+  guint i;
+
+  for (i = 0; i < G_N_ELEMENTS(roots); i++)
+  {
+    guint n;
+
+    g_free(g_type_children(roots[i], &n));
+    total += n;
+  }
+
+  return total;
+}
+
+static int
+_cmp_gint64(gconstpointer a, gconstpointer b)
+{
+  gint64 x = *(const gint64 *)a;
+  gint64 y = *(const gint64 *)b;
+
+  return x < y ? -1 : x > y;
+}
+
+static void
+bench_module(Result *result)
+{
+  void (*init)(void);
+  GModule *module;
+  GArray *samples;
+  gchar *path;
+  guint types;
+  gint i;
+
+  path = g_strdup_printf("%s/.libs/bindings-%s.so", NUI_TEST_BUILDDIR,
+                         result->name);
+  _elf_parse(path, result);
+
+  /* nothing gets registered until init is called, so the module can be
+   * unloaded again
+   */
+  samples = g_array_new(FALSE, FALSE, sizeof(gint64));
+
+  for (i = 0; i < runs; i++)
+  {
+    gint64 start = g_get_monotonic_time();
+
+    module = g_module_open(path, G_MODULE_BIND_LOCAL);
+
+    if (!module)
+      g_error("%s", g_module_error());
+
+    g_module_close(module);
+    start = (g_get_monotonic_time() - start) * 1000;
+    g_array_append_val(samples, start);
+  }
+
+  g_array_sort(samples, _cmp_gint64);
+  result->load_ns = g_array_index(samples, gint64, samples->len / 2);
+  g_array_free(samples, TRUE);
+
+  /* kept loaded, GTypes can not go away */
+  module = g_module_open(path, G_MODULE_BIND_LOCAL);
+
+  if (!module || !g_module_symbol(module, "nui_bindings_init",
+                                  (gpointer *)&init))
+  {
+    g_error("%s", g_module_error());
+  }
+
+  g_module_make_resident(module);
+  types = _types_count();
+  init();
+  result->types = _types_count() - types;
+
+  g_free(path);
+}
+
+static void
+_print(const Result *result)
+{
+  printf("{\"bench\":\"bindings\",\"module\":\"%s\",\"text_bytes\":%"
+         G_GSIZE_FORMAT ",\"relocations\":%" G_GSIZE_FORMAT
+         ",\"types\":%u,\"dlopen_us\":%.1f}\n",
+         result->name, result->text, result->relocations, result->types,
+         result->load_ns / 1000.0);
+}
+
+int
+main(int argc, char **argv)
+{
+  Result generated = { "generated" };
+  Result lean = { "lean" };
+  GOptionContext *context;
+  GError *error = NULL;
+
+  context = g_option_context_new("- oFono bindings size and load time");
+  g_option_context_add_main_entries(context, entries, NULL);
+
+  if (!g_option_context_parse(context, &argc, &argv, &error))
+  {
+    g_printerr("%s\n", error->message);
+    g_error_free(error);
+    g_option_context_free(context);
+
+    return EXIT_FAILURE;
+  }
+
+  g_option_context_free(context);
+
+  if (runs < 1)
+  {
+    g_printerr("--runs must be positive\n");
+
+    return EXIT_FAILURE;
+  }
+
+  bench_module(&generated);
+  _print(&generated);
+
+  bench_module(&lean);
+  _print(&lean);
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,350 @@
+/*
+ * bench-call-monitor.c
+ *
+ * Copyright (C) 2024 Ivaylo Dimitrov <ivo.g.dimitrov.75@gmail.com>
+ *
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "config.h"
+
+#include <gio/gio.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "nui-call-monitor.h"
+
+#include "nui-mock-ofono.h"
+#include "nui-test.h"
+
+/* drives a NuiCallMonitor through the mock oFono and prints one JSON object
+ * per measurement on stdout
+ */
+
+static gint iterations = 1000;
+static gint burst = 5000;
+static gint rss_calls = 200;
+
+static GOptionEntry entries[] =
+{
+  { "iterations", 'n', 0, G_OPTION_ARG_INT, &iterations,
+    "State changes the latency is measured over", "N" },
+  { "burst", 'b', 0, G_OPTION_ARG_INT, &burst,
+    "State changes sent back to back for the sustained rate", "N" },
+  { "rss-calls", 'c', 0, G_OPTION_ARG_INT, &rss_calls,
+    "Calls the memory cost per call is measured with", "N" },
+  { NULL }
+};
+
+typedef struct
+{
+  GTestDBus *bus;
+  NuiMockOfono *ofono;
+  NuiCallMonitor *monitor;
+  gboolean threaded;
+  /* a{sau} the monitor emitted last */
+  GVariant *calls;
+  gint64 changed_time;
+} Bench;
+
+typedef struct
+{
+  Bench *b;
+  NuiCallState state;
+  guint count;
+} Expected;
+
+static const gchar *
+_mode(Bench *b)
+{
+  return b->threaded ? "threaded" : "direct";
+}
+
+static guint
+_count(GVariant *calls, NuiCallState state)
+{
+  GVariantIter iter;
+  GVariant *counts;
+  guint n = 0;
+
+  if (!calls)
+    return 0;
+
+  g_variant_iter_init(&iter, calls);
+
+  while (g_variant_iter_loop(&iter, "{&s@au}", NULL, &counts))
+  {
+    const guint32 *c;
+    gsize len;
+    gsize i;
+
+    c = g_variant_get_fixed_array(counts, &len, sizeof(guint32));
+
+    for (i = 0; i < len; i++)
+    {
+      if (state == NUI_CALL_STATE_LAST || i == state)
+        n += c[i];
+    }
+  }
+
+  return n;
+}
+
+static gboolean
+_expected_cb(gpointer user_data)
+{
+  Expected *e = user_data;
+
+  return _count(e->b->calls, e->state) == e->count;
+}
+
+/* NUI_CALL_STATE_LAST counts the calls in any state */
+static void
+_wait(Bench *b, NuiCallState state, guint count)
+{
+  Expected e = { b, state, count };
+
+  nui_mock_ofono_flush(b->ofono);
+
+  if (!nui_test_wait(_expected_cb, &e))
+    g_error("Timed out waiting for %u calls in state %d", count, state);
+}
+
+static void
+_calls_changed_cb(NuiCallMonitor *monitor, GVariant *calls,
+                  gpointer user_data)
+{
+  Bench *b = user_data;
+
+  if (b->calls)
+    g_variant_unref(b->calls);
+
+  b->calls = g_variant_ref(calls);
+  b->changed_time = g_get_monotonic_time();
+}
+
+static void
+_bench_up(Bench *b, gboolean threaded)
+{
+  memset(b, 0, sizeof(*b));
+  b->threaded = threaded;
+  b->bus = nui_test_bus_up();
+  b->ofono = nui_mock_ofono_new(g_test_dbus_get_bus_address(b->bus));
+}
+
+static void
+_monitor_new(Bench *b)
+{
+  b->monitor = g_object_new(NUI_TYPE_CALL_MONITOR,
+                            "threaded", b->threaded,
+                            NULL);
+  g_signal_connect(b->monitor, "calls-changed",
+                   G_CALLBACK(_calls_changed_cb), b);
+}
+
+static void
+_bench_down(Bench *b)
+{
+  g_clear_object(&b->monitor);
+  nui_test_spin(100);
+  nui_mock_ofono_free(b->ofono);
+  nui_test_bus_down(b->bus);
+
+  if (b->calls)
+    g_variant_unref(b->calls);
+}
+
+static int
+_cmp_gint64(gconstpointer a, gconstpointer b)
+{
+  gint64 x = *(const gint64 *)a;
+  gint64 y = *(const gint64 *)b;
+
+  return x < y ? -1 : x > y;
+}
+
+/* time from the mock sending PropertyChanged to "calls-changed" */
+static void
+bench_latency(gboolean threaded)
+{
+  GArray *samples = g_array_new(FALSE, FALSE, sizeof(gint64));
+  const gchar *call;
+  Bench b;
+  gint64 total = 0;
+  gint i;
+
+  _bench_up(&b, threaded);
+  nui_mock_ofono_add_modem(b.ofono, "/ril_0", TRUE);
+  call = nui_mock_ofono_add_call(b.ofono, "/ril_0", "active");
+  _monitor_new(&b);
+  _wait(&b, NUI_CALL_STATE_ACTIVE, 1);
+
+  for (i = 0; i < iterations; i++)
+  {
+    gboolean held = !(i & 1);
+    gint64 start = g_get_monotonic_time();
+    gint64 latency;
+
+    nui_mock_ofono_set_call_state(b.ofono, call, held ? "held" : "active");
+    _wait(&b, held ? NUI_CALL_STATE_HELD : NUI_CALL_STATE_ACTIVE, 1);
+
+    latency = b.changed_time - start;
+    total += latency;
+    g_array_append_val(samples, latency);
+  }
+
+  g_array_sort(samples, _cmp_gint64);
+
+#define PERCENTILE(p) \
+  g_array_index(samples, gint64, (samples->len - 1) * (p) / 100)
+
+  printf("{\"bench\":\"latency\",\"mode\":\"%s\",\"n\":%u,"
+         "\"mean_us\":%" G_GINT64_FORMAT ",\"p50_us\":%" G_GINT64_FORMAT
+         ",\"p90_us\":%" G_GINT64_FORMAT ",\"p99_us\":%" G_GINT64_FORMAT
+         ",\"max_us\":%" G_GINT64_FORMAT "}\n",
+         _mode(&b), samples->len, total / samples->len, PERCENTILE(50),
+         PERCENTILE(90), PERCENTILE(99), PERCENTILE(100));
+
+#undef PERCENTILE
+
+  g_array_free(samples, TRUE);
+  _bench_down(&b);
+}
+
+/* state changes sent back to back, CallRemoved marks the end of the burst */
+static void
+bench_rate(gboolean threaded)
+{
+  const gchar *call;
+  gint64 start;
+  gint64 elapsed;
+  Bench b;
+  gint i;
+
+  _bench_up(&b, threaded);
+  nui_mock_ofono_add_modem(b.ofono, "/ril_0", TRUE);
+  call = nui_mock_ofono_add_call(b.ofono, "/ril_0", "active");
+  _monitor_new(&b);
+  _wait(&b, NUI_CALL_STATE_ACTIVE, 1);
+
+  start = g_get_monotonic_time();
+
+  for (i = 0; i < burst; i++)
+  {
+    nui_mock_ofono_set_call_state(b.ofono, call,
+                                  (i & 1) ? "active" : "held");
+  }
+
+  nui_mock_ofono_remove_call(b.ofono, call);
+  _wait(&b, NUI_CALL_STATE_LAST, 0);
+  elapsed = g_get_monotonic_time() - start;
+
+  printf("{\"bench\":\"rate\",\"mode\":\"%s\",\"n\":%d,"
+         "\"elapsed_us\":%" G_GINT64_FORMAT ",\"per_second\":%.0f}\n",
+         _mode(&b), burst, elapsed, burst * 1000000.0 / MAX(elapsed, 1));
+
+  _bench_down(&b);
+}
+
+/* calls are created in the mock first, so only the monitor side is
+ * accounted for once the voice call manager shows up
+ */
+static void
+bench_memory(gboolean threaded)
+{
+  glong before;
+  glong after;
+  Bench b;
+  gint i;
+
+  _bench_up(&b, threaded);
+  nui_mock_ofono_add_modem(b.ofono, "/ril_0", FALSE);
+
+  for (i = 0; i < rss_calls; i++)
+    nui_mock_ofono_add_call(b.ofono, "/ril_0", "held");
+
+  _monitor_new(&b);
+  nui_test_spin(200);
+  before = nui_test_rss_kb();
+
+  nui_mock_ofono_set_voice(b.ofono, "/ril_0", TRUE);
+  _wait(&b, NUI_CALL_STATE_HELD, rss_calls);
+  after = nui_test_rss_kb();
+
+  printf("{\"bench\":\"memory\",\"mode\":\"%s\",\"calls\":%d,"
+         "\"rss_before_kb\":%ld,\"rss_after_kb\":%ld,"
+         "\"bytes_per_call\":%ld}\n",
+         _mode(&b), rss_calls, before, after,
+         (after - before) * 1024 / MAX(rss_calls, 1));
+
+  _bench_down(&b);
+}
+
+static void
+bench_discovery(gboolean threaded, guint modems)
+{
+  gint64 start;
+  Bench b;
+
+  _bench_up(&b, threaded);
+  nui_mock_ofono_populate(b.ofono, modems, 4, "active");
+
+  start = g_get_monotonic_time();
+  _monitor_new(&b);
+  _wait(&b, NUI_CALL_STATE_ACTIVE, modems * 4);
+
+  printf("{\"bench\":\"discovery\",\"mode\":\"%s\",\"modems\":%u,"
+         "\"calls\":%u,\"elapsed_us\":%" G_GINT64_FORMAT "}\n",
+         _mode(&b), modems, modems * 4, b.changed_time - start);
+
+  _bench_down(&b);
+}
+
+int
+main(int argc, char **argv)
+{
+  static const guint modems[] = { 1, 2, 8 };
+  GOptionContext *context;
+  GError *error = NULL;
+  int threaded;
+  guint i;
+
+  context = g_option_context_new("- call monitor benchmarks");
+  g_option_context_add_main_entries(context, entries, NULL);
+
+  if (!g_option_context_parse(context, &argc, &argv, &error))
+  {
+    g_printerr("%s\n", error->message);
+    g_error_free(error);
+    g_option_context_free(context);
+
+    return EXIT_FAILURE;
+  }
+
+  g_option_context_free(context);
+
+  for (threaded = 0; threaded < 2; threaded++)
+  {
+    for (i = 0; i < G_N_ELEMENTS(modems); i++)
+      bench_discovery(threaded, modems[i]);
+
+    bench_latency(threaded);
+    bench_rate(threaded);
+    bench_memory(threaded);
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,185 @@
+/*
+ * bench-core-burst.c
+ *
+ * Copyright (C) 2024 Ivaylo Dimitrov <ivo.g.dimitrov.75@gmail.com>
+ *
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "config.h"
+
+#include <gio/gio.h>
+#include <glib/gstdio.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "nui-core.h"
+
+#include "nui-mock-notifications.h"
+#include "nui-mock-ofono.h"
+#include "nui-test.h"
+
+/* sends a burst of SMS through the mock oFono and counts the notifications
+ * NuiCore creates and updates for them, along with the time the default main
+ * context spent outside of poll() meanwhile. prints one JSON object.
+ * shown_ms includes the time SMS are held back for their Telepathy copy.
+ */
+
+/* no Notify within that many ms means the burst has been shown */
+#define QUIET_MS 1500
+
+static gint events = 500;
+static gint senders = 25;
+
+static GOptionEntry entries[] =
+{
+  { "events", 'e', 0, G_OPTION_ARG_INT, &events,
+    "SMS sent back to back", "N" },
+  { "senders", 's', 0, G_OPTION_ARG_INT, &senders,
+    "Senders the SMS are spread over", "N" },
+  { NULL }
+};
+
+static GPollFunc default_poll;
+static gint64 poll_time;
+
+static gint
+_poll(GPollFD *fds, guint nfds, gint timeout)
+{
+  gint64 start = g_get_monotonic_time();
+  gint rv = default_poll(fds, nfds, timeout);
+
+  poll_time += g_get_monotonic_time() - start;
+
+  return rv;
+}
+
+static gboolean
+_shown_cb(gpointer user_data)
+{
+  NuiMockNotifications *notifications = user_data;
+  gint64 last = nui_mock_notifications_get_last_notify(notifications);
+
+  return nui_mock_notifications_get_created(notifications) >= (guint)senders &&
+      g_get_monotonic_time() - last > QUIET_MS * 1000;
+}
+
+static void
+_cache_remove(const gchar *dir)
+{
+  gchar *path = g_build_filename(dir, PACKAGE_NAME, "counters", NULL);
+
+  g_remove(path);
+  g_free(path);
+
+  path = g_build_filename(dir, PACKAGE_NAME, NULL);
+  g_rmdir(path);
+  g_free(path);
+
+  g_rmdir(dir);
+}
+
+int
+main(int argc, char **argv)
+{
+  NuiMockNotifications *notifications;
+  GOptionContext *context;
+  NuiMockOfono *ofono;
+  GError *error = NULL;
+  GTestDBus *bus;
+  NuiCore *core;
+  gchar *cache;
+  gint64 start;
+  gint64 wall;
+  gint64 busy;
+  gint i;
+
+  context = g_option_context_new("- notification coalescing under SMS bursts");
+  g_option_context_add_main_entries(context, entries, NULL);
+
+  if (!g_option_context_parse(context, &argc, &argv, &error))
+  {
+    g_printerr("%s\n", error->message);
+    g_error_free(error);
+    g_option_context_free(context);
+
+    return EXIT_FAILURE;
+  }
+
+  g_option_context_free(context);
+
+  if (events < 1 || senders < 1)
+  {
+    g_printerr("--events and --senders must be positive\n");
+
+    return EXIT_FAILURE;
+  }
+
+  /* keep the stored counters out of the user ones */
+  cache = g_dir_make_tmp("nui-bench-XXXXXX", &error);
+  g_assert_no_error(error);
+  g_setenv("XDG_CACHE_HOME", cache, TRUE);
+
+  bus = nui_test_bus_up();
+  ofono = nui_mock_ofono_new(g_test_dbus_get_bus_address(bus));
+  nui_mock_ofono_add_modem(ofono, "/ril_0", FALSE);
+  notifications = nui_mock_notifications_new(
+        g_test_dbus_get_bus_address(bus));
+
+  core = nui_core_new();
+  nui_test_spin(500);
+
+  default_poll = g_main_context_get_poll_func(NULL);
+  g_main_context_set_poll_func(NULL, _poll);
+  poll_time = 0;
+  start = g_get_monotonic_time();
+
+  for (i = 0; i < events; i++)
+  {
+    gchar *sender = g_strdup_printf("+1555010%04d", i % senders);
+    gchar *text = g_strdup_printf("Message %d", i);
+
+    nui_mock_ofono_send_message(ofono, "/ril_0", sender, text, FALSE);
+    g_free(text);
+    g_free(sender);
+  }
+
+  nui_mock_ofono_flush(ofono);
+
+  if (!nui_test_wait(_shown_cb, notifications))
+    g_error("Timed out waiting for the notifications");
+
+  wall = g_get_monotonic_time() - start;
+  busy = wall - poll_time;
+  g_main_context_set_poll_func(NULL, default_poll);
+
+  printf("{\"bench\":\"core-burst\",\"events\":%d,\"senders\":%d,"
+         "\"created\":%u,\"updated\":%u,\"shown_ms\":%" G_GINT64_FORMAT
+         ",\"busy_ms\":%.3f,\"busy_per_event_us\":%.1f}\n",
+         events, senders, nui_mock_notifications_get_created(notifications),
+         nui_mock_notifications_get_updated(notifications),
+         (nui_mock_notifications_get_last_notify(notifications) - start) /
+         1000, busy / 1000.0, (gdouble)busy / events);
+
+  g_object_unref(core);
+  nui_test_spin(100);
+  nui_mock_notifications_free(notifications);
+  nui_mock_ofono_free(ofono);
+  nui_test_bus_down(bus);
+  _cache_remove(cache);
+  g_free(cache);
+
+  return EXIT_SUCCESS;
+}
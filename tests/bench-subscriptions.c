@@ -0,0 +1,368 @@
+/*
+ * bench-subscriptions.c
+ *
+ * Copyright (C) 2024 Ivaylo Dimitrov <ivo.g.dimitrov.75@gmail.com>
+ *
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "config.h"
+
+#include <gio/gio.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "nui-call-monitor.h"
+
+#include "nui-mock-ofono.h"
+#include "nui-test.h"
+
+/* compares the single VoiceCall PropertyChanged subscription of the monitor
+ * with a GDBusProxy per call, the way calls used to be tracked. prints one
+ * JSON object per design on stdout.
+ */
+
+static gint n_calls = 50;
+static gint n_signals = 10000;
+
+static GOptionEntry entries[] =
+{
+  { "calls", 'c', 0, G_OPTION_ARG_INT, &n_calls,
+    "Calls tracked at the same time", "N" },
+  { "signals", 's', 0, G_OPTION_ARG_INT, &n_signals,
+    "PropertyChanged signals the dispatch cost is measured over", "N" },
+  { NULL }
+};
+
+typedef struct
+{
+  GTestDBus *bus;
+  NuiMockOfono *ofono;
+  GDBusConnection *system;
+  gchar **paths;
+  /* per-proxy design */
+  GPtrArray *proxies;
+  guint received;
+  /* monitor design, a{sau} it emitted last */
+  NuiCallMonitor *monitor;
+  GVariant *calls;
+} Bench;
+
+typedef struct
+{
+  const gchar *design;
+  gint match_rules;
+  glong rss_kb;
+  gint64 elapsed;
+} Result;
+
+/* needs a bus daemon built with the Debug.Stats interface, -1 otherwise */
+static gint
+_match_rules(GDBusConnection *connection)
+{
+  GVariant *reply;
+  GVariant *stats;
+  guint32 rules;
+  gint rv = -1;
+
+  reply = g_dbus_connection_call_sync(
+        connection, "org.freedesktop.DBus", "/org/freedesktop/DBus",
+        "org.freedesktop.DBus.Debug.Stats", "GetConnectionStats",
+        g_variant_new("(s)", g_dbus_connection_get_unique_name(connection)),
+        G_VARIANT_TYPE("(a{sv})"), G_DBUS_CALL_FLAGS_NONE, -1, NULL, NULL);
+
+  if (!reply)
+    return -1;
+
+  g_variant_get(reply, "(@a{sv})", &stats);
+
+  if (g_variant_lookup(stats, "MatchRules", "u", &rules))
+    rv = rules;
+
+  g_variant_unref(stats);
+  g_variant_unref(reply);
+
+  return rv;
+}
+
+static void
+_bench_up(Bench *b)
+{
+  GError *error = NULL;
+
+  memset(b, 0, sizeof(*b));
+  b->bus = nui_test_bus_up();
+  b->ofono = nui_mock_ofono_new(g_test_dbus_get_bus_address(b->bus));
+  nui_mock_ofono_populate(b->ofono, 1, n_calls, "held");
+  b->paths = nui_mock_ofono_dup_calls(b->ofono);
+
+  /* the connection the monitor subscribes on */
+  b->system = g_bus_get_sync(G_BUS_TYPE_SYSTEM, NULL, &error);
+  g_assert_no_error(error);
+}
+
+static void
+_bench_down(Bench *b)
+{
+  g_clear_object(&b->monitor);
+
+  if (b->proxies)
+    g_ptr_array_free(b->proxies, TRUE);
+
+  nui_test_spin(100);
+  g_object_unref(b->system);
+  nui_mock_ofono_free(b->ofono);
+  nui_test_bus_down(b->bus);
+  g_strfreev(b->paths);
+
+  if (b->calls)
+    g_variant_unref(b->calls);
+}
+
+/* every call goes held, active, held, ... one signal at a time */
+static void
+_send(Bench *b)
+{
+  gint i;
+
+  for (i = 0; i < n_signals; i++)
+  {
+    guint call = i % n_calls;
+
+    nui_mock_ofono_set_call_state(b->ofono, b->paths[call],
+                                  (i / n_calls) & 1 ? "held" : "active");
+  }
+
+  nui_mock_ofono_flush(b->ofono);
+}
+
+static void
+_proxy_signal_cb(GDBusProxy *proxy, const gchar *sender,
+                 const gchar *signal_name, GVariant *parameters,
+                 gpointer user_data)
+{
+  Bench *b = user_data;
+  const gchar *name;
+  GVariant *value;
+
+  if (strcmp(signal_name, "PropertyChanged") ||
+      !g_variant_is_of_type(parameters, G_VARIANT_TYPE("(sv)")))
+  {
+    return;
+  }
+
+  g_variant_get(parameters, "(&sv)", &name, &value);
+
+  if (!strcmp(name, "State"))
+    b->received++;
+
+  g_variant_unref(value);
+}
+
+static gboolean
+_proxies_done_cb(gpointer user_data)
+{
+  Bench *b = user_data;
+
+  return b->received == (guint)n_signals;
+}
+
+static void
+bench_proxies(Result *result)
+{
+  GError *error = NULL;
+  gint rules;
+  glong rss;
+  gint64 start;
+  Bench b;
+  gint i;
+
+  _bench_up(&b);
+  nui_test_spin(100);
+  rules = _match_rules(b.system);
+  rss = nui_test_rss_kb();
+
+  b.proxies = g_ptr_array_new_with_free_func(g_object_unref);
+
+  for (i = 0; i < n_calls; i++)
+  {
+    GDBusProxy *proxy = g_dbus_proxy_new_sync(
+          b.system,
+          G_DBUS_PROXY_FLAGS_DO_NOT_LOAD_PROPERTIES |
+          G_DBUS_PROXY_FLAGS_DO_NOT_AUTO_START,
+          NULL, "org.ofono", b.paths[i], "org.ofono.VoiceCall", NULL,
+          &error);
+
+    g_assert_no_error(error);
+    g_signal_connect(proxy, "g-signal", G_CALLBACK(_proxy_signal_cb), &b);
+    g_ptr_array_add(b.proxies, proxy);
+  }
+
+  nui_test_spin(100);
+  result->match_rules = rules < 0 ? -1 : _match_rules(b.system) - rules;
+  result->rss_kb = nui_test_rss_kb() - rss;
+
+  start = g_get_monotonic_time();
+  _send(&b);
+
+  if (!nui_test_wait(_proxies_done_cb, &b))
+    g_error("Timed out, %u of %d signals received", b.received, n_signals);
+
+  result->elapsed = g_get_monotonic_time() - start;
+
+  _bench_down(&b);
+}
+
+static void
+_calls_changed_cb(NuiCallMonitor *monitor, GVariant *calls,
+                  gpointer user_data)
+{
+  Bench *b = user_data;
+
+  if (b->calls)
+    g_variant_unref(b->calls);
+
+  b->calls = g_variant_ref(calls);
+}
+
+static guint
+_calls_count(Bench *b, NuiCallState state)
+{
+  GVariantIter iter;
+  GVariant *counts;
+  guint n = 0;
+
+  if (!b->calls)
+    return 0;
+
+  g_variant_iter_init(&iter, b->calls);
+
+  while (g_variant_iter_loop(&iter, "{&s@au}", NULL, &counts))
+  {
+    const guint32 *c;
+    gsize len;
+    gsize i;
+
+    c = g_variant_get_fixed_array(counts, &len, sizeof(guint32));
+
+    for (i = 0; i < len; i++)
+    {
+      if (state == NUI_CALL_STATE_LAST || state == i)
+        n += c[i];
+    }
+  }
+
+  return n;
+}
+
+static gboolean
+_monitor_ready_cb(gpointer user_data)
+{
+  return _calls_count(user_data, NUI_CALL_STATE_HELD) == (guint)n_calls;
+}
+
+static gboolean
+_monitor_done_cb(gpointer user_data)
+{
+  return _calls_count(user_data, NUI_CALL_STATE_LAST) == (guint)n_calls - 1;
+}
+
+static void
+bench_monitor(Result *result)
+{
+  gint rules;
+  glong rss;
+  gint64 start;
+  Bench b;
+
+  _bench_up(&b);
+  nui_test_spin(100);
+  rules = _match_rules(b.system);
+  rss = nui_test_rss_kb();
+
+  b.monitor = g_object_new(NUI_TYPE_CALL_MONITOR, NULL);
+  g_signal_connect(b.monitor, "calls-changed",
+                   G_CALLBACK(_calls_changed_cb), &b);
+
+  if (!nui_test_wait(_monitor_ready_cb, &b))
+    g_error("Timed out waiting for the monitor to discover the calls");
+
+  nui_test_spin(100);
+  result->match_rules = rules < 0 ? -1 : _match_rules(b.system) - rules;
+  result->rss_kb = nui_test_rss_kb() - rss;
+
+  /* CallRemoved marks the end, signals are handled in order */
+  start = g_get_monotonic_time();
+  _send(&b);
+  nui_mock_ofono_remove_call(b.ofono, b.paths[0]);
+  nui_mock_ofono_flush(b.ofono);
+
+  if (!nui_test_wait(_monitor_done_cb, &b))
+    g_error("Timed out waiting for the monitor to catch up");
+
+  result->elapsed = g_get_monotonic_time() - start;
+
+  _bench_down(&b);
+}
+
+static void
+_print(const Result *result)
+{
+  printf("{\"bench\":\"subscriptions\",\"design\":\"%s\",\"calls\":%d,"
+         "\"match_rules\":%d,\"rss_kb\":%ld,\"signals\":%d,"
+         "\"elapsed_us\":%" G_GINT64_FORMAT ",\"per_signal_ns\":%.0f}\n",
+         result->design, n_calls, result->match_rules, result->rss_kb,
+         n_signals, result->elapsed,
+         result->elapsed * 1000.0 / MAX(n_signals, 1));
+}
+
+int
+main(int argc, char **argv)
+{
+  Result proxies = { "per-proxy" };
+  Result monitor = { "monitor" };
+  GOptionContext *context;
+  GError *error = NULL;
+
+  context = g_option_context_new("- VoiceCall subscription benchmark");
+  g_option_context_add_main_entries(context, entries, NULL);
+
+  if (!g_option_context_parse(context, &argc, &argv, &error))
+  {
+    g_printerr("%s\n", error->message);
+    g_error_free(error);
+    g_option_context_free(context);
+
+    return EXIT_FAILURE;
+  }
+
+  g_option_context_free(context);
+
+  if (n_calls < 1 || n_signals < 1)
+  {
+    g_printerr("--calls and --signals must be positive\n");
+
+    return EXIT_FAILURE;
+  }
+
+  bench_proxies(&proxies);
+  _print(&proxies);
+
+  bench_monitor(&monitor);
+  _print(&monitor);
+
+  return EXIT_SUCCESS;
+}
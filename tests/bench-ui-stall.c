@@ -0,0 +1,246 @@
+/*
+ * bench-ui-stall.c
+ *
+ * Copyright (C) 2024 Ivaylo Dimitrov <ivo.g.dimitrov.75@gmail.com>
+ *
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "config.h"
+
+#include <gio/gio.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "nui-call-monitor.h"
+
+#include "nui-mock-ofono.h"
+#include "nui-test.h"
+
+/* measures how late a 1 ms timeout in the default main context fires while
+ * the mock oFono floods the monitor with call state changes from another
+ * thread, the default context standing in for the hildon-desktop UI one.
+ * prints one JSON object per monitor mode on stdout.
+ */
+
+#define TICK_US 1000
+
+static gint n_calls = 10;
+static gint rate = 5000;
+static gint duration = 3000;
+
+static GOptionEntry entries[] =
+{
+  { "calls", 'c', 0, G_OPTION_ARG_INT, &n_calls,
+    "Calls the state changes are spread over", "N" },
+  { "rate", 'r', 0, G_OPTION_ARG_INT, &rate,
+    "State changes sent per second", "N" },
+  { "duration", 'd', 0, G_OPTION_ARG_INT, &duration,
+    "Length of the storm in ms", "MS" },
+  { NULL }
+};
+
+typedef struct
+{
+  NuiMockOfono *ofono;
+  gchar **paths;
+  gint stop;
+  guint sent;
+} Storm;
+
+typedef struct
+{
+  gint64 last;
+  /* gint64 lateness of each tick, in us */
+  GArray *samples;
+} Ticker;
+
+typedef struct
+{
+  NuiCallMonitor *monitor;
+  guint active;
+} Discovery;
+
+static gpointer
+_storm_thread(gpointer data)
+{
+  Storm *storm = data;
+  gulong pause = 1000000 / MAX(rate, 1);
+  guint round = 0;
+
+  while (!g_atomic_int_get(&storm->stop))
+  {
+    guint i;
+
+    round++;
+
+    for (i = 0; storm->paths[i] && !g_atomic_int_get(&storm->stop); i++)
+    {
+      nui_mock_ofono_set_call_state(storm->ofono, storm->paths[i],
+                                    round & 1 ? "held" : "active");
+      storm->sent++;
+
+      if (pause)
+        g_usleep(pause);
+    }
+  }
+
+  return NULL;
+}
+
+static gboolean
+_tick_cb(gpointer user_data)
+{
+  Ticker *ticker = user_data;
+  gint64 now = g_get_monotonic_time();
+  gint64 late = now - ticker->last - TICK_US;
+
+  g_array_append_val(ticker->samples, late);
+  ticker->last = now;
+
+  return G_SOURCE_CONTINUE;
+}
+
+static void
+_calls_changed_cb(NuiCallMonitor *monitor, GVariant *calls,
+                  gpointer user_data)
+{
+  Discovery *d = user_data;
+  GVariantIter iter;
+  GVariant *counts;
+
+  d->active = 0;
+  g_variant_iter_init(&iter, calls);
+
+  while (g_variant_iter_loop(&iter, "{&s@au}", NULL, &counts))
+  {
+    const guint32 *c;
+    gsize len;
+
+    c = g_variant_get_fixed_array(counts, &len, sizeof(guint32));
+    d->active += c[NUI_CALL_STATE_ACTIVE] + c[NUI_CALL_STATE_HELD];
+  }
+}
+
+static gboolean
+_discovered_cb(gpointer user_data)
+{
+  Discovery *d = user_data;
+
+  return d->active == (guint)n_calls;
+}
+
+static int
+_cmp_gint64(gconstpointer a, gconstpointer b)
+{
+  gint64 x = *(const gint64 *)a;
+  gint64 y = *(const gint64 *)b;
+
+  return x < y ? -1 : x > y;
+}
+
+static void
+bench_stall(gboolean threaded)
+{
+  Discovery discovery = { NULL, 0 };
+  Ticker ticker;
+  Storm storm;
+  GTestDBus *bus;
+  GThread *thread;
+  guint tick_id;
+  gulong handler;
+  gint64 total = 0;
+  guint i;
+
+  bus = nui_test_bus_up();
+  storm.ofono = nui_mock_ofono_new(g_test_dbus_get_bus_address(bus));
+  storm.stop = 0;
+  storm.sent = 0;
+  nui_mock_ofono_populate(storm.ofono, 1, n_calls, "active");
+  storm.paths = nui_mock_ofono_dup_calls(storm.ofono);
+
+  discovery.monitor = g_object_new(NUI_TYPE_CALL_MONITOR,
+                                   "threaded", threaded,
+                                   NULL);
+  handler = g_signal_connect(discovery.monitor, "calls-changed",
+                             G_CALLBACK(_calls_changed_cb), &discovery);
+
+  if (!nui_test_wait(_discovered_cb, &discovery))
+    g_error("Timed out waiting for the monitor to discover the calls");
+
+  ticker.samples = g_array_new(FALSE, FALSE, sizeof(gint64));
+  ticker.last = g_get_monotonic_time();
+  tick_id = g_timeout_add(TICK_US / 1000, _tick_cb, &ticker);
+
+  thread = g_thread_new("storm", _storm_thread, &storm);
+  nui_test_spin(duration);
+  g_atomic_int_set(&storm.stop, 1);
+  g_thread_join(thread);
+  g_source_remove(tick_id);
+
+  g_array_sort(ticker.samples, _cmp_gint64);
+
+  for (i = 0; i < ticker.samples->len; i++)
+    total += g_array_index(ticker.samples, gint64, i);
+
+#define PERCENTILE(p) (!ticker.samples->len ? 0 : \
+  g_array_index(ticker.samples, gint64, \
+                (ticker.samples->len - 1) * (p) / 100))
+
+  printf("{\"bench\":\"ui-stall\",\"mode\":\"%s\",\"calls\":%d,"
+         "\"duration_ms\":%d,\"signals\":%u,\"ticks\":%u,"
+         "\"mean_late_us\":%" G_GINT64_FORMAT ",\"p50_late_us\":%"
+         G_GINT64_FORMAT ",\"p99_late_us\":%" G_GINT64_FORMAT
+         ",\"max_late_us\":%" G_GINT64_FORMAT "}\n",
+         threaded ? "threaded" : "direct", n_calls, duration, storm.sent,
+         ticker.samples->len, total / MAX(ticker.samples->len, 1),
+         PERCENTILE(50), PERCENTILE(99), PERCENTILE(100));
+
+#undef PERCENTILE
+
+  g_array_free(ticker.samples, TRUE);
+  g_signal_handler_disconnect(discovery.monitor, handler);
+  g_object_unref(discovery.monitor);
+  nui_test_spin(100);
+  g_strfreev(storm.paths);
+  nui_mock_ofono_free(storm.ofono);
+  nui_test_bus_down(bus);
+}
+
+int
+main(int argc, char **argv)
+{
+  GOptionContext *context;
+  GError *error = NULL;
+
+  context = g_option_context_new("- UI main loop stalls during call storms");
+  g_option_context_add_main_entries(context, entries, NULL);
+
+  if (!g_option_context_parse(context, &argc, &argv, &error))
+  {
+    g_printerr("%s\n", error->message);
+    g_error_free(error);
+    g_option_context_free(context);
+
+    return EXIT_FAILURE;
+  }
+
+  g_option_context_free(context);
+
+  bench_stall(FALSE);
+  bench_stall(TRUE);
+
+  return EXIT_SUCCESS;
+}
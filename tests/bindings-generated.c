@@ -0,0 +1,41 @@
+/*
+ * bindings-generated.c
+ *
+ * Copyright (C) 2024 Ivaylo Dimitrov <ivo.g.dimitrov.75@gmail.com>
+ *
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "config.h"
+
+#include <gmodule.h>
+
+#include "org.ofono.Manager.h"
+#include "org.ofono.Modem.h"
+#include "org.ofono.VoiceCall.h"
+#include "org.ofono.VoiceCallManager.h"
+
+/* the gdbus-codegen wrappers the plugin used to link in, for bench-bindings */
+
+/* registers the types the plugin registered on startup, a proxy per
+ * interface
+ */
+G_MODULE_EXPORT void
+nui_bindings_init(void)
+{
+  g_type_ensure(nui_ofono_manager_proxy_get_type());
+  g_type_ensure(nui_ofono_modem_proxy_get_type());
+  g_type_ensure(nui_ofono_voice_call_manager_proxy_get_type());
+  g_type_ensure(nui_ofono_voice_call_proxy_get_type());
+}
@@ -0,0 +1,31 @@
+/*
+ * bindings-lean.c
+ *
+ * Copyright (C) 2024 Ivaylo Dimitrov <ivo.g.dimitrov.75@gmail.com>
+ *
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+/* the bindings the plugin links in now, built on their own for
+ * bench-bindings
+ */
+#include "nui-ofono.c"
+
+#include <gmodule.h>
+
+/* nothing to register */
+G_MODULE_EXPORT void
+nui_bindings_init(void)
+{
+}
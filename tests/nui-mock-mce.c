@@ -0,0 +1,133 @@
+/*
+ * nui-mock-mce.c
+ *
+ * Copyright (C) 2024 Ivaylo Dimitrov <ivo.g.dimitrov.75@gmail.com>
+ *
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "config.h"
+
+#include <gio/gio.h>
+
+#include "nui-mock-mce.h"
+
+#define MCE_SERVICE "com.nokia.mce"
+#define MCE_REQUEST_PATH "/com/nokia/mce/request"
+#define MCE_REQUEST_IF "com.nokia.mce.request"
+#define MCE_SIGNAL_PATH "/com/nokia/mce/signal"
+#define MCE_SIGNAL_IF "com.nokia.mce.signal"
+
+static const gchar introspection_xml[] =
+  "<node>"
+  "  <interface name='" MCE_REQUEST_IF "'>"
+  "    <method name='get_display_status'>"
+  "      <arg name='status' type='s' direction='out'/>"
+  "    </method>"
+  "  </interface>"
+  "</node>";
+
+struct _NuiMockMce
+{
+  GDBusConnection *connection;
+  guint object_id;
+  gchar *status;
+  guint requests;
+};
+
+static void
+_method_call(GDBusConnection *connection, const gchar *sender,
+             const gchar *path, const gchar *interface_name,
+             const gchar *method, GVariant *parameters,
+             GDBusMethodInvocation *invocation, gpointer user_data)
+{
+  NuiMockMce *mock = user_data;
+
+  mock->requests++;
+  g_dbus_method_invocation_return_value(invocation,
+                                        g_variant_new("(s)", mock->status));
+}
+
+static const GDBusInterfaceVTable vtable =
+{
+  _method_call,
+  NULL,
+  NULL
+};
+
+NuiMockMce *
+nui_mock_mce_new(const gchar *address, const gchar *status)
+{
+  NuiMockMce *mock = g_slice_new0(NuiMockMce);
+  GDBusNodeInfo *info;
+  GError *error = NULL;
+  GVariant *reply;
+
+  mock->status = g_strdup(status);
+  mock->connection = g_dbus_connection_new_for_address_sync(
+        address,
+        G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT |
+        G_DBUS_CONNECTION_FLAGS_MESSAGE_BUS_CONNECTION,
+        NULL, NULL, &error);
+  g_assert_no_error(error);
+
+  info = g_dbus_node_info_new_for_xml(introspection_xml, &error);
+  g_assert_no_error(error);
+
+  mock->object_id = g_dbus_connection_register_object(
+        mock->connection, MCE_REQUEST_PATH,
+        g_dbus_node_info_lookup_interface(info, MCE_REQUEST_IF),
+        &vtable, mock, NULL, &error);
+  g_assert_no_error(error);
+  g_dbus_node_info_unref(info);
+
+  /* DBUS_NAME_FLAG_DO_NOT_QUEUE */
+  reply = g_dbus_connection_call_sync(
+        mock->connection, "org.freedesktop.DBus", "/org/freedesktop/DBus",
+        "org.freedesktop.DBus", "RequestName",
+        g_variant_new("(su)", MCE_SERVICE, 4),
+        G_VARIANT_TYPE("(u)"), G_DBUS_CALL_FLAGS_NONE, -1, NULL, &error);
+  g_assert_no_error(error);
+  g_variant_unref(reply);
+
+  return mock;
+}
+
+void
+nui_mock_mce_free(NuiMockMce *mock)
+{
+  g_dbus_connection_unregister_object(mock->connection, mock->object_id);
+  g_dbus_connection_close_sync(mock->connection, NULL, NULL);
+  g_object_unref(mock->connection);
+  g_free(mock->status);
+  g_slice_free(NuiMockMce, mock);
+}
+
+void
+nui_mock_mce_set_display(NuiMockMce *mock, const gchar *status)
+{
+  g_free(mock->status);
+  mock->status = g_strdup(status);
+
+  g_dbus_connection_emit_signal(mock->connection, NULL, MCE_SIGNAL_PATH,
+                                MCE_SIGNAL_IF, "display_status_ind",
+                                g_variant_new("(s)", status), NULL);
+  g_dbus_connection_flush_sync(mock->connection, NULL, NULL);
+}
+
+guint
+nui_mock_mce_get_requests(NuiMockMce *mock)
+{
+  return mock->requests;
+}
@@ -0,0 +1,41 @@
+/*
+ * nui-mock-mce.h
+ *
+ * Copyright (C) 2024 Ivaylo Dimitrov <ivo.g.dimitrov.75@gmail.com>
+ *
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __NUI_MOCK_MCE_H__
+#define __NUI_MOCK_MCE_H__
+
+G_BEGIN_DECLS
+
+typedef struct _NuiMockMce NuiMockMce;
+
+/* serves the MCE display status on its own connection to the bus at
+ * address, status is "on", "dimmed" or "off"
+ */
+NuiMockMce *nui_mock_mce_new(const gchar *address, const gchar *status);
+void nui_mock_mce_free(NuiMockMce *mock);
+
+/* emits display_status_ind */
+void nui_mock_mce_set_display(NuiMockMce *mock, const gchar *status);
+
+/* get_display_status calls answered so far */
+guint nui_mock_mce_get_requests(NuiMockMce *mock);
+
+G_END_DECLS
+
+#endif /* __NUI_MOCK_MCE_H__ */
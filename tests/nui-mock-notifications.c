@@ -0,0 +1,227 @@
+/*
+ * nui-mock-notifications.c
+ *
+ * Copyright (C) 2024 Ivaylo Dimitrov <ivo.g.dimitrov.75@gmail.com>
+ *
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "config.h"
+
+#include <gio/gio.h>
+
+#include "nui-mock-notifications.h"
+
+#define NOTIFICATIONS_SERVICE "org.freedesktop.Notifications"
+#define NOTIFICATIONS_PATH "/org/freedesktop/Notifications"
+#define NOTIFICATIONS_INTERFACE_NAME "org.freedesktop.Notifications"
+
+/* NotificationClosed reasons */
+#define NOTIFICATION_DISMISSED 2
+#define NOTIFICATION_CLOSED 3
+
+static const gchar introspection_xml[] =
+  "<node>"
+  "  <interface name='" NOTIFICATIONS_INTERFACE_NAME "'>"
+  "    <method name='Notify'>"
+  "      <arg name='app_name' type='s' direction='in'/>"
+  "      <arg name='replaces_id' type='u' direction='in'/>"
+  "      <arg name='app_icon' type='s' direction='in'/>"
+  "      <arg name='summary' type='s' direction='in'/>"
+  "      <arg name='body' type='s' direction='in'/>"
+  "      <arg name='actions' type='as' direction='in'/>"
+  "      <arg name='hints' type='a{sv}' direction='in'/>"
+  "      <arg name='expire_timeout' type='i' direction='in'/>"
+  "      <arg name='id' type='u' direction='out'/>"
+  "    </method>"
+  "    <method name='CloseNotification'>"
+  "      <arg name='id' type='u' direction='in'/>"
+  "    </method>"
+  "    <signal name='NotificationClosed'>"
+  "      <arg name='id' type='u'/>"
+  "      <arg name='reason' type='u'/>"
+  "    </signal>"
+  "  </interface>"
+  "</node>";
+
+struct _NuiMockNotifications
+{
+  GDBusConnection *connection;
+  guint object_id;
+  guint32 next_id;
+  /* id to body of the shown notifications */
+  GHashTable *shown;
+  guint created;
+  guint updated;
+  gint64 last_notify;
+};
+
+static void
+_closed_emit(NuiMockNotifications *mock, guint32 id, guint32 reason)
+{
+  g_dbus_connection_emit_signal(mock->connection, NULL, NOTIFICATIONS_PATH,
+                                NOTIFICATIONS_INTERFACE_NAME,
+                                "NotificationClosed",
+                                g_variant_new("(uu)", id, reason), NULL);
+}
+
+static void
+_method_call(GDBusConnection *connection, const gchar *sender,
+             const gchar *path, const gchar *interface_name,
+             const gchar *method, GVariant *parameters,
+             GDBusMethodInvocation *invocation, gpointer user_data)
+{
+  NuiMockNotifications *mock = user_data;
+
+  if (!g_strcmp0(method, "Notify"))
+  {
+    const gchar *body;
+    guint32 id;
+
+    g_variant_get(parameters, "(&su&s&s&s^a&s@a{sv}i)", NULL, &id, NULL,
+                  NULL, &body, NULL, NULL, NULL);
+
+    if (id && g_hash_table_contains(mock->shown, GUINT_TO_POINTER(id)))
+      mock->updated++;
+    else
+    {
+      id = ++mock->next_id;
+      mock->created++;
+    }
+
+    g_hash_table_insert(mock->shown, GUINT_TO_POINTER(id), g_strdup(body));
+    mock->last_notify = g_get_monotonic_time();
+    g_dbus_method_invocation_return_value(invocation,
+                                          g_variant_new("(u)", id));
+  }
+  else
+  {
+    guint32 id;
+
+    g_variant_get(parameters, "(u)", &id);
+
+    if (g_hash_table_remove(mock->shown, GUINT_TO_POINTER(id)))
+      _closed_emit(mock, id, NOTIFICATION_CLOSED);
+
+    g_dbus_method_invocation_return_value(invocation, NULL);
+  }
+}
+
+static const GDBusInterfaceVTable vtable =
+{
+  _method_call,
+  NULL,
+  NULL
+};
+
+NuiMockNotifications *
+nui_mock_notifications_new(const gchar *address)
+{
+  NuiMockNotifications *mock = g_slice_new0(NuiMockNotifications);
+  GDBusNodeInfo *info;
+  GError *error = NULL;
+  GVariant *reply;
+
+  mock->connection = g_dbus_connection_new_for_address_sync(
+        address,
+        G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT |
+        G_DBUS_CONNECTION_FLAGS_MESSAGE_BUS_CONNECTION,
+        NULL, NULL, &error);
+  g_assert_no_error(error);
+
+  info = g_dbus_node_info_new_for_xml(introspection_xml, &error);
+  g_assert_no_error(error);
+
+  mock->shown = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL,
+                                      g_free);
+  mock->object_id = g_dbus_connection_register_object(
+        mock->connection, NOTIFICATIONS_PATH,
+        g_dbus_node_info_lookup_interface(info, NOTIFICATIONS_INTERFACE_NAME),
+        &vtable, mock, NULL, &error);
+  g_assert_no_error(error);
+  g_dbus_node_info_unref(info);
+
+  /* DBUS_NAME_FLAG_DO_NOT_QUEUE */
+  reply = g_dbus_connection_call_sync(
+        mock->connection, "org.freedesktop.DBus", "/org/freedesktop/DBus",
+        "org.freedesktop.DBus", "RequestName",
+        g_variant_new("(su)", NOTIFICATIONS_SERVICE, 4),
+        G_VARIANT_TYPE("(u)"), G_DBUS_CALL_FLAGS_NONE, -1, NULL, &error);
+  g_assert_no_error(error);
+  g_variant_unref(reply);
+
+  return mock;
+}
+
+void
+nui_mock_notifications_free(NuiMockNotifications *mock)
+{
+  g_dbus_connection_unregister_object(mock->connection, mock->object_id);
+  g_dbus_connection_close_sync(mock->connection, NULL, NULL);
+  g_object_unref(mock->connection);
+  g_hash_table_unref(mock->shown);
+  g_slice_free(NuiMockNotifications, mock);
+}
+
+guint
+nui_mock_notifications_get_created(NuiMockNotifications *mock)
+{
+  return mock->created;
+}
+
+guint
+nui_mock_notifications_get_updated(NuiMockNotifications *mock)
+{
+  return mock->updated;
+}
+
+gint64
+nui_mock_notifications_get_last_notify(NuiMockNotifications *mock)
+{
+  return mock->last_notify;
+}
+
+const gchar *
+nui_mock_notifications_get_body(NuiMockNotifications *mock, guint32 id)
+{
+  return g_hash_table_lookup(mock->shown, GUINT_TO_POINTER(id));
+}
+
+guint32 *
+nui_mock_notifications_dup_ids(NuiMockNotifications *mock, guint *n_ids)
+{
+  guint32 *ids = g_new(guint32, g_hash_table_size(mock->shown) + 1);
+  GHashTableIter iter;
+  gpointer id;
+  guint n = 0;
+
+  g_hash_table_iter_init(&iter, mock->shown);
+
+  while (g_hash_table_iter_next(&iter, &id, NULL))
+    ids[n++] = GPOINTER_TO_UINT(id);
+
+  *n_ids = n;
+
+  return ids;
+}
+
+void
+nui_mock_notifications_close(NuiMockNotifications *mock, guint32 id)
+{
+  if (g_hash_table_remove(mock->shown, GUINT_TO_POINTER(id)))
+  {
+    _closed_emit(mock, id, NOTIFICATION_DISMISSED);
+    g_dbus_connection_flush_sync(mock->connection, NULL, NULL);
+  }
+}
@@ -0,0 +1,54 @@
+/*
+ * nui-mock-notifications.h
+ *
+ * Copyright (C) 2024 Ivaylo Dimitrov <ivo.g.dimitrov.75@gmail.com>
+ *
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __NUI_MOCK_NOTIFICATIONS_H__
+#define __NUI_MOCK_NOTIFICATIONS_H__
+
+G_BEGIN_DECLS
+
+typedef struct _NuiMockNotifications NuiMockNotifications;
+
+/* serves org.freedesktop.Notifications on its own connection to the bus at
+ * address, Notify is answered in the thread-default main context of the
+ * caller of nui_mock_notifications_new()
+ */
+NuiMockNotifications *nui_mock_notifications_new(const gchar *address);
+void nui_mock_notifications_free(NuiMockNotifications *mock);
+
+/* Notify calls with replaces_id 0 and with the id of a shown notification */
+guint nui_mock_notifications_get_created(NuiMockNotifications *mock);
+guint nui_mock_notifications_get_updated(NuiMockNotifications *mock);
+
+/* monotonic time of the last Notify, 0 if there was none */
+gint64 nui_mock_notifications_get_last_notify(NuiMockNotifications *mock);
+
+/* body of the shown notification id, NULL if there is no such */
+const gchar *nui_mock_notifications_get_body(NuiMockNotifications *mock,
+                                             guint32 id);
+
+/* ids of the shown notifications, free with g_free() */
+guint32 *nui_mock_notifications_dup_ids(NuiMockNotifications *mock,
+                                        guint *n_ids);
+
+/* the user dismissed notification id, NotificationClosed with reason 2 */
+void nui_mock_notifications_close(NuiMockNotifications *mock, guint32 id);
+
+G_END_DECLS
+
+#endif /* __NUI_MOCK_NOTIFICATIONS_H__ */
@@ -0,0 +1,658 @@
+/*
+ * nui-mock-ofono.c
+ *
+ * Copyright (C) 2024 Ivaylo Dimitrov <ivo.g.dimitrov.75@gmail.com>
+ *
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "config.h"
+
+#include <gio/gio.h>
+
+#include <string.h>
+
+#include "nui-mock-ofono.h"
+
+#define OFONO_SERVICE "org.ofono"
+#define OFONO_ERROR_FAILED "org.ofono.Error.Failed"
+#define OFONO_ERROR_NOT_IMPLEMENTED "org.ofono.Error.NotImplemented"
+
+enum
+{
+  OFONO_IFACE_MANAGER,
+  OFONO_IFACE_MODEM,
+  OFONO_IFACE_VOICECALL_MANAGER,
+  OFONO_IFACE_VOICECALL,
+  OFONO_IFACE_LAST
+};
+
+/* introspection data comes from org.ofono.<name>.xml */
+static const gchar *interface_names[OFONO_IFACE_LAST] =
+{
+  "org.ofono.Manager",
+  "org.ofono.Modem",
+  "org.ofono.VoiceCallManager",
+  "org.ofono.VoiceCall"
+};
+
+#define IFACE(i) interface_names[OFONO_IFACE_##i]
+
+/* only signals are sent on it, no object is needed */
+#define MESSAGE_MANAGER_INTERFACE_NAME "org.ofono.MessageManager"
+
+typedef struct
+{
+  gchar *path;
+  gboolean voice;
+  /* MockCall, in the order they were added */
+  GPtrArray *calls;
+  guint next_call;
+  guint modem_id;
+  guint vcm_id;
+} MockModem;
+
+typedef struct
+{
+  MockModem *modem;
+  gchar *path;
+  gchar *state;
+  guint id;
+} MockCall;
+
+struct _NuiMockOfono
+{
+  GDBusConnection *connection;
+  GDBusNodeInfo *info[OFONO_IFACE_LAST];
+  guint manager_id;
+  gboolean running;
+  GMutex lock;
+  /* MockModem, in the order they were added */
+  GPtrArray *modems;
+  /* call path to MockCall */
+  GHashTable *calls;
+  /* names of the methods that fail */
+  GHashTable *failing;
+};
+
+static GDBusNodeInfo *
+_node_info_load(const gchar *interface_name)
+{
+  GDBusNodeInfo *info;
+  GError *error = NULL;
+  gchar *filename;
+  gchar *name;
+  gchar *xml;
+
+  name = g_strconcat(interface_name, ".xml", NULL);
+  filename = g_build_filename(NUI_TEST_SRCDIR, name, NULL);
+
+  g_file_get_contents(filename, &xml, NULL, &error);
+  g_assert_no_error(error);
+
+  info = g_dbus_node_info_new_for_xml(xml, &error);
+  g_assert_no_error(error);
+
+  g_free(xml);
+  g_free(filename);
+  g_free(name);
+
+  return info;
+}
+
+static void
+_emit(NuiMockOfono *mock, const gchar *path, const gchar *interface_name,
+      const gchar *signal_name, GVariant *parameters)
+{
+  GError *error = NULL;
+
+  if (!g_dbus_connection_emit_signal(mock->connection, NULL, path,
+                                     interface_name, signal_name, parameters,
+                                     &error))
+  {
+    g_warning("Unable to emit %s.%s [%s]", interface_name, signal_name,
+              error->message);
+    g_error_free(error);
+  }
+}
+
+static MockModem *
+_modem_find(NuiMockOfono *mock, const gchar *path)
+{
+  guint i;
+
+  for (i = 0; i < mock->modems->len; i++)
+  {
+    MockModem *modem = g_ptr_array_index(mock->modems, i);
+
+    if (!strcmp(modem->path, path))
+      return modem;
+  }
+
+  return NULL;
+}
+
+static GVariant *
+_modem_interfaces(MockModem *modem)
+{
+  GVariantBuilder builder;
+
+  g_variant_builder_init(&builder, G_VARIANT_TYPE_STRING_ARRAY);
+  g_variant_builder_add(&builder, "s", MESSAGE_MANAGER_INTERFACE_NAME);
+
+  if (modem->voice)
+    g_variant_builder_add(&builder, "s", IFACE(VOICECALL_MANAGER));
+
+  return g_variant_builder_end(&builder);
+}
+
+static GVariant *
+_modem_properties(MockModem *modem)
+{
+  GVariantBuilder builder;
+
+  g_variant_builder_init(&builder, G_VARIANT_TYPE_VARDICT);
+  g_variant_builder_add(&builder, "{sv}", "Powered",
+                        g_variant_new_boolean(TRUE));
+  g_variant_builder_add(&builder, "{sv}", "Online",
+                        g_variant_new_boolean(TRUE));
+  g_variant_builder_add(&builder, "{sv}", "Serial",
+                        g_variant_new_string("004999010640000"));
+  g_variant_builder_add(&builder, "{sv}", "Interfaces",
+                        _modem_interfaces(modem));
+
+  return g_variant_builder_end(&builder);
+}
+
+static GVariant *
+_call_properties(MockCall *call)
+{
+  GVariantBuilder builder;
+
+  g_variant_builder_init(&builder, G_VARIANT_TYPE_VARDICT);
+  g_variant_builder_add(&builder, "{sv}", "State",
+                        g_variant_new_string(call->state));
+  g_variant_builder_add(&builder, "{sv}", "LineIdentification",
+                        g_variant_new_string("+15550100"));
+  g_variant_builder_add(&builder, "{sv}", "Multiparty",
+                        g_variant_new_boolean(FALSE));
+
+  return g_variant_builder_end(&builder);
+}
+
+static GVariant *
+_modems_get(NuiMockOfono *mock)
+{
+  GVariantBuilder builder;
+  guint i;
+
+  g_variant_builder_init(&builder, G_VARIANT_TYPE("a(oa{sv})"));
+
+  for (i = 0; i < mock->modems->len; i++)
+  {
+    MockModem *modem = g_ptr_array_index(mock->modems, i);
+
+    g_variant_builder_add(&builder, "(o@a{sv})", modem->path,
+                          _modem_properties(modem));
+  }
+
+  return g_variant_new("(@a(oa{sv}))", g_variant_builder_end(&builder));
+}
+
+static GVariant *
+_calls_get(MockModem *modem)
+{
+  GVariantBuilder builder;
+  guint i;
+
+  g_variant_builder_init(&builder, G_VARIANT_TYPE("a(oa{sv})"));
+
+  for (i = 0; i < modem->calls->len; i++)
+  {
+    MockCall *call = g_ptr_array_index(modem->calls, i);
+
+    g_variant_builder_add(&builder, "(o@a{sv})", call->path,
+                          _call_properties(call));
+  }
+
+  return g_variant_new("(@a(oa{sv}))", g_variant_builder_end(&builder));
+}
+
+static void
+_method_call(GDBusConnection *connection, const gchar *sender,
+             const gchar *path, const gchar *interface_name,
+             const gchar *method, GVariant *parameters,
+             GDBusMethodInvocation *invocation, gpointer user_data)
+{
+  NuiMockOfono *mock = user_data;
+  GVariant *reply = NULL;
+  gboolean failing;
+
+  g_mutex_lock(&mock->lock);
+
+  failing = g_hash_table_contains(mock->failing, method);
+
+  if (failing)
+    ;
+  else if (!strcmp(interface_name, IFACE(MANAGER)))
+  {
+    if (!strcmp(method, "GetModems"))
+      reply = _modems_get(mock);
+  }
+  else if (!strcmp(interface_name, IFACE(MODEM)))
+  {
+    MockModem *modem = _modem_find(mock, path);
+
+    if (modem && !strcmp(method, "GetProperties"))
+      reply = g_variant_new("(@a{sv})", _modem_properties(modem));
+  }
+  else if (!strcmp(interface_name, IFACE(VOICECALL_MANAGER)))
+  {
+    MockModem *modem = _modem_find(mock, path);
+
+    if (modem && modem->voice && !strcmp(method, "GetCalls"))
+      reply = _calls_get(modem);
+  }
+  else if (!strcmp(interface_name, IFACE(VOICECALL)))
+  {
+    MockCall *call = g_hash_table_lookup(mock->calls, path);
+
+    if (call && !strcmp(method, "GetProperties"))
+      reply = g_variant_new("(@a{sv})", _call_properties(call));
+  }
+
+  g_mutex_unlock(&mock->lock);
+
+  if (reply)
+    g_dbus_method_invocation_return_value(invocation, reply);
+  else if (failing)
+  {
+    g_dbus_method_invocation_return_dbus_error(
+          invocation, OFONO_ERROR_FAILED, "Operation failed");
+  }
+  else
+  {
+    g_dbus_method_invocation_return_dbus_error(
+          invocation, OFONO_ERROR_NOT_IMPLEMENTED, "Implementation not provided");
+  }
+}
+
+static const GDBusInterfaceVTable vtable =
+{
+  _method_call,
+  NULL,
+  NULL
+};
+
+static guint
+_object_register(NuiMockOfono *mock, const gchar *path, int iface)
+{
+  GError *error = NULL;
+  guint id;
+
+  id = g_dbus_connection_register_object(
+        mock->connection, path,
+        g_dbus_node_info_lookup_interface(mock->info[iface],
+                                          interface_names[iface]),
+        &vtable, mock, NULL, &error);
+  g_assert_no_error(error);
+
+  return id;
+}
+
+static void
+_call_free(NuiMockOfono *mock, MockCall *call)
+{
+  g_dbus_connection_unregister_object(mock->connection, call->id);
+  g_hash_table_remove(mock->calls, call->path);
+  g_free(call->path);
+  g_free(call->state);
+  g_slice_free(MockCall, call);
+}
+
+static void
+_modem_free(NuiMockOfono *mock, MockModem *modem)
+{
+  guint i;
+
+  for (i = 0; i < modem->calls->len; i++)
+    _call_free(mock, g_ptr_array_index(modem->calls, i));
+
+  g_ptr_array_free(modem->calls, TRUE);
+  g_dbus_connection_unregister_object(mock->connection, modem->modem_id);
+  g_dbus_connection_unregister_object(mock->connection, modem->vcm_id);
+  g_free(modem->path);
+  g_slice_free(MockModem, modem);
+}
+
+static void
+_name_call(NuiMockOfono *mock, const gchar *method, GVariant *parameters,
+           guint32 expected)
+{
+  GError *error = NULL;
+  GVariant *reply;
+  guint32 result;
+
+  reply = g_dbus_connection_call_sync(
+        mock->connection, "org.freedesktop.DBus", "/org/freedesktop/DBus",
+        "org.freedesktop.DBus", method, parameters, G_VARIANT_TYPE("(u)"),
+        G_DBUS_CALL_FLAGS_NONE, -1, NULL, &error);
+  g_assert_no_error(error);
+
+  g_variant_get(reply, "(u)", &result);
+  g_assert_cmpuint(result, ==, expected);
+  g_variant_unref(reply);
+}
+
+NuiMockOfono *
+nui_mock_ofono_new(const gchar *address)
+{
+  NuiMockOfono *mock = g_slice_new0(NuiMockOfono);
+  GError *error = NULL;
+  int i;
+
+  mock->connection = g_dbus_connection_new_for_address_sync(
+        address,
+        G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT |
+        G_DBUS_CONNECTION_FLAGS_MESSAGE_BUS_CONNECTION,
+        NULL, NULL, &error);
+  g_assert_no_error(error);
+
+  for (i = 0; i < OFONO_IFACE_LAST; i++)
+    mock->info[i] = _node_info_load(interface_names[i]);
+
+  g_mutex_init(&mock->lock);
+  mock->modems = g_ptr_array_new();
+  mock->calls = g_hash_table_new(g_str_hash, g_str_equal);
+  mock->failing = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                        NULL);
+  mock->manager_id = _object_register(mock, "/", OFONO_IFACE_MANAGER);
+
+  nui_mock_ofono_set_running(mock, TRUE);
+
+  return mock;
+}
+
+void
+nui_mock_ofono_free(NuiMockOfono *mock)
+{
+  guint i;
+
+  nui_mock_ofono_set_running(mock, FALSE);
+
+  for (i = 0; i < mock->modems->len; i++)
+    _modem_free(mock, g_ptr_array_index(mock->modems, i));
+
+  g_ptr_array_free(mock->modems, TRUE);
+  g_hash_table_unref(mock->calls);
+  g_hash_table_unref(mock->failing);
+  g_dbus_connection_unregister_object(mock->connection, mock->manager_id);
+
+  for (i = 0; i < OFONO_IFACE_LAST; i++)
+    g_dbus_node_info_unref(mock->info[i]);
+
+  g_dbus_connection_close_sync(mock->connection, NULL, NULL);
+  g_object_unref(mock->connection);
+  g_mutex_clear(&mock->lock);
+  g_slice_free(NuiMockOfono, mock);
+}
+
+void
+nui_mock_ofono_set_running(NuiMockOfono *mock, gboolean running)
+{
+  if (running == mock->running)
+    return;
+
+  mock->running = running;
+
+  /* DBUS_NAME_FLAG_DO_NOT_QUEUE, primary owner; released */
+  if (running)
+    _name_call(mock, "RequestName", g_variant_new("(su)", OFONO_SERVICE, 4), 1);
+  else
+    _name_call(mock, "ReleaseName", g_variant_new("(s)", OFONO_SERVICE), 1);
+}
+
+void
+nui_mock_ofono_set_failing(NuiMockOfono *mock, const gchar *method,
+                           gboolean fail)
+{
+  g_mutex_lock(&mock->lock);
+
+  if (fail)
+    g_hash_table_add(mock->failing, g_strdup(method));
+  else
+    g_hash_table_remove(mock->failing, method);
+
+  g_mutex_unlock(&mock->lock);
+}
+
+void
+nui_mock_ofono_add_modem(NuiMockOfono *mock, const gchar *path,
+                         gboolean voice)
+{
+  MockModem *modem = g_slice_new0(MockModem);
+
+  modem->path = g_strdup(path);
+  modem->voice = voice;
+  modem->calls = g_ptr_array_new();
+  modem->modem_id = _object_register(mock, path, OFONO_IFACE_MODEM);
+  modem->vcm_id = _object_register(mock, path,
+                                   OFONO_IFACE_VOICECALL_MANAGER);
+
+  g_mutex_lock(&mock->lock);
+  g_assert(_modem_find(mock, path) == NULL);
+  g_ptr_array_add(mock->modems, modem);
+  _emit(mock, "/", IFACE(MANAGER), "ModemAdded",
+        g_variant_new("(o@a{sv})", path, _modem_properties(modem)));
+  g_mutex_unlock(&mock->lock);
+}
+
+void
+nui_mock_ofono_remove_modem(NuiMockOfono *mock, const gchar *path)
+{
+  MockModem *modem;
+
+  g_mutex_lock(&mock->lock);
+
+  modem = _modem_find(mock, path);
+  g_assert(modem != NULL);
+
+  g_ptr_array_remove(mock->modems, modem);
+  _emit(mock, "/", IFACE(MANAGER), "ModemRemoved",
+        g_variant_new("(o)", path));
+  _modem_free(mock, modem);
+
+  g_mutex_unlock(&mock->lock);
+}
+
+void
+nui_mock_ofono_set_voice(NuiMockOfono *mock, const gchar *path,
+                         gboolean voice)
+{
+  MockModem *modem;
+
+  g_mutex_lock(&mock->lock);
+
+  modem = _modem_find(mock, path);
+  g_assert(modem != NULL);
+
+  if (modem->voice != voice)
+  {
+    modem->voice = voice;
+    _emit(mock, modem->path, IFACE(MODEM), "PropertyChanged",
+          g_variant_new("(sv)", "Interfaces", _modem_interfaces(modem)));
+  }
+
+  g_mutex_unlock(&mock->lock);
+}
+
+const gchar *
+nui_mock_ofono_add_call(NuiMockOfono *mock, const gchar *modem_path,
+                        const gchar *state)
+{
+  MockModem *modem;
+  MockCall *call;
+
+  g_mutex_lock(&mock->lock);
+
+  modem = _modem_find(mock, modem_path);
+  g_assert(modem != NULL);
+
+  call = g_slice_new0(MockCall);
+  call->modem = modem;
+  call->path = g_strdup_printf("%s/voicecall%02u", modem->path,
+                               ++modem->next_call);
+  call->state = g_strdup(state);
+  call->id = _object_register(mock, call->path, OFONO_IFACE_VOICECALL);
+  g_ptr_array_add(modem->calls, call);
+  g_hash_table_insert(mock->calls, call->path, call);
+
+  if (modem->voice)
+  {
+    _emit(mock, modem->path, IFACE(VOICECALL_MANAGER), "CallAdded",
+          g_variant_new("(o@a{sv})", call->path, _call_properties(call)));
+  }
+
+  g_mutex_unlock(&mock->lock);
+
+  return call->path;
+}
+
+void
+nui_mock_ofono_set_call_state(NuiMockOfono *mock, const gchar *path,
+                              const gchar *state)
+{
+  MockCall *call;
+
+  g_mutex_lock(&mock->lock);
+
+  call = g_hash_table_lookup(mock->calls, path);
+  g_assert(call != NULL);
+
+  g_free(call->state);
+  call->state = g_strdup(state);
+  _emit(mock, call->path, IFACE(VOICECALL), "PropertyChanged",
+        g_variant_new("(sv)", "State", g_variant_new_string(state)));
+
+  g_mutex_unlock(&mock->lock);
+}
+
+void
+nui_mock_ofono_remove_call(NuiMockOfono *mock, const gchar *path)
+{
+  MockCall *call;
+
+  g_mutex_lock(&mock->lock);
+
+  call = g_hash_table_lookup(mock->calls, path);
+  g_assert(call != NULL);
+
+  g_ptr_array_remove(call->modem->calls, call);
+
+  if (call->modem->voice)
+  {
+    _emit(mock, call->modem->path, IFACE(VOICECALL_MANAGER), "CallRemoved",
+          g_variant_new("(o)", call->path));
+  }
+
+  _call_free(mock, call);
+
+  g_mutex_unlock(&mock->lock);
+}
+
+void
+nui_mock_ofono_send_message(NuiMockOfono *mock, const gchar *modem_path,
+                            const gchar *sender, const gchar *text,
+                            gboolean immediate)
+{
+  GVariantBuilder info;
+  GDateTime *now = g_date_time_new_now_local();
+  gchar *time = g_date_time_format(now, "%Y-%m-%dT%H:%M:%S%z");
+
+  g_variant_builder_init(&info, G_VARIANT_TYPE_VARDICT);
+
+  if (sender)
+  {
+    g_variant_builder_add(&info, "{sv}", "Sender",
+                          g_variant_new_string(sender));
+  }
+
+  g_variant_builder_add(&info, "{sv}", "SentTime", g_variant_new_string(time));
+  g_variant_builder_add(&info, "{sv}", "LocalSentTime",
+                        g_variant_new_string(time));
+
+  g_mutex_lock(&mock->lock);
+  g_assert(_modem_find(mock, modem_path) != NULL);
+  _emit(mock, modem_path, MESSAGE_MANAGER_INTERFACE_NAME,
+        immediate ? "ImmediateMessage" : "IncomingMessage",
+        g_variant_new("(s@a{sv})", text, g_variant_builder_end(&info)));
+  g_mutex_unlock(&mock->lock);
+
+  g_free(time);
+  g_date_time_unref(now);
+}
+
+gchar **
+nui_mock_ofono_dup_calls(NuiMockOfono *mock)
+{
+  GPtrArray *paths = g_ptr_array_new();
+  guint i;
+  guint j;
+
+  g_mutex_lock(&mock->lock);
+
+  for (i = 0; i < mock->modems->len; i++)
+  {
+    MockModem *modem = g_ptr_array_index(mock->modems, i);
+
+    for (j = 0; j < modem->calls->len; j++)
+    {
+      MockCall *call = g_ptr_array_index(modem->calls, j);
+
+      g_ptr_array_add(paths, g_strdup(call->path));
+    }
+  }
+
+  g_mutex_unlock(&mock->lock);
+
+  g_ptr_array_add(paths, NULL);
+
+  return (gchar **)g_ptr_array_free(paths, FALSE);
+}
+
+void
+nui_mock_ofono_populate(NuiMockOfono *mock, guint modems, guint calls,
+                        const gchar *state)
+{
+  guint i;
+  guint j;
+
+  for (i = 0; i < modems; i++)
+  {
+    gchar *path = g_strdup_printf("/mock_%u", i);
+
+    nui_mock_ofono_add_modem(mock, path, TRUE);
+
+    for (j = 0; j < calls; j++)
+      nui_mock_ofono_add_call(mock, path, state);
+
+    g_free(path);
+  }
+}
+
+void
+nui_mock_ofono_flush(NuiMockOfono *mock)
+{
+  g_dbus_connection_flush_sync(mock->connection, NULL, NULL);
+}
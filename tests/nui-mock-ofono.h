@@ -0,0 +1,80 @@
+/*
+ * nui-mock-ofono.h
+ *
+ * Copyright (C) 2024 Ivaylo Dimitrov <ivo.g.dimitrov.75@gmail.com>
+ *
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __NUI_MOCK_OFONO_H__
+#define __NUI_MOCK_OFONO_H__
+
+G_BEGIN_DECLS
+
+typedef struct _NuiMockOfono NuiMockOfono;
+
+/* serves the org.ofono.*.xml interfaces as org.ofono on its own connection
+ * to the bus at address. signals are sent as soon as the state changes,
+ * method calls are answered in the thread-default main context of whoever
+ * added the object. all the functions can be called from any thread.
+ */
+NuiMockOfono *nui_mock_ofono_new(const gchar *address);
+void nui_mock_ofono_free(NuiMockOfono *mock);
+
+/* releasing org.ofono and taking it back is what an oFono restart looks
+ * like, the objects stay
+ */
+void nui_mock_ofono_set_running(NuiMockOfono *mock, gboolean running);
+
+/* method is answered with org.ofono.Error.Failed while fail is set */
+void nui_mock_ofono_set_failing(NuiMockOfono *mock, const gchar *method,
+                                gboolean fail);
+
+void nui_mock_ofono_add_modem(NuiMockOfono *mock, const gchar *path,
+                              gboolean voice);
+/* like oFono, calls of the modem go away without CallRemoved */
+void nui_mock_ofono_remove_modem(NuiMockOfono *mock, const gchar *path);
+/* VoiceCallManager in the modem Interfaces property, calls are kept while
+ * it is not there and reported by GetCalls once it is back
+ */
+void nui_mock_ofono_set_voice(NuiMockOfono *mock, const gchar *path,
+                              gboolean voice);
+
+/* returned path is owned by the mock and valid until the call is removed */
+const gchar *nui_mock_ofono_add_call(NuiMockOfono *mock, const gchar *modem,
+                                     const gchar *state);
+void nui_mock_ofono_set_call_state(NuiMockOfono *mock, const gchar *call,
+                                   const gchar *state);
+void nui_mock_ofono_remove_call(NuiMockOfono *mock, const gchar *call);
+
+/* every modem has a MessageManager, the SMS goes out as IncomingMessage or
+ * as ImmediateMessage for class 0. a NULL sender is left out
+ */
+void nui_mock_ofono_send_message(NuiMockOfono *mock, const gchar *modem,
+                                 const gchar *sender, const gchar *text,
+                                 gboolean immediate);
+
+/* paths of all the calls of all the modems, in the order they were added */
+gchar **nui_mock_ofono_dup_calls(NuiMockOfono *mock);
+
+/* modems /mock_0 to /mock_<modems - 1>, each with calls in state */
+void nui_mock_ofono_populate(NuiMockOfono *mock, guint modems, guint calls,
+                             const gchar *state);
+
+/* returns once everything sent so far is on the bus */
+void nui_mock_ofono_flush(NuiMockOfono *mock);
+
+G_END_DECLS
+
+#endif /* __NUI_MOCK_OFONO_H__ */
@@ -0,0 +1,572 @@
+/*
+ * nui-mock-telepathy.c
+ *
+ * Copyright (C) 2024 Ivaylo Dimitrov <ivo.g.dimitrov.75@gmail.com>
+ *
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "config.h"
+
+#include <telepathy-glib/telepathy-glib.h>
+#include <telepathy-glib/telepathy-glib-dbus.h>
+
+#include "nui-mock-telepathy.h"
+
+#define MOCK_CM "ring"
+#define MOCK_PROTOCOL "tel"
+#define MOCK_ACCOUNT_PATH \
+  TP_ACCOUNT_OBJECT_PATH_BASE MOCK_CM "/" MOCK_PROTOCOL "/mock0"
+#define MOCK_SELF_ID "self"
+
+/* connection */
+
+typedef struct
+{
+  TpBaseConnection parent;
+  TpContactsMixin contacts;
+} NuiMockConnection;
+
+typedef struct
+{
+  TpBaseConnectionClass parent_class;
+  TpContactsMixinClass contacts_class;
+} NuiMockConnectionClass;
+
+G_DEFINE_TYPE_WITH_CODE(
+  NuiMockConnection, nui_mock_connection, TP_TYPE_BASE_CONNECTION,
+  G_IMPLEMENT_INTERFACE(TP_TYPE_SVC_CONNECTION_INTERFACE_CONTACTS,
+                        tp_contacts_mixin_iface_init)
+)
+
+static void
+nui_mock_connection_init(NuiMockConnection *conn)
+{
+}
+
+static void
+_connection_constructed(GObject *object)
+{
+  G_OBJECT_CLASS(nui_mock_connection_parent_class)->constructed(object);
+
+  tp_contacts_mixin_init(object, G_STRUCT_OFFSET(NuiMockConnection,
+                                                 contacts));
+  tp_base_connection_register_with_contacts_mixin(TP_BASE_CONNECTION(object));
+}
+
+static void
+_connection_finalize(GObject *object)
+{
+  tp_contacts_mixin_finalize(object);
+
+  G_OBJECT_CLASS(nui_mock_connection_parent_class)->finalize(object);
+}
+
+static void
+_connection_create_handle_repos(TpBaseConnection *base,
+                                TpHandleRepoIface *repos[TP_NUM_HANDLE_TYPES])
+{
+  repos[TP_HANDLE_TYPE_CONTACT] =
+      tp_dynamic_handle_repo_new(TP_HANDLE_TYPE_CONTACT, NULL, NULL);
+}
+
+static gchar *
+_connection_get_unique_name(TpBaseConnection *base)
+{
+  return g_strdup("mock");
+}
+
+/* channels are made by the test, not requested */
+static GPtrArray *
+_connection_create_channel_managers(TpBaseConnection *base)
+{
+  return g_ptr_array_new();
+}
+
+static gboolean
+_connection_start_connecting(TpBaseConnection *base, GError **error)
+{
+  return TRUE;
+}
+
+static void
+_connection_shut_down(TpBaseConnection *base)
+{
+  tp_base_connection_finish_shutdown(base);
+}
+
+static GPtrArray *
+_connection_get_interfaces(TpBaseConnection *base)
+{
+  GPtrArray *interfaces = TP_BASE_CONNECTION_CLASS(
+        nui_mock_connection_parent_class)->get_interfaces_always_present(base);
+
+  g_ptr_array_add(interfaces, TP_IFACE_CONNECTION_INTERFACE_CONTACTS);
+
+  return interfaces;
+}
+
+static void
+nui_mock_connection_class_init(NuiMockConnectionClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS(klass);
+  TpBaseConnectionClass *base_class = TP_BASE_CONNECTION_CLASS(klass);
+
+  object_class->constructed = _connection_constructed;
+  object_class->finalize = _connection_finalize;
+
+  base_class->create_handle_repos = _connection_create_handle_repos;
+  base_class->get_unique_connection_name = _connection_get_unique_name;
+  base_class->create_channel_managers = _connection_create_channel_managers;
+  base_class->start_connecting = _connection_start_connecting;
+  base_class->shut_down = _connection_shut_down;
+  base_class->get_interfaces_always_present = _connection_get_interfaces;
+
+  tp_contacts_mixin_class_init(object_class,
+                               G_STRUCT_OFFSET(NuiMockConnectionClass,
+                                               contacts_class));
+}
+
+/* text channel, Messages only */
+
+typedef struct
+{
+  TpBaseChannel parent;
+  TpMessageMixin messages;
+} NuiMockTextChannel;
+
+typedef struct
+{
+  TpBaseChannelClass parent_class;
+} NuiMockTextChannelClass;
+
+G_DEFINE_TYPE_WITH_CODE(
+  NuiMockTextChannel, nui_mock_text_channel, TP_TYPE_BASE_CHANNEL,
+  G_IMPLEMENT_INTERFACE(TP_TYPE_SVC_CHANNEL_TYPE_TEXT,
+                        tp_message_mixin_text_iface_init);
+  G_IMPLEMENT_INTERFACE(TP_TYPE_SVC_CHANNEL_INTERFACE_MESSAGES,
+                        tp_message_mixin_messages_iface_init)
+)
+
+static void
+nui_mock_text_channel_init(NuiMockTextChannel *chan)
+{
+}
+
+static void
+_text_constructed(GObject *object)
+{
+  TpBaseChannel *base = TP_BASE_CHANNEL(object);
+
+  G_OBJECT_CLASS(nui_mock_text_channel_parent_class)->constructed(object);
+
+  tp_message_mixin_init(object, G_STRUCT_OFFSET(NuiMockTextChannel, messages),
+                        tp_base_channel_get_connection(base));
+}
+
+static void
+_text_finalize(GObject *object)
+{
+  tp_message_mixin_finalize(object);
+
+  G_OBJECT_CLASS(nui_mock_text_channel_parent_class)->finalize(object);
+}
+
+static void
+_text_close(TpBaseChannel *base)
+{
+  tp_base_channel_destroyed(base);
+}
+
+static GPtrArray *
+_text_get_interfaces(TpBaseChannel *base)
+{
+  GPtrArray *interfaces = TP_BASE_CHANNEL_CLASS(
+        nui_mock_text_channel_parent_class)->get_interfaces(base);
+
+  g_ptr_array_add(interfaces, TP_IFACE_CHANNEL_INTERFACE_MESSAGES);
+
+  return interfaces;
+}
+
+static void
+_text_fill_immutable_properties(TpBaseChannel *base, GHashTable *properties)
+{
+  TP_BASE_CHANNEL_CLASS(
+        nui_mock_text_channel_parent_class)->fill_immutable_properties(
+        base, properties);
+
+  tp_dbus_properties_mixin_fill_properties_hash(
+        G_OBJECT(base), properties,
+        TP_IFACE_CHANNEL_INTERFACE_MESSAGES, "MessagePartSupportFlags",
+        TP_IFACE_CHANNEL_INTERFACE_MESSAGES, "DeliveryReportingSupport",
+        TP_IFACE_CHANNEL_INTERFACE_MESSAGES, "SupportedContentTypes",
+        TP_IFACE_CHANNEL_INTERFACE_MESSAGES, "MessageTypes",
+        NULL);
+}
+
+static void
+nui_mock_text_channel_class_init(NuiMockTextChannelClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS(klass);
+  TpBaseChannelClass *base_class = TP_BASE_CHANNEL_CLASS(klass);
+
+  object_class->constructed = _text_constructed;
+  object_class->finalize = _text_finalize;
+
+  base_class->channel_type = TP_IFACE_CHANNEL_TYPE_TEXT;
+  base_class->target_handle_type = TP_HANDLE_TYPE_CONTACT;
+  base_class->get_interfaces = _text_get_interfaces;
+  base_class->close = _text_close;
+  base_class->fill_immutable_properties = _text_fill_immutable_properties;
+
+  tp_message_mixin_init_dbus_properties(object_class);
+}
+
+/* call channel, the base class has all the properties an observer reads */
+
+typedef struct
+{
+  TpBaseCallChannel parent;
+} NuiMockCallChannel;
+
+typedef struct
+{
+  TpBaseCallChannelClass parent_class;
+} NuiMockCallChannelClass;
+
+G_DEFINE_TYPE(NuiMockCallChannel, nui_mock_call_channel,
+              TP_TYPE_BASE_CALL_CHANNEL)
+
+static void
+nui_mock_call_channel_init(NuiMockCallChannel *chan)
+{
+}
+
+static void
+nui_mock_call_channel_class_init(NuiMockCallChannelClass *klass)
+{
+  TP_BASE_CHANNEL_CLASS(klass)->target_handle_type = TP_HANDLE_TYPE_CONTACT;
+}
+
+/* account, mission control serves it */
+
+static const gchar introspection_xml[] =
+  "<node>"
+  "  <interface name='" TP_IFACE_ACCOUNT "'>"
+  "    <property name='Interfaces' type='as' access='read'/>"
+  "    <property name='DisplayName' type='s' access='read'/>"
+  "    <property name='Icon' type='s' access='read'/>"
+  "    <property name='Valid' type='b' access='read'/>"
+  "    <property name='Enabled' type='b' access='read'/>"
+  "    <property name='Nickname' type='s' access='read'/>"
+  "    <property name='Service' type='s' access='read'/>"
+  "    <property name='Parameters' type='a{sv}' access='read'/>"
+  "    <property name='AutomaticPresence' type='(uss)' access='read'/>"
+  "    <property name='ConnectAutomatically' type='b' access='read'/>"
+  "    <property name='Connection' type='o' access='read'/>"
+  "    <property name='ConnectionStatus' type='u' access='read'/>"
+  "    <property name='ConnectionStatusReason' type='u' access='read'/>"
+  "    <property name='ConnectionError' type='s' access='read'/>"
+  "    <property name='ConnectionErrorDetails' type='a{sv}'"
+  "              access='read'/>"
+  "    <property name='CurrentPresence' type='(uss)' access='read'/>"
+  "    <property name='RequestedPresence' type='(uss)' access='read'/>"
+  "    <property name='NormalizedName' type='s' access='read'/>"
+  "    <property name='HasBeenOnline' type='b' access='read'/>"
+  "  </interface>"
+  "</node>";
+
+struct _NuiMockTelepathy
+{
+  GDBusConnection *connection;
+  guint object_id;
+  TpBaseConnection *conn;
+  /* TpBaseChannel, all the ones ever added */
+  GPtrArray *channels;
+  /* the ones added since the last dispatch */
+  GPtrArray *pending;
+  guint observed;
+};
+
+static GVariant *
+_account_get_property(GDBusConnection *connection, const gchar *sender,
+                      const gchar *path, const gchar *interface_name,
+                      const gchar *property, GError **error,
+                      gpointer user_data)
+{
+  NuiMockTelepathy *mock = user_data;
+
+  if (!g_strcmp0(property, "Interfaces"))
+    return g_variant_new_strv(NULL, 0);
+  else if (!g_strcmp0(property, "DisplayName"))
+    return g_variant_new_string("Mock");
+  else if (!g_strcmp0(property, "Valid") ||
+           !g_strcmp0(property, "Enabled") ||
+           !g_strcmp0(property, "ConnectAutomatically") ||
+           !g_strcmp0(property, "HasBeenOnline"))
+  {
+    return g_variant_new_boolean(TRUE);
+  }
+  else if (!g_strcmp0(property, "Parameters") ||
+           !g_strcmp0(property, "ConnectionErrorDetails"))
+  {
+    return g_variant_new_array(G_VARIANT_TYPE("{sv}"), NULL, 0);
+  }
+  else if (!g_strcmp0(property, "AutomaticPresence") ||
+           !g_strcmp0(property, "CurrentPresence") ||
+           !g_strcmp0(property, "RequestedPresence"))
+  {
+    return g_variant_new("(uss)", TP_CONNECTION_PRESENCE_TYPE_AVAILABLE,
+                         "available", "");
+  }
+  else if (!g_strcmp0(property, "Connection"))
+  {
+    return g_variant_new_object_path(
+          tp_base_connection_get_object_path(mock->conn));
+  }
+  else if (!g_strcmp0(property, "ConnectionStatus"))
+    return g_variant_new_uint32(TP_CONNECTION_STATUS_CONNECTED);
+  else if (!g_strcmp0(property, "ConnectionStatusReason"))
+  {
+    return g_variant_new_uint32(
+          TP_CONNECTION_STATUS_REASON_NONE_SPECIFIED);
+  }
+  else if (!g_strcmp0(property, "NormalizedName"))
+    return g_variant_new_string(MOCK_SELF_ID);
+
+  /* Icon, Nickname, Service and ConnectionError */
+  return g_variant_new_string("");
+}
+
+static const GDBusInterfaceVTable vtable =
+{
+  NULL,
+  _account_get_property,
+  NULL
+};
+
+NuiMockTelepathy *
+nui_mock_telepathy_new(const gchar *address)
+{
+  NuiMockTelepathy *mock = g_slice_new0(NuiMockTelepathy);
+  TpHandleRepoIface *contacts;
+  GDBusNodeInfo *info;
+  GError *error = NULL;
+  GVariant *reply;
+
+  /* telepathy-glib exports it on the shared session bus connection */
+  mock->conn = g_object_new(nui_mock_connection_get_type(),
+                            "protocol", MOCK_PROTOCOL,
+                            NULL);
+  tp_base_connection_register(mock->conn, MOCK_CM, NULL, NULL, &error);
+  g_assert_no_error(error);
+
+  contacts = tp_base_connection_get_handles(mock->conn,
+                                            TP_HANDLE_TYPE_CONTACT);
+  tp_base_connection_change_status(mock->conn,
+                                   TP_CONNECTION_STATUS_CONNECTING,
+                                   TP_CONNECTION_STATUS_REASON_REQUESTED);
+  tp_base_connection_set_self_handle(
+        mock->conn, tp_handle_ensure(contacts, MOCK_SELF_ID, NULL, NULL));
+  tp_base_connection_change_status(mock->conn,
+                                   TP_CONNECTION_STATUS_CONNECTED,
+                                   TP_CONNECTION_STATUS_REASON_REQUESTED);
+
+  mock->channels = g_ptr_array_new_with_free_func(g_object_unref);
+  mock->pending = g_ptr_array_new();
+
+  mock->connection = g_dbus_connection_new_for_address_sync(
+        address,
+        G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT |
+        G_DBUS_CONNECTION_FLAGS_MESSAGE_BUS_CONNECTION,
+        NULL, NULL, &error);
+  g_assert_no_error(error);
+
+  info = g_dbus_node_info_new_for_xml(introspection_xml, &error);
+  g_assert_no_error(error);
+
+  mock->object_id = g_dbus_connection_register_object(
+        mock->connection, MOCK_ACCOUNT_PATH,
+        g_dbus_node_info_lookup_interface(info, TP_IFACE_ACCOUNT),
+        &vtable, mock, NULL, &error);
+  g_assert_no_error(error);
+  g_dbus_node_info_unref(info);
+
+  /* DBUS_NAME_FLAG_DO_NOT_QUEUE */
+  reply = g_dbus_connection_call_sync(
+        mock->connection, "org.freedesktop.DBus", "/org/freedesktop/DBus",
+        "org.freedesktop.DBus", "RequestName",
+        g_variant_new("(su)", TP_ACCOUNT_MANAGER_BUS_NAME, 4),
+        G_VARIANT_TYPE("(u)"), G_DBUS_CALL_FLAGS_NONE, -1, NULL, &error);
+  g_assert_no_error(error);
+  g_variant_unref(reply);
+
+  return mock;
+}
+
+void
+nui_mock_telepathy_free(NuiMockTelepathy *mock)
+{
+  guint i;
+
+  for (i = 0; i < mock->channels->len; i++)
+  {
+    TpBaseChannel *channel = g_ptr_array_index(mock->channels, i);
+
+    if (!tp_base_channel_is_destroyed(channel))
+      tp_base_channel_destroyed(channel);
+  }
+
+  g_ptr_array_unref(mock->pending);
+  g_ptr_array_unref(mock->channels);
+
+  /* shut_down finishes right away */
+  tp_base_connection_change_status(mock->conn,
+                                   TP_CONNECTION_STATUS_DISCONNECTED,
+                                   TP_CONNECTION_STATUS_REASON_REQUESTED);
+  g_object_unref(mock->conn);
+
+  g_dbus_connection_unregister_object(mock->connection, mock->object_id);
+  g_dbus_connection_close_sync(mock->connection, NULL, NULL);
+  g_object_unref(mock->connection);
+  g_slice_free(NuiMockTelepathy, mock);
+}
+
+const gchar *
+nui_mock_telepathy_get_account_path(NuiMockTelepathy *mock)
+{
+  return MOCK_ACCOUNT_PATH;
+}
+
+static TpBaseChannel *
+_channel_add(NuiMockTelepathy *mock, GType type, const gchar *remote_id)
+{
+  TpHandleRepoIface *contacts = tp_base_connection_get_handles(
+        mock->conn, TP_HANDLE_TYPE_CONTACT);
+  TpHandle handle = tp_handle_ensure(contacts, remote_id, NULL, NULL);
+  TpBaseChannel *channel;
+
+  g_assert(handle != 0);
+
+  channel = g_object_new(type,
+                         "connection", mock->conn,
+                         "handle", handle,
+                         "initiator-handle", handle,
+                         "requested", FALSE,
+                         NULL);
+  tp_base_channel_register(channel);
+  g_ptr_array_add(mock->channels, channel);
+  g_ptr_array_add(mock->pending, channel);
+
+  return channel;
+}
+
+TpBaseChannel *
+nui_mock_telepathy_add_text(NuiMockTelepathy *mock, const gchar *remote_id)
+{
+  return _channel_add(mock, nui_mock_text_channel_get_type(), remote_id);
+}
+
+TpBaseChannel *
+nui_mock_telepathy_add_call(NuiMockTelepathy *mock, const gchar *remote_id)
+{
+  return _channel_add(mock, nui_mock_call_channel_get_type(), remote_id);
+}
+
+void
+nui_mock_telepathy_receive(NuiMockTelepathy *mock, TpBaseChannel *channel,
+                           const gchar *text)
+{
+  TpMessage *message;
+
+  g_assert(G_TYPE_CHECK_INSTANCE_TYPE(channel,
+                                      nui_mock_text_channel_get_type()));
+
+  message = tp_cm_message_new_text(mock->conn,
+                                   tp_base_channel_get_target_handle(channel),
+                                   TP_CHANNEL_TEXT_MESSAGE_TYPE_NORMAL, text);
+  tp_message_mixin_take_received(G_OBJECT(channel), message);
+}
+
+void
+nui_mock_telepathy_close(NuiMockTelepathy *mock, TpBaseChannel *channel)
+{
+  tp_base_channel_destroyed(channel);
+}
+
+static void
+_observe_channels_cb(GObject *object, GAsyncResult *res, gpointer user_data)
+{
+  NuiMockTelepathy *mock = user_data;
+  GError *error = NULL;
+  GVariant *reply;
+
+  reply = g_dbus_connection_call_finish(G_DBUS_CONNECTION(object), res,
+                                        &error);
+  g_assert_no_error(error);
+  g_variant_unref(reply);
+  mock->observed++;
+}
+
+void
+nui_mock_telepathy_dispatch(NuiMockTelepathy *mock, const gchar *client)
+{
+  GVariantBuilder channels;
+  gchar *bus_name;
+  gchar *path;
+  guint i;
+
+  g_variant_builder_init(&channels, G_VARIANT_TYPE("a(oa{sv})"));
+
+  for (i = 0; i < mock->pending->len; i++)
+  {
+    TpBaseChannel *channel = g_ptr_array_index(mock->pending, i);
+    GHashTable *properties;
+
+    g_object_get(channel, "channel-properties", &properties, NULL);
+    g_variant_builder_add(&channels, "(o@a{sv})",
+                          tp_base_channel_get_object_path(channel),
+                          tp_asv_to_vardict(properties));
+    g_hash_table_unref(properties);
+  }
+
+  g_ptr_array_set_size(mock->pending, 0);
+
+  bus_name = g_strconcat(TP_CLIENT_BUS_NAME_BASE, client, NULL);
+  path = g_strconcat(TP_CLIENT_OBJECT_PATH_BASE, client, NULL);
+
+  /* answered once the observer prepared everything, so not waited for here,
+   * the main loop has to run for that
+   */
+  g_dbus_connection_call(
+        mock->connection, bus_name, path, TP_IFACE_CLIENT_OBSERVER,
+        "ObserveChannels",
+        g_variant_new("(oo@a(oa{sv})o@ao@a{sv})", MOCK_ACCOUNT_PATH,
+                      tp_base_connection_get_object_path(mock->conn),
+                      g_variant_builder_end(&channels), "/",
+                      g_variant_new_array(G_VARIANT_TYPE_OBJECT_PATH, NULL,
+                                          0),
+                      g_variant_new_array(G_VARIANT_TYPE("{sv}"), NULL, 0)),
+        NULL, G_DBUS_CALL_FLAGS_NONE, -1, NULL, _observe_channels_cb, mock);
+
+  g_free(path);
+  g_free(bus_name);
+}
+
+guint
+nui_mock_telepathy_get_observed(NuiMockTelepathy *mock)
+{
+  return mock->observed;
+}
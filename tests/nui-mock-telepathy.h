@@ -0,0 +1,62 @@
+/*
+ * nui-mock-telepathy.h
+ *
+ * Copyright (C) 2024 Ivaylo Dimitrov <ivo.g.dimitrov.75@gmail.com>
+ *
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __NUI_MOCK_TELEPATHY_H__
+#define __NUI_MOCK_TELEPATHY_H__
+
+G_BEGIN_DECLS
+
+typedef struct _NuiMockTelepathy NuiMockTelepathy;
+
+/* a connected ring connection, exported by telepathy-glib on the session
+ * bus, and its account, served like mission control does on an own
+ * connection to the bus at address. everything is answered in the
+ * thread-default main context of the caller of nui_mock_telepathy_new()
+ */
+NuiMockTelepathy *nui_mock_telepathy_new(const gchar *address);
+void nui_mock_telepathy_free(NuiMockTelepathy *mock);
+
+const gchar *nui_mock_telepathy_get_account_path(NuiMockTelepathy *mock);
+
+/* incoming channels from remote_id, only observed on the next dispatch */
+TpBaseChannel *nui_mock_telepathy_add_text(NuiMockTelepathy *mock,
+                                           const gchar *remote_id);
+TpBaseChannel *nui_mock_telepathy_add_call(NuiMockTelepathy *mock,
+                                           const gchar *remote_id);
+
+/* a message from the remote contact of a text channel */
+void nui_mock_telepathy_receive(NuiMockTelepathy *mock,
+                                TpBaseChannel *channel, const gchar *text);
+
+/* the remote end hung up or the channel was closed otherwise */
+void nui_mock_telepathy_close(NuiMockTelepathy *mock,
+                              TpBaseChannel *channel);
+
+/* ObserveChannels on client with all the channels added since the last
+ * dispatch, in one call the way a burst after reconnecting comes
+ */
+void nui_mock_telepathy_dispatch(NuiMockTelepathy *mock,
+                                 const gchar *client);
+
+/* ObserveChannels calls the observer returned from */
+guint nui_mock_telepathy_get_observed(NuiMockTelepathy *mock);
+
+G_END_DECLS
+
+#endif /* __NUI_MOCK_TELEPATHY_H__ */
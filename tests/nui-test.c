@@ -0,0 +1,122 @@
+/*
+ * nui-test.c
+ *
+ * Copyright (C) 2024 Ivaylo Dimitrov <ivo.g.dimitrov.75@gmail.com>
+ *
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "config.h"
+
+#include <gio/gio.h>
+
+#include <unistd.h>
+
+#include "nui-test.h"
+
+static GDBusConnection *system_bus = NULL;
+
+GTestDBus *
+nui_test_bus_up(void)
+{
+  GTestDBus *bus = g_test_dbus_new(G_TEST_DBUS_NONE);
+  GError *error = NULL;
+
+  g_test_dbus_up(bus);
+  g_setenv("DBUS_SYSTEM_BUS_ADDRESS", g_test_dbus_get_bus_address(bus),
+           TRUE);
+
+  /* GTestDBus only takes care of the session bus connection, do not let the
+   * system one kill the process once the daemon is gone
+   */
+  system_bus = g_bus_get_sync(G_BUS_TYPE_SYSTEM, NULL, &error);
+  g_assert_no_error(error);
+  g_dbus_connection_set_exit_on_close(system_bus, FALSE);
+
+  return bus;
+}
+
+void
+nui_test_bus_down(GTestDBus *bus)
+{
+  g_test_dbus_down(bus);
+  g_object_unref(bus);
+  g_clear_object(&system_bus);
+  g_unsetenv("DBUS_SYSTEM_BUS_ADDRESS");
+}
+
+static gboolean
+_timeout_cb(gpointer user_data)
+{
+  *(gboolean *)user_data = TRUE;
+
+  return G_SOURCE_REMOVE;
+}
+
+gboolean
+nui_test_wait(NuiTestCondition condition, gpointer user_data)
+{
+  gboolean timed_out = FALSE;
+  guint id;
+
+  id = g_timeout_add(NUI_TEST_TIMEOUT, _timeout_cb, &timed_out);
+
+  while (!condition(user_data))
+  {
+    if (timed_out)
+      return FALSE;
+
+    g_main_context_iteration(NULL, TRUE);
+  }
+
+  if (!timed_out)
+    g_source_remove(id);
+
+  return TRUE;
+}
+
+void
+nui_test_spin(guint ms)
+{
+  gboolean done = FALSE;
+
+  g_timeout_add(ms, _timeout_cb, &done);
+
+  while (!done)
+    g_main_context_iteration(NULL, TRUE);
+}
+
+glong
+nui_test_rss_kb(void)
+{
+  gchar *statm;
+  glong rss = -1;
+
+  if (g_file_get_contents("/proc/self/statm", &statm, NULL, NULL))
+  {
+    gchar **fields = g_strsplit(statm, " ", 3);
+
+    /* size resident shared text lib data dt, in pages */
+    if (fields[0] && fields[1])
+    {
+      rss = g_ascii_strtoll(fields[1], NULL, 10) *
+          (sysconf(_SC_PAGESIZE) / 1024);
+    }
+
+    g_strfreev(fields);
+    g_free(statm);
+  }
+
+  return rss;
+}
@@ -0,0 +1,49 @@
+/*
+ * nui-test.h
+ *
+ * Copyright (C) 2024 Ivaylo Dimitrov <ivo.g.dimitrov.75@gmail.com>
+ *
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __NUI_TEST_H__
+#define __NUI_TEST_H__
+
+G_BEGIN_DECLS
+
+/* ms nui_test_wait() gives up after */
+#define NUI_TEST_TIMEOUT 5000
+
+/* starts a private bus that serves as both the session and the system bus,
+ * so stand-ins for system services are reached the way the plugin expects
+ */
+GTestDBus *nui_test_bus_up(void);
+void nui_test_bus_down(GTestDBus *bus);
+
+typedef gboolean (*NuiTestCondition)(gpointer user_data);
+
+/* iterates the default main context until condition is met, FALSE if it is
+ * not within NUI_TEST_TIMEOUT
+ */
+gboolean nui_test_wait(NuiTestCondition condition, gpointer user_data);
+
+/* iterates the default main context for ms */
+void nui_test_spin(guint ms);
+
+/* resident set size of the process in kB, -1 if it can't be read */
+glong nui_test_rss_kb(void);
+
+G_END_DECLS
+
+#endif /* __NUI_TEST_H__ */
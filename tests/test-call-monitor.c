@@ -0,0 +1,434 @@
+/*
+ * test-call-monitor.c
+ *
+ * Copyright (C) 2024 Ivaylo Dimitrov <ivo.g.dimitrov.75@gmail.com>
+ *
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "config.h"
+
+#include <gio/gio.h>
+
+#include "nui-call-monitor.h"
+
+#include "nui-mock-ofono.h"
+#include "nui-test.h"
+
+typedef struct
+{
+  GTestDBus *bus;
+  NuiMockOfono *ofono;
+  NuiCallMonitor *monitor;
+  gboolean threaded;
+  /* every status the monitor emitted */
+  GArray *statuses;
+  /* a{sau} the monitor emitted last */
+  GVariant *calls;
+  guint calls_changes;
+} Fixture;
+
+typedef struct
+{
+  Fixture *f;
+  guint active;
+  guint total;
+} Expected;
+
+static guint
+_count(GVariant *calls, const gchar *modem, gboolean active_only)
+{
+  GVariantIter iter;
+  const gchar *path;
+  GVariant *counts;
+  guint n = 0;
+
+  if (!calls)
+    return 0;
+
+  g_variant_iter_init(&iter, calls);
+
+  while (g_variant_iter_loop(&iter, "{&s@au}", &path, &counts))
+  {
+    const guint32 *c;
+    gsize len;
+    gsize i;
+
+    if (modem && g_strcmp0(modem, path))
+      continue;
+
+    c = g_variant_get_fixed_array(counts, &len, sizeof(guint32));
+    g_assert_cmpuint(len, ==, NUI_CALL_STATE_LAST);
+
+    for (i = 0; i < len; i++)
+    {
+      if (!active_only || i == NUI_CALL_STATE_ACTIVE ||
+          i == NUI_CALL_STATE_HELD)
+      {
+        n += c[i];
+      }
+    }
+  }
+
+  return n;
+}
+
+static gboolean
+_expected_cb(gpointer user_data)
+{
+  Expected *e = user_data;
+
+  return _count(e->f->calls, NULL, TRUE) == e->active &&
+      _count(e->f->calls, NULL, FALSE) == e->total;
+}
+
+/* waits for the monitor to report the calls, then checks it stayed
+ * consistent on the way there
+ */
+static void
+_wait_calls(Fixture *f, guint active, guint total)
+{
+  Expected e = { f, active, total };
+  guint i;
+
+  nui_mock_ofono_flush(f->ofono);
+  g_assert_true(nui_test_wait(_expected_cb, &e));
+
+  /* every status change is a real one */
+  for (i = 1; i < f->statuses->len; i++)
+  {
+    g_assert_cmpint(g_array_index(f->statuses, gboolean, i), !=,
+                    g_array_index(f->statuses, gboolean, i - 1));
+  }
+
+  if (f->statuses->len)
+  {
+    g_assert_cmpint(g_array_index(f->statuses, gboolean,
+                                  f->statuses->len - 1), ==, active > 0);
+  }
+  else
+    g_assert_cmpuint(active, ==, 0);
+
+  g_assert_cmpint(nui_call_monitor_get_status(f->monitor), ==, active > 0);
+}
+
+static void
+_status_changed_cb(NuiCallMonitor *monitor, gboolean status,
+                   gpointer user_data)
+{
+  Fixture *f = user_data;
+
+  g_array_append_val(f->statuses, status);
+}
+
+static void
+_calls_changed_cb(NuiCallMonitor *monitor, GVariant *calls,
+                  gpointer user_data)
+{
+  Fixture *f = user_data;
+
+  if (f->calls)
+    g_variant_unref(f->calls);
+
+  f->calls = g_variant_ref(calls);
+  f->calls_changes++;
+}
+
+static void
+_setup(Fixture *f, gconstpointer data)
+{
+  f->threaded = GPOINTER_TO_INT(data);
+  f->bus = nui_test_bus_up();
+  f->ofono = nui_mock_ofono_new(g_test_dbus_get_bus_address(f->bus));
+  f->statuses = g_array_new(FALSE, FALSE, sizeof(gboolean));
+}
+
+static void
+_monitor_new(Fixture *f)
+{
+  f->monitor = g_object_new(NUI_TYPE_CALL_MONITOR,
+                            "threaded", f->threaded,
+                            NULL);
+  g_signal_connect(f->monitor, "status-changed",
+                   G_CALLBACK(_status_changed_cb), f);
+  g_signal_connect(f->monitor, "calls-changed",
+                   G_CALLBACK(_calls_changed_cb), f);
+}
+
+static void
+_teardown(Fixture *f, gconstpointer data)
+{
+  g_clear_object(&f->monitor);
+
+  /* let the cancelled calls and the dropped subscriptions go */
+  nui_test_spin(100);
+
+  nui_mock_ofono_free(f->ofono);
+  nui_test_bus_down(f->bus);
+
+  if (f->calls)
+    g_variant_unref(f->calls);
+
+  g_array_free(f->statuses, TRUE);
+}
+
+static void
+test_discovery(Fixture *f, gconstpointer data)
+{
+  nui_mock_ofono_populate(f->ofono, 2, 3, "active");
+  _monitor_new(f);
+  _wait_calls(f, 6, 6);
+
+  g_assert_cmpuint(_count(f->calls, "/mock_0", TRUE), ==, 3);
+  g_assert_cmpuint(_count(f->calls, "/mock_1", TRUE), ==, 3);
+  g_assert_cmpuint(f->statuses->len, ==, 1);
+}
+
+/* equal states must give equal snapshots, PropertiesChanged relies on it */
+static void
+test_order(Fixture *f, gconstpointer data)
+{
+  GVariantIter iter;
+  const gchar *path;
+  gchar *last = NULL;
+  GVariant *calls;
+
+  nui_mock_ofono_populate(f->ofono, 8, 1, "active");
+  _monitor_new(f);
+  _wait_calls(f, 8, 8);
+
+  g_variant_iter_init(&iter, f->calls);
+
+  while (g_variant_iter_loop(&iter, "{&s@au}", &path, NULL))
+  {
+    if (last)
+      g_assert_cmpstr(last, <, path);
+
+    g_free(last);
+    last = g_strdup(path);
+  }
+
+  g_free(last);
+
+  calls = nui_call_monitor_dup_calls(f->monitor);
+  g_assert_true(g_variant_equal(calls, f->calls));
+  g_variant_unref(calls);
+}
+
+static void
+test_transitions(Fixture *f, gconstpointer data)
+{
+  const gchar *call;
+
+  nui_mock_ofono_add_modem(f->ofono, "/ril_0", TRUE);
+  _monitor_new(f);
+  nui_test_spin(100);
+  g_assert_false(nui_call_monitor_get_status(f->monitor));
+
+  call = nui_mock_ofono_add_call(f->ofono, "/ril_0", "incoming");
+  _wait_calls(f, 0, 1);
+
+  nui_mock_ofono_set_call_state(f->ofono, call, "active");
+  _wait_calls(f, 1, 1);
+
+  nui_mock_ofono_set_call_state(f->ofono, call, "held");
+  _wait_calls(f, 1, 1);
+
+  nui_mock_ofono_set_call_state(f->ofono, call, "active");
+  _wait_calls(f, 1, 1);
+
+  nui_mock_ofono_set_call_state(f->ofono, call, "disconnected");
+  _wait_calls(f, 0, 1);
+
+  nui_mock_ofono_remove_call(f->ofono, call);
+  _wait_calls(f, 0, 0);
+
+  /* active, held, active again is one call all the way through */
+  g_assert_cmpuint(f->statuses->len, ==, 2);
+}
+
+static void
+test_modem_removed(Fixture *f, gconstpointer data)
+{
+  nui_mock_ofono_populate(f->ofono, 2, 2, "active");
+  _monitor_new(f);
+  _wait_calls(f, 4, 4);
+
+  nui_mock_ofono_remove_modem(f->ofono, "/mock_0");
+  _wait_calls(f, 2, 2);
+  g_assert_false(g_variant_lookup(f->calls, "/mock_0", "@au", NULL));
+
+  nui_mock_ofono_remove_modem(f->ofono, "/mock_1");
+  _wait_calls(f, 0, 0);
+}
+
+/* /ril_0 is a prefix of /ril_01, neither must touch the calls of the other */
+static void
+test_prefix(Fixture *f, gconstpointer data)
+{
+  const gchar *call;
+
+  nui_mock_ofono_add_modem(f->ofono, "/ril_0", TRUE);
+  nui_mock_ofono_add_modem(f->ofono, "/ril_01", TRUE);
+  nui_mock_ofono_add_call(f->ofono, "/ril_0", "active");
+  call = nui_mock_ofono_add_call(f->ofono, "/ril_01", "incoming");
+  _monitor_new(f);
+  _wait_calls(f, 1, 2);
+
+  nui_mock_ofono_set_call_state(f->ofono, call, "active");
+  _wait_calls(f, 2, 2);
+  g_assert_cmpuint(_count(f->calls, "/ril_0", TRUE), ==, 1);
+  g_assert_cmpuint(_count(f->calls, "/ril_01", TRUE), ==, 1);
+
+  nui_mock_ofono_remove_modem(f->ofono, "/ril_0");
+  _wait_calls(f, 1, 1);
+  g_assert_cmpuint(_count(f->calls, "/ril_01", TRUE), ==, 1);
+
+  nui_mock_ofono_set_call_state(f->ofono, call, "held");
+  nui_mock_ofono_flush(f->ofono);
+  nui_test_spin(100);
+  g_assert_cmpuint(_count(f->calls, "/ril_01", TRUE), ==, 1);
+  g_assert_true(nui_call_monitor_get_status(f->monitor));
+}
+
+static void
+test_interfaces(Fixture *f, gconstpointer data)
+{
+  nui_mock_ofono_populate(f->ofono, 1, 2, "held");
+  _monitor_new(f);
+  _wait_calls(f, 2, 2);
+
+  /* calls go with the voice call manager and come back with it */
+  nui_mock_ofono_set_voice(f->ofono, "/mock_0", FALSE);
+  _wait_calls(f, 0, 0);
+
+  nui_mock_ofono_set_voice(f->ofono, "/mock_0", TRUE);
+  _wait_calls(f, 2, 2);
+}
+
+static gboolean
+_calls_changes_cb(gpointer user_data)
+{
+  Expected *e = user_data;
+
+  return e->f->calls_changes > e->total;
+}
+
+static void
+test_restart(Fixture *f, gconstpointer data)
+{
+  Expected resynced = { f, 0, 0 };
+  guint statuses;
+
+  nui_mock_ofono_populate(f->ofono, 2, 1, "active");
+  _monitor_new(f);
+  _wait_calls(f, 2, 2);
+  statuses = f->statuses->len;
+  resynced.total = f->calls_changes;
+
+  g_test_expect_message(G_LOG_DOMAIN, G_LOG_LEVEL_WARNING, "OFONO vanished*");
+  nui_mock_ofono_set_running(f->ofono, FALSE);
+  nui_mock_ofono_set_running(f->ofono, TRUE);
+
+  /* the resync picks up where it was, no status flapping meanwhile */
+  nui_mock_ofono_flush(f->ofono);
+  g_assert_true(nui_test_wait(_calls_changes_cb, &resynced));
+  _wait_calls(f, 2, 2);
+  g_test_assert_expected_messages();
+  g_assert_cmpuint(f->statuses->len, ==, statuses);
+}
+
+static const gchar *walk_states[] =
+{
+  "incoming", "active", "held", "active", "disconnected"
+};
+
+/* every call of every modem through the states, one step at a time */
+static void
+test_walk(Fixture *f, gconstpointer data)
+{
+  const guint modems = 3;
+  const guint calls = 4;
+  gchar **paths;
+  guint step;
+  guint i;
+
+  nui_mock_ofono_populate(f->ofono, modems, calls, "dialing");
+  _monitor_new(f);
+  _wait_calls(f, 0, modems * calls);
+
+  paths = nui_mock_ofono_dup_calls(f->ofono);
+
+  for (step = 0; step < G_N_ELEMENTS(walk_states); step++)
+  {
+    const gchar *state = walk_states[step];
+    gboolean active = !g_strcmp0(state, "active") ||
+        !g_strcmp0(state, "held");
+
+    for (i = 0; paths[i]; i++)
+    {
+      nui_mock_ofono_set_call_state(f->ofono, paths[i], state);
+
+      /* calls before i are in the new state, the rest in the old one */
+      if (active)
+        _wait_calls(f, step > 1 ? modems * calls : i + 1, modems * calls);
+      else if (step == 0)
+        _wait_calls(f, 0, modems * calls);
+      else
+        _wait_calls(f, modems * calls - i - 1, modems * calls);
+    }
+  }
+
+  for (i = 0; paths[i]; i++)
+    nui_mock_ofono_remove_call(f->ofono, paths[i]);
+
+  _wait_calls(f, 0, 0);
+  g_assert_cmpuint(f->statuses->len, ==, 2);
+
+  g_strfreev(paths);
+}
+
+static void
+_add(const gchar *name, gboolean threaded,
+     void (*test)(Fixture *, gconstpointer))
+{
+  gchar *path = g_strdup_printf("/call-monitor/%s/%s",
+                                threaded ? "threaded" : "direct", name);
+
+  g_test_add(path, Fixture, GINT_TO_POINTER(threaded), _setup, test,
+             _teardown);
+  g_free(path);
+}
+
+int
+main(int argc, char **argv)
+{
+  int threaded;
+
+  g_test_init(&argc, &argv, NULL);
+
+  for (threaded = 0; threaded < 2; threaded++)
+  {
+    _add("discovery", threaded, test_discovery);
+    _add("order", threaded, test_order);
+    _add("transitions", threaded, test_transitions);
+    _add("modem-removed", threaded, test_modem_removed);
+    _add("prefix", threaded, test_prefix);
+    _add("interfaces", threaded, test_interfaces);
+    _add("restart", threaded, test_restart);
+    _add("walk", threaded, test_walk);
+  }
+
+  return g_test_run();
+}
@@ -0,0 +1,138 @@
+/*
+ * test-call-timer.c
+ *
+ * Copyright (C) 2024 Ivaylo Dimitrov <ivo.g.dimitrov.75@gmail.com>
+ *
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "config.h"
+
+#include <gio/gio.h>
+
+#include "nui-call-timer.h"
+
+#include "nui-test.h"
+
+typedef struct
+{
+  NuiCallTimer *timer;
+  guint ticks;
+  gint64 duration;
+} Fixture;
+
+static void
+_tick(gint64 duration, gpointer user_data)
+{
+  Fixture *f = user_data;
+
+  f->ticks++;
+  f->duration = duration;
+}
+
+static void
+_setup(Fixture *f, gconstpointer data)
+{
+  f->timer = nui_call_timer_new(_tick, f);
+}
+
+static void
+_teardown(Fixture *f, gconstpointer data)
+{
+  nui_call_timer_free(f->timer);
+}
+
+static void
+test_idle(Fixture *f, gconstpointer data)
+{
+  /* the menu is open but there is no call */
+  nui_call_timer_set_visible(f->timer, TRUE);
+  g_assert_false(nui_call_timer_is_running(f->timer));
+
+  nui_test_spin(2500);
+  g_assert_cmpuint(nui_call_timer_get_wakeups(f->timer), ==, 0);
+  g_assert_cmpuint(f->ticks, ==, 0);
+}
+
+static void
+test_hidden(Fixture *f, gconstpointer data)
+{
+  /* a call nobody looks at */
+  nui_call_timer_set_active_since(f->timer, g_get_monotonic_time());
+  g_assert_false(nui_call_timer_is_running(f->timer));
+
+  nui_test_spin(2500);
+  g_assert_cmpuint(nui_call_timer_get_wakeups(f->timer), ==, 0);
+  g_assert_cmpuint(f->ticks, ==, 0);
+}
+
+static void
+test_active(Fixture *f, gconstpointer data)
+{
+  guint wakeups;
+
+  nui_call_timer_set_active_since(f->timer,
+                                  g_get_monotonic_time() - 65 * G_USEC_PER_SEC);
+  nui_call_timer_set_visible(f->timer, TRUE);
+
+  /* shown right away, not a second later */
+  g_assert_true(nui_call_timer_is_running(f->timer));
+  g_assert_cmpuint(f->ticks, ==, 1);
+  g_assert_cmpint(f->duration, ==, 65);
+
+  nui_test_spin(2500);
+  wakeups = nui_call_timer_get_wakeups(f->timer);
+  g_assert_cmpuint(wakeups, >=, 1);
+  g_assert_cmpuint(wakeups, <=, 3);
+  g_assert_cmpint(f->duration, >=, 66);
+
+  /* the call ended, no more wakeups */
+  nui_call_timer_set_active_since(f->timer, 0);
+  g_assert_false(nui_call_timer_is_running(f->timer));
+  nui_test_spin(1500);
+  g_assert_cmpuint(nui_call_timer_get_wakeups(f->timer), ==, wakeups);
+}
+
+static void
+test_closed(Fixture *f, gconstpointer data)
+{
+  guint wakeups;
+
+  nui_call_timer_set_active_since(f->timer, g_get_monotonic_time());
+  nui_call_timer_set_visible(f->timer, TRUE);
+  nui_test_spin(1500);
+
+  /* the menu was closed, the call goes on */
+  nui_call_timer_set_visible(f->timer, FALSE);
+  wakeups = nui_call_timer_get_wakeups(f->timer);
+  nui_test_spin(1500);
+  g_assert_cmpuint(nui_call_timer_get_wakeups(f->timer), ==, wakeups);
+}
+
+int
+main(int argc, char **argv)
+{
+  g_test_init(&argc, &argv, NULL);
+
+  g_test_add("/call-timer/idle", Fixture, NULL, _setup, test_idle,
+             _teardown);
+  g_test_add("/call-timer/hidden", Fixture, NULL, _setup, test_hidden,
+             _teardown);
+  g_test_add("/call-timer/active", Fixture, NULL, _setup, test_active,
+             _teardown);
+  g_test_add("/call-timer/closed", Fixture, NULL, _setup, test_closed,
+             _teardown);
+
+  return g_test_run();
+}
@@ -0,0 +1,290 @@
+/*
+ * test-contact-cache.c
+ *
+ * Copyright (C) 2024 Ivaylo Dimitrov <ivo.g.dimitrov.75@gmail.com>
+ *
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "config.h"
+
+#include <telepathy-glib/telepathy-glib.h>
+
+#include "nui-contact-cache.h"
+
+#define ACCOUNT "/org/freedesktop/Telepathy/Account/ring/tel/ring"
+#define OTHER_ACCOUNT "/org/freedesktop/Telepathy/Account/sofiasip/sip/a"
+
+/* in-memory address book, the cache resolves its ids from it */
+typedef struct
+{
+  NuiContactCache *cache;
+  /* id to name */
+  GHashTable *book;
+  /* resolves are queued and answered later instead of right away */
+  gboolean deferred;
+  GPtrArray *deferred_ids;
+  guint resolves;
+  /* what the resolved callback got last */
+  guint resolved;
+  gchar *resolved_id;
+  gchar *resolved_name;
+} Fixture;
+
+static void
+_book_answer(Fixture *f, const gchar *id)
+{
+  nui_contact_cache_resolved(f->cache, ACCOUNT, id,
+                             g_hash_table_lookup(f->book, id));
+}
+
+static void
+_resolve(NuiContactCache *cache, const gchar *account, const gchar *id,
+         gpointer user_data)
+{
+  Fixture *f = user_data;
+
+  g_assert_cmpstr(account, ==, ACCOUNT);
+  f->resolves++;
+
+  if (f->deferred)
+    g_ptr_array_add(f->deferred_ids, g_strdup(id));
+  else
+    _book_answer(f, id);
+}
+
+static void
+_resolved_cb(const gchar *account, const gchar *id, const gchar *name,
+             gpointer user_data)
+{
+  Fixture *f = user_data;
+
+  f->resolved++;
+  g_free(f->resolved_id);
+  f->resolved_id = g_strdup(id);
+  g_free(f->resolved_name);
+  f->resolved_name = g_strdup(name);
+}
+
+static void
+_setup(Fixture *f, gconstpointer data)
+{
+  f->book = g_hash_table_new(g_str_hash, g_str_equal);
+  g_hash_table_insert(f->book, "+358401234567", "Alice");
+  g_hash_table_insert(f->book, "+15550100", "Bob");
+  g_hash_table_insert(f->book, "carol@example.com", "Carol");
+  f->deferred_ids = g_ptr_array_new_with_free_func(g_free);
+
+  f->cache = nui_contact_cache_new(GPOINTER_TO_UINT(data), _resolved_cb, f);
+  nui_contact_cache_set_resolver(f->cache, _resolve, f);
+}
+
+static void
+_teardown(Fixture *f, gconstpointer data)
+{
+  nui_contact_cache_free(f->cache);
+  g_ptr_array_free(f->deferred_ids, TRUE);
+  g_hash_table_unref(f->book);
+  g_free(f->resolved_id);
+  g_free(f->resolved_name);
+}
+
+static const gchar *
+_lookup(Fixture *f, const gchar *account, const gchar *id)
+{
+  const gchar *name = "not cached";
+
+  if (!nui_contact_cache_lookup(f->cache, account, id, &name))
+    return "not cached";
+
+  return name;
+}
+
+static void
+test_hit_miss(Fixture *f, gconstpointer data)
+{
+  guint hits;
+  guint misses;
+
+  g_assert_cmpstr(_lookup(f, ACCOUNT, "+15550100"), ==, "not cached");
+
+  nui_contact_cache_prefetch(f->cache, NULL, ACCOUNT, "+15550100");
+  g_assert_cmpuint(f->resolved, ==, 1);
+  g_assert_cmpstr(f->resolved_id, ==, "+15550100");
+  g_assert_cmpstr(f->resolved_name, ==, "Bob");
+
+  g_assert_cmpstr(_lookup(f, ACCOUNT, "+15550100"), ==, "Bob");
+  g_assert_cmpstr(_lookup(f, ACCOUNT, "+15550100"), ==, "Bob");
+
+  /* cached ids are not resolved again */
+  nui_contact_cache_prefetch(f->cache, NULL, ACCOUNT, "+15550100");
+  g_assert_cmpuint(f->resolves, ==, 1);
+
+  nui_contact_cache_get_stats(f->cache, &hits, &misses);
+  g_assert_cmpuint(hits, ==, 2);
+  g_assert_cmpuint(misses, ==, 1);
+}
+
+static void
+_assert_normalized(const gchar *id, const gchar *normalized)
+{
+  gchar *s = nui_contact_cache_normalize(id);
+
+  g_assert_cmpstr(s, ==, normalized);
+  g_free(s);
+}
+
+static void
+test_normalize(Fixture *f, gconstpointer data)
+{
+  _assert_normalized("+358 (40) 123-4567", "401234567");
+  _assert_normalized("0401234567", "401234567");
+  _assert_normalized("Carol@Example.COM", "carol@example.com");
+  _assert_normalized(NULL, "");
+
+  nui_contact_cache_prefetch(f->cache, NULL, ACCOUNT, "+358401234567");
+
+  /* national, international and formatted forms of the same number */
+  g_assert_cmpstr(_lookup(f, ACCOUNT, "+358401234567"), ==, "Alice");
+  g_assert_cmpstr(_lookup(f, ACCOUNT, "0401234567"), ==, "Alice");
+  g_assert_cmpstr(_lookup(f, ACCOUNT, "+358 (40) 123-4567"), ==, "Alice");
+  g_assert_cmpstr(_lookup(f, ACCOUNT, "0401234568"), ==, "not cached");
+
+  /* not a number, compared case-insensitively */
+  nui_contact_cache_prefetch(f->cache, NULL, ACCOUNT, "carol@example.com");
+  g_assert_cmpstr(_lookup(f, ACCOUNT, "Carol@Example.COM"), ==, "Carol");
+
+  /* same id on another account is another contact */
+  g_assert_cmpstr(_lookup(f, OTHER_ACCOUNT, "+358401234567"), ==,
+                  "not cached");
+}
+
+static void
+test_negative(Fixture *f, gconstpointer data)
+{
+  const gchar *name = "unset";
+
+  nui_contact_cache_prefetch(f->cache, NULL, ACCOUNT, "+15550199");
+  g_assert_cmpuint(f->resolved, ==, 1);
+  g_assert_null(f->resolved_name);
+
+  /* known to have no name, not looked up again */
+  g_assert_true(nui_contact_cache_lookup(f->cache, ACCOUNT, "+15550199",
+                                         &name));
+  g_assert_null(name);
+
+  nui_contact_cache_prefetch(f->cache, NULL, ACCOUNT, "+15550199");
+  g_assert_cmpuint(f->resolves, ==, 1);
+}
+
+static void
+test_lru(Fixture *f, gconstpointer data)
+{
+  nui_contact_cache_prefetch(f->cache, NULL, ACCOUNT, "+358401234567");
+  nui_contact_cache_prefetch(f->cache, NULL, ACCOUNT, "+15550100");
+
+  /* Alice is used last, Bob goes when Carol comes in */
+  g_assert_cmpstr(_lookup(f, ACCOUNT, "+358401234567"), ==, "Alice");
+  nui_contact_cache_prefetch(f->cache, NULL, ACCOUNT, "carol@example.com");
+
+  g_assert_cmpstr(_lookup(f, ACCOUNT, "+15550100"), ==, "not cached");
+  g_assert_cmpstr(_lookup(f, ACCOUNT, "+358401234567"), ==, "Alice");
+  g_assert_cmpstr(_lookup(f, ACCOUNT, "carol@example.com"), ==, "Carol");
+}
+
+static void
+test_invalidate(Fixture *f, gconstpointer data)
+{
+  nui_contact_cache_prefetch(f->cache, NULL, ACCOUNT, "+358401234567");
+  nui_contact_cache_prefetch(f->cache, NULL, ACCOUNT, "+15550100");
+
+  /* the address book changed, the new name is picked up on the next miss */
+  g_hash_table_insert(f->book, "+358401234567", "Alice Smith");
+  nui_contact_cache_invalidate(f->cache, ACCOUNT, "0401234567");
+  g_assert_cmpstr(_lookup(f, ACCOUNT, "+358401234567"), ==, "not cached");
+  g_assert_cmpstr(_lookup(f, ACCOUNT, "+15550100"), ==, "Bob");
+
+  nui_contact_cache_prefetch(f->cache, NULL, ACCOUNT, "+358401234567");
+  g_assert_cmpstr(_lookup(f, ACCOUNT, "+358401234567"), ==, "Alice Smith");
+
+  /* account removed */
+  nui_contact_cache_invalidate(f->cache, ACCOUNT, NULL);
+  g_assert_cmpstr(_lookup(f, ACCOUNT, "+358401234567"), ==, "not cached");
+  g_assert_cmpstr(_lookup(f, ACCOUNT, "+15550100"), ==, "not cached");
+}
+
+static void
+test_pending(Fixture *f, gconstpointer data)
+{
+  guint i;
+
+  f->deferred = TRUE;
+
+  /* a batch of events from the same sender resolves it once */
+  for (i = 0; i < 10; i++)
+    nui_contact_cache_prefetch(f->cache, NULL, ACCOUNT, "+15550100");
+
+  nui_contact_cache_prefetch(f->cache, NULL, ACCOUNT, "+358401234567");
+  g_assert_cmpuint(f->resolves, ==, 2);
+  g_assert_cmpuint(f->resolved, ==, 0);
+  g_assert_cmpstr(_lookup(f, ACCOUNT, "+15550100"), ==, "not cached");
+
+  for (i = 0; i < f->deferred_ids->len; i++)
+    _book_answer(f, g_ptr_array_index(f->deferred_ids, i));
+
+  g_assert_cmpuint(f->resolved, ==, 2);
+  g_assert_cmpstr(_lookup(f, ACCOUNT, "+15550100"), ==, "Bob");
+  g_assert_cmpstr(_lookup(f, ACCOUNT, "0401234567"), ==, "Alice");
+}
+
+static void
+test_invalidate_pending(Fixture *f, gconstpointer data)
+{
+  f->deferred = TRUE;
+
+  nui_contact_cache_prefetch(f->cache, NULL, ACCOUNT, "+15550100");
+  nui_contact_cache_invalidate(f->cache, ACCOUNT, NULL);
+
+  /* the answer comes in after the account was dropped */
+  _book_answer(f, "+15550100");
+  g_assert_cmpuint(f->resolved, ==, 0);
+  g_assert_cmpstr(_lookup(f, ACCOUNT, "+15550100"), ==, "not cached");
+
+  /* and it is looked up again */
+  nui_contact_cache_prefetch(f->cache, NULL, ACCOUNT, "+15550100");
+  g_assert_cmpuint(f->resolves, ==, 2);
+}
+
+int
+main(int argc, char **argv)
+{
+  g_test_init(&argc, &argv, NULL);
+
+  g_test_add("/contact-cache/hit-miss", Fixture, GUINT_TO_POINTER(8),
+             _setup, test_hit_miss, _teardown);
+  g_test_add("/contact-cache/normalize", Fixture, GUINT_TO_POINTER(8),
+             _setup, test_normalize, _teardown);
+  g_test_add("/contact-cache/negative", Fixture, GUINT_TO_POINTER(8),
+             _setup, test_negative, _teardown);
+  g_test_add("/contact-cache/lru", Fixture, GUINT_TO_POINTER(2),
+             _setup, test_lru, _teardown);
+  g_test_add("/contact-cache/invalidate", Fixture, GUINT_TO_POINTER(8),
+             _setup, test_invalidate, _teardown);
+  g_test_add("/contact-cache/pending", Fixture, GUINT_TO_POINTER(8),
+             _setup, test_pending, _teardown);
+  g_test_add("/contact-cache/invalidate-pending", Fixture,
+             GUINT_TO_POINTER(8), _setup, test_invalidate_pending, _teardown);
+
+  return g_test_run();
+}
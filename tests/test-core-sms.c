@@ -0,0 +1,185 @@
+/*
+ * test-core-sms.c
+ *
+ * Copyright (C) 2024 Ivaylo Dimitrov <ivo.g.dimitrov.75@gmail.com>
+ *
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "config.h"
+
+#include <gio/gio.h>
+#include <glib/gstdio.h>
+
+#include "nui-core.h"
+
+#include "nui-mock-notifications.h"
+#include "nui-mock-ofono.h"
+#include "nui-test.h"
+
+#define MODEM "/ril_0"
+
+/* SMS from oFono are held back that long for the Telepathy copy, but only
+ * while ring is online
+ */
+#define HOLD 2000
+
+/* the call monitor is a singleton bound to the first bus, so there is one
+ * bus and one core for all the checks
+ */
+typedef struct
+{
+  GTestDBus *bus;
+  NuiMockOfono *ofono;
+  NuiMockNotifications *notifications;
+  NuiCore *core;
+} Fixture;
+
+static gboolean
+_created_cb(gpointer user_data)
+{
+  Fixture *f = user_data;
+
+  return nui_mock_notifications_get_created(f->notifications) >= 2;
+}
+
+static gboolean
+_updated_cb(gpointer user_data)
+{
+  Fixture *f = user_data;
+
+  return nui_mock_notifications_get_updated(f->notifications) > 0;
+}
+
+static void
+_send(Fixture *f, guint n, guint senders)
+{
+  guint i;
+
+  for (i = 0; i < n; i++)
+  {
+    gchar *sender = g_strdup_printf("+1555010%04u", i % senders);
+    gchar *text = g_strdup_printf("Message %u", i);
+
+    nui_mock_ofono_send_message(f->ofono, MODEM, sender, text, FALSE);
+    g_free(text);
+    g_free(sender);
+  }
+
+  nui_mock_ofono_flush(f->ofono);
+}
+
+static void
+test_batch(gconstpointer data)
+{
+  Fixture *f = (Fixture *)data;
+  gint64 start;
+
+  /* a burst from two senders */
+  start = g_get_monotonic_time();
+  _send(f, 20, 2);
+
+  /* there is no account manager on the test bus, nothing to wait for */
+  g_assert_true(nui_test_wait(_created_cb, f));
+  g_assert_cmpint(g_get_monotonic_time() - start, <, HOLD * 1000);
+  nui_test_spin(500);
+
+  /* released as one batch, one notification per sender */
+  g_assert_cmpuint(nui_mock_notifications_get_created(f->notifications), ==,
+                   2);
+  g_assert_cmpuint(nui_mock_notifications_get_updated(f->notifications), ==,
+                   0);
+
+  /* not pending in any channel, so not unread either */
+  g_assert_cmpuint(nui_core_get_unread_messages(f->core), ==, 0);
+
+  /* a later one from the same sender updates its notification */
+  _send(f, 1, 1);
+  g_assert_true(nui_test_wait(_updated_cb, f));
+  g_assert_cmpuint(nui_mock_notifications_get_created(f->notifications), ==,
+                   2);
+  g_assert_cmpuint(nui_core_get_unread_messages(f->core), ==, 0);
+}
+
+static void
+test_no_sender(gconstpointer data)
+{
+  Fixture *f = (Fixture *)data;
+  guint created = nui_mock_notifications_get_created(f->notifications);
+  guint updated = nui_mock_notifications_get_updated(f->notifications);
+
+  nui_mock_ofono_send_message(f->ofono, MODEM, NULL, "Nobody", FALSE);
+  nui_mock_ofono_flush(f->ofono);
+  nui_test_spin(500);
+
+  g_assert_cmpuint(nui_mock_notifications_get_created(f->notifications), ==,
+                   created);
+  g_assert_cmpuint(nui_mock_notifications_get_updated(f->notifications), ==,
+                   updated);
+}
+
+static void
+_cache_remove(const gchar *dir)
+{
+  gchar *path = g_build_filename(dir, PACKAGE_NAME, "counters", NULL);
+
+  g_remove(path);
+  g_free(path);
+
+  path = g_build_filename(dir, PACKAGE_NAME, NULL);
+  g_rmdir(path);
+  g_free(path);
+
+  g_rmdir(dir);
+}
+
+int
+main(int argc, char **argv)
+{
+  GError *error = NULL;
+  Fixture f = { 0 };
+  gchar *cache;
+  int rv;
+
+  /* keep the stored counters out of the user ones */
+  cache = g_dir_make_tmp("nui-test-XXXXXX", &error);
+  g_assert_no_error(error);
+  g_setenv("XDG_CACHE_HOME", cache, TRUE);
+
+  g_test_init(&argc, &argv, NULL);
+
+  f.bus = nui_test_bus_up();
+  f.ofono = nui_mock_ofono_new(g_test_dbus_get_bus_address(f.bus));
+  nui_mock_ofono_add_modem(f.ofono, MODEM, FALSE);
+  f.notifications = nui_mock_notifications_new(
+        g_test_dbus_get_bus_address(f.bus));
+
+  f.core = NUI_CORE(nui_core_new());
+  nui_test_spin(500);
+
+  g_test_add_data_func("/core-sms/batch", &f, test_batch);
+  g_test_add_data_func("/core-sms/no-sender", &f, test_no_sender);
+
+  rv = g_test_run();
+
+  g_object_unref(f.core);
+  nui_test_spin(100);
+  nui_mock_notifications_free(f.notifications);
+  nui_mock_ofono_free(f.ofono);
+  nui_test_bus_down(f.bus);
+  _cache_remove(cache);
+  g_free(cache);
+
+  return rv;
+}
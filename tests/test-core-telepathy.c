@@ -0,0 +1,212 @@
+/*
+ * test-core-telepathy.c
+ *
+ * Copyright (C) 2024 Ivaylo Dimitrov <ivo.g.dimitrov.75@gmail.com>
+ *
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "config.h"
+
+#include <telepathy-glib/telepathy-glib.h>
+#include <glib/gstdio.h>
+
+#include "nui-core.h"
+
+#include "nui-mock-notifications.h"
+#include "nui-mock-telepathy.h"
+#include "nui-test.h"
+
+/* the observer NuiCore registers */
+#define CLIENT "NotificationUI"
+
+/* the channels live on the shared session bus connection, so there is one
+ * bus and one core for all the checks
+ */
+typedef struct
+{
+  GTestDBus *bus;
+  NuiMockNotifications *notifications;
+  NuiMockTelepathy *telepathy;
+  NuiCore *core;
+  guint observed;
+  guint created;
+  guint updated;
+} Fixture;
+
+static gboolean
+_observed_cb(gpointer user_data)
+{
+  Fixture *f = user_data;
+
+  return nui_mock_telepathy_get_observed(f->telepathy) >= f->observed;
+}
+
+static gboolean
+_created_cb(gpointer user_data)
+{
+  Fixture *f = user_data;
+
+  return nui_mock_notifications_get_created(f->notifications) >= f->created;
+}
+
+static gboolean
+_updated_cb(gpointer user_data)
+{
+  Fixture *f = user_data;
+
+  return nui_mock_notifications_get_updated(f->notifications) >= f->updated;
+}
+
+/* what mission control does with the channels added since the last time */
+static void
+_dispatch(Fixture *f)
+{
+  f->observed++;
+  nui_mock_telepathy_dispatch(f->telepathy, CLIENT);
+  g_assert_true(nui_test_wait(_observed_cb, f));
+}
+
+static void
+test_text(gconstpointer data)
+{
+  Fixture *f = (Fixture *)data;
+  TpBaseChannel *alice, *bob;
+  const gchar *body;
+  guint32 *ids;
+  guint n_ids;
+  guint i;
+  gboolean found = FALSE;
+
+  /* a burst after reconnecting, both channels come in one call */
+  alice = nui_mock_telepathy_add_text(f->telepathy, "alice");
+  nui_mock_telepathy_receive(f->telepathy, alice, "Hi");
+  nui_mock_telepathy_receive(f->telepathy, alice, "Are you there?");
+  bob = nui_mock_telepathy_add_text(f->telepathy, "bob");
+  nui_mock_telepathy_receive(f->telepathy, bob, "Hi from Bob");
+  _dispatch(f);
+
+  /* one notification per contact */
+  f->created = 2;
+  g_assert_true(nui_test_wait(_created_cb, f));
+  nui_test_spin(500);
+  g_assert_cmpuint(nui_mock_notifications_get_created(f->notifications), ==,
+                   2);
+  g_assert_cmpuint(nui_mock_notifications_get_updated(f->notifications), ==,
+                   0);
+  g_assert_cmpuint(nui_core_get_unread_messages(f->core), ==, 3);
+
+  ids = nui_mock_notifications_dup_ids(f->notifications, &n_ids);
+  g_assert_cmpuint(n_ids, ==, 2);
+
+  for (i = 0; i < n_ids; i++)
+  {
+    body = nui_mock_notifications_get_body(f->notifications, ids[i]);
+
+    if (!g_strcmp0(body, "Hi from Bob"))
+      found = TRUE;
+  }
+
+  g_assert_true(found);
+  g_free(ids);
+
+  /* a later message replaces the notification of its contact */
+  nui_mock_telepathy_receive(f->telepathy, alice, "Hello?");
+  f->updated = 1;
+  g_assert_true(nui_test_wait(_updated_cb, f));
+  g_assert_cmpuint(nui_mock_notifications_get_created(f->notifications), ==,
+                   2);
+  g_assert_cmpuint(nui_core_get_unread_messages(f->core), ==, 4);
+}
+
+static void
+test_call(gconstpointer data)
+{
+  Fixture *f = (Fixture *)data;
+  TpBaseChannel *call;
+
+  /* closed without being answered */
+  call = nui_mock_telepathy_add_call(f->telepathy, "carol");
+  _dispatch(f);
+  nui_mock_telepathy_close(f->telepathy, call);
+
+  f->created = nui_mock_notifications_get_created(f->notifications) + 1;
+  f->updated = nui_mock_notifications_get_updated(f->notifications) + 1;
+  g_assert_true(nui_test_wait(_created_cb, f));
+  g_assert_cmpuint(nui_core_get_missed_calls(f->core), ==, 1);
+
+  /* the second one from the same contact goes to the same notification */
+  call = nui_mock_telepathy_add_call(f->telepathy, "carol");
+  _dispatch(f);
+  nui_mock_telepathy_close(f->telepathy, call);
+
+  g_assert_true(nui_test_wait(_updated_cb, f));
+  g_assert_cmpuint(nui_mock_notifications_get_created(f->notifications), ==,
+                   f->created);
+  g_assert_cmpuint(nui_core_get_missed_calls(f->core), ==, 2);
+}
+
+static void
+_cache_remove(const gchar *dir)
+{
+  gchar *path = g_build_filename(dir, PACKAGE_NAME, "counters", NULL);
+
+  g_remove(path);
+  g_free(path);
+
+  path = g_build_filename(dir, PACKAGE_NAME, NULL);
+  g_rmdir(path);
+  g_free(path);
+
+  g_rmdir(dir);
+}
+
+int
+main(int argc, char **argv)
+{
+  GError *error = NULL;
+  Fixture f = { 0 };
+  gchar *cache;
+  int rv;
+
+  /* keep the stored counters out of the user ones */
+  cache = g_dir_make_tmp("nui-test-XXXXXX", &error);
+  g_assert_no_error(error);
+  g_setenv("XDG_CACHE_HOME", cache, TRUE);
+
+  g_test_init(&argc, &argv, NULL);
+
+  f.bus = nui_test_bus_up();
+  f.notifications = nui_mock_notifications_new(
+        g_test_dbus_get_bus_address(f.bus));
+  f.telepathy = nui_mock_telepathy_new(g_test_dbus_get_bus_address(f.bus));
+
+  f.core = NUI_CORE(nui_core_new());
+  nui_test_spin(500);
+
+  g_test_add_data_func("/core-telepathy/text", &f, test_text);
+  g_test_add_data_func("/core-telepathy/call", &f, test_call);
+
+  rv = g_test_run();
+
+  g_object_unref(f.core);
+  nui_test_spin(100);
+  nui_mock_telepathy_free(f.telepathy);
+  nui_mock_notifications_free(f.notifications);
+  nui_test_bus_down(f.bus);
+  _cache_remove(cache);
+  g_free(cache);
+
+  return rv;
+}
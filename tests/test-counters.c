@@ -0,0 +1,172 @@
+/*
+ * test-counters.c
+ *
+ * Copyright (C) 2024 Ivaylo Dimitrov <ivo.g.dimitrov.75@gmail.com>
+ *
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "config.h"
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "nui-counters.h"
+
+static gchar *path;
+
+static void
+_setup(gpointer fixture, gconstpointer data)
+{
+  g_remove(path);
+}
+
+static void
+test_persist(gpointer fixture, gconstpointer data)
+{
+  NuiCounters *counters = nui_counters_open();
+
+  /* nothing stored yet */
+  g_assert_true(nui_counters_is_fresh(counters));
+  g_assert_cmpuint(nui_counters_get(counters, NUI_COUNTER_MISSED_CALLS), ==,
+                   0);
+
+  nui_counters_add(counters, NUI_COUNTER_MISSED_CALLS, 3);
+  nui_counters_add(counters, NUI_COUNTER_UNREAD_MESSAGES, 5);
+  nui_counters_add(counters, NUI_COUNTER_UNREAD_MESSAGES, -7);
+  nui_counters_set_missed(counters, 10, 3);
+  nui_counters_close(counters);
+
+  /* a restart serves what was stored */
+  counters = nui_counters_open();
+  g_assert_false(nui_counters_is_fresh(counters));
+  g_assert_cmpuint(nui_counters_get(counters, NUI_COUNTER_MISSED_CALLS), ==,
+                   3);
+  g_assert_cmpuint(nui_counters_get(counters, NUI_COUNTER_UNREAD_MESSAGES),
+                   ==, 0);
+  g_assert_cmpuint(nui_counters_get_missed(counters, 10), ==, 3);
+  nui_counters_close(counters);
+}
+
+static void
+test_invalid(gpointer fixture, gconstpointer data)
+{
+  NuiCounters *counters;
+
+  g_assert_true(g_file_set_contents(path, "garbage that is no counters file",
+                                    -1, NULL));
+
+  counters = nui_counters_open();
+  g_assert_true(nui_counters_is_fresh(counters));
+  g_assert_cmpuint(nui_counters_get(counters, NUI_COUNTER_UNREAD_MESSAGES),
+                   ==, 0);
+  g_assert_cmpuint(nui_counters_get_missed_total(counters), ==, 0);
+  nui_counters_close(counters);
+}
+
+static void
+test_missed(gpointer fixture, gconstpointer data)
+{
+  NuiCounters *counters = nui_counters_open();
+  guint32 id;
+
+  nui_counters_set_missed(counters, 1, 2);
+  nui_counters_set_missed(counters, 2, 1);
+  g_assert_cmpuint(nui_counters_get_missed_total(counters), ==, 3);
+
+  /* updated in place */
+  nui_counters_set_missed(counters, 1, 4);
+  g_assert_cmpuint(nui_counters_get_missed_total(counters), ==, 5);
+
+  nui_counters_set_missed(counters, 1, 0);
+  g_assert_cmpuint(nui_counters_get_missed(counters, 1), ==, 0);
+  g_assert_cmpuint(nui_counters_get_missed(counters, 0), ==, 0);
+  g_assert_cmpuint(nui_counters_get_missed_total(counters), ==, 1);
+
+  /* the oldest notification goes when there is no room left */
+  for (id = 3; id < 100; id++)
+    nui_counters_set_missed(counters, id, 1);
+
+  g_assert_cmpuint(nui_counters_get_missed(counters, 2), ==, 0);
+  g_assert_cmpuint(nui_counters_get_missed(counters, 99), ==, 1);
+  g_assert_cmpuint(nui_counters_get_missed_total(counters), <, 97);
+
+  nui_counters_close(counters);
+}
+
+static void
+test_owner(gpointer fixture, gconstpointer data)
+{
+  NuiCounters *counters = nui_counters_open();
+  guint32 id;
+
+  /* a restarted daemon starts counting again, the first id is not newest */
+  g_assert_true(nui_counters_set_missed_owner(counters, ":1.10"));
+  nui_counters_set_missed(counters, 1000, 1);
+
+  for (id = 1; id < 100; id++)
+    nui_counters_set_missed(counters, id, 1);
+
+  g_assert_cmpuint(nui_counters_get_missed(counters, 1000), ==, 0);
+  g_assert_cmpuint(nui_counters_get_missed(counters, 99), ==, 1);
+
+  /* the same daemon keeps its ids, also across a restart */
+  g_assert_false(nui_counters_set_missed_owner(counters, ":1.10"));
+  nui_counters_close(counters);
+  counters = nui_counters_open();
+  g_assert_false(nui_counters_set_missed_owner(counters, ":1.10"));
+  g_assert_cmpuint(nui_counters_get_missed(counters, 99), ==, 1);
+
+  /* another one does not */
+  g_assert_true(nui_counters_set_missed_owner(counters, NULL));
+  g_assert_cmpuint(nui_counters_get_missed_total(counters), ==, 0);
+  g_assert_false(nui_counters_set_missed_owner(counters, NULL));
+
+  nui_counters_close(counters);
+}
+
+int
+main(int argc, char **argv)
+{
+  GError *error = NULL;
+  gchar *cache;
+  int rv;
+
+  /* before anything asks GLib for the cache dir */
+  cache = g_dir_make_tmp("nui-test-XXXXXX", &error);
+  g_assert_no_error(error);
+  g_setenv("XDG_CACHE_HOME", cache, TRUE);
+  path = g_build_filename(cache, PACKAGE_NAME, "counters", NULL);
+
+  g_test_init(&argc, &argv, NULL);
+
+  g_test_add("/counters/persist", gpointer, NULL, _setup, test_persist,
+             NULL);
+  g_test_add("/counters/invalid", gpointer, NULL, _setup, test_invalid,
+             NULL);
+  g_test_add("/counters/missed", gpointer, NULL, _setup, test_missed, NULL);
+  g_test_add("/counters/owner", gpointer, NULL, _setup, test_owner, NULL);
+
+  rv = g_test_run();
+
+  g_remove(path);
+  g_free(path);
+  path = g_build_filename(cache, PACKAGE_NAME, NULL);
+  g_rmdir(path);
+  g_rmdir(cache);
+  g_free(path);
+  g_free(cache);
+
+  return rv;
+}
@@ -0,0 +1,206 @@
+/*
+ * test-sms-filter.c
+ *
+ * Copyright (C) 2024 Ivaylo Dimitrov <ivo.g.dimitrov.75@gmail.com>
+ *
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "config.h"
+
+#include <gio/gio.h>
+
+#include "nui-sms-filter.h"
+
+#include "nui-test.h"
+
+#define HOLD 200
+
+typedef struct
+{
+  NuiSmsFilter *filter;
+  /* messages released, in order */
+  GPtrArray *released;
+  guint destroyed;
+} Fixture;
+
+static void
+_release(gpointer message, gpointer user_data)
+{
+  Fixture *f = user_data;
+
+  g_ptr_array_add(f->released, message);
+}
+
+static void
+_destroy(gpointer message)
+{
+  Fixture *f = g_object_get_data(G_OBJECT(message), "fixture");
+
+  f->destroyed++;
+  g_object_unref(message);
+}
+
+static gpointer
+_message(Fixture *f, const gchar *text)
+{
+  GObject *message = g_object_new(G_TYPE_OBJECT, NULL);
+
+  g_object_set_data(message, "fixture", f);
+  g_object_set_data_full(message, "text", g_strdup(text), g_free);
+
+  return message;
+}
+
+static const gchar *
+_released_text(Fixture *f, guint i)
+{
+  return g_object_get_data(g_ptr_array_index(f->released, i), "text");
+}
+
+static gboolean
+_released_cb(gpointer user_data)
+{
+  Fixture *f = user_data;
+
+  return f->released->len > 0;
+}
+
+static void
+_setup(Fixture *f, gconstpointer data)
+{
+  f->released = g_ptr_array_new_with_free_func(g_object_unref);
+  f->filter = nui_sms_filter_new(HOLD, _release, _destroy, f);
+}
+
+static void
+_teardown(Fixture *f, gconstpointer data)
+{
+  if (f->filter)
+    nui_sms_filter_free(f->filter);
+
+  g_ptr_array_unref(f->released);
+}
+
+static void
+_assert_stats(Fixture *f, guint released, guint dropped)
+{
+  guint r;
+  guint d;
+
+  nui_sms_filter_get_stats(f->filter, &r, &d);
+  g_assert_cmpuint(r, ==, released);
+  g_assert_cmpuint(d, ==, dropped);
+}
+
+static void
+test_release(Fixture *f, gconstpointer data)
+{
+  gint64 start = g_get_monotonic_time();
+
+  /* nothing came through Telepathy, all of them are shown, in order */
+  nui_sms_filter_hold(f->filter, "+15550100", _message(f, "one"));
+  nui_sms_filter_hold(f->filter, "+15550101", _message(f, "two"));
+  nui_sms_filter_hold(f->filter, "+15550100", _message(f, "three"));
+
+  g_assert_true(nui_test_wait(_released_cb, f));
+  g_assert_cmpint(g_get_monotonic_time() - start, >=, HOLD * 1000);
+  nui_test_spin(50);
+
+  g_assert_cmpuint(f->released->len, ==, 3);
+  g_assert_cmpstr(_released_text(f, 0), ==, "one");
+  g_assert_cmpstr(_released_text(f, 1), ==, "two");
+  g_assert_cmpstr(_released_text(f, 2), ==, "three");
+  g_assert_cmpuint(f->destroyed, ==, 0);
+  _assert_stats(f, 3, 0);
+}
+
+static void
+test_telepathy_later(Fixture *f, gconstpointer data)
+{
+  nui_sms_filter_hold(f->filter, "+358401234567", _message(f, "one"));
+  nui_sms_filter_hold(f->filter, "+15550100", _message(f, "two"));
+
+  /* the same SMS through the ring channel, in the national form */
+  nui_sms_filter_seen(f->filter, "0401234567");
+  g_assert_cmpuint(f->destroyed, ==, 1);
+
+  g_assert_true(nui_test_wait(_released_cb, f));
+  nui_test_spin(HOLD);
+  g_assert_cmpuint(f->released->len, ==, 1);
+  g_assert_cmpstr(_released_text(f, 0), ==, "two");
+  _assert_stats(f, 1, 1);
+}
+
+static void
+test_telepathy_first(Fixture *f, gconstpointer data)
+{
+  nui_sms_filter_seen(f->filter, "+15550100");
+  nui_sms_filter_hold(f->filter, "+1 555 0100", _message(f, "one"));
+  g_assert_cmpuint(f->destroyed, ==, 1);
+
+  /* matched one for one, the next one from the same sender is shown */
+  nui_sms_filter_hold(f->filter, "+15550100", _message(f, "two"));
+  g_assert_true(nui_test_wait(_released_cb, f));
+  g_assert_cmpstr(_released_text(f, 0), ==, "two");
+  _assert_stats(f, 1, 1);
+}
+
+static void
+test_expire(Fixture *f, gconstpointer data)
+{
+  /* too long ago to be the same SMS */
+  nui_sms_filter_seen(f->filter, "+15550100");
+  nui_test_spin(HOLD * 2);
+
+  nui_sms_filter_hold(f->filter, "+15550100", _message(f, "one"));
+  g_assert_true(nui_test_wait(_released_cb, f));
+  g_assert_cmpuint(f->destroyed, ==, 0);
+  _assert_stats(f, 1, 0);
+}
+
+static void
+test_free(Fixture *f, gconstpointer data)
+{
+  /* held ones go with the filter */
+  nui_sms_filter_hold(f->filter, "+15550100", _message(f, "one"));
+  nui_sms_filter_hold(f->filter, "+15550101", _message(f, "two"));
+  nui_sms_filter_seen(f->filter, "+15550102");
+
+  nui_sms_filter_free(f->filter);
+  f->filter = NULL;
+  g_assert_cmpuint(f->destroyed, ==, 2);
+
+  nui_test_spin(HOLD * 2);
+  g_assert_cmpuint(f->released->len, ==, 0);
+}
+
+int
+main(int argc, char **argv)
+{
+  g_test_init(&argc, &argv, NULL);
+
+  g_test_add("/sms-filter/release", Fixture, NULL, _setup, test_release,
+             _teardown);
+  g_test_add("/sms-filter/telepathy-later", Fixture, NULL, _setup,
+             test_telepathy_later, _teardown);
+  g_test_add("/sms-filter/telepathy-first", Fixture, NULL, _setup,
+             test_telepathy_first, _teardown);
+  g_test_add("/sms-filter/expire", Fixture, NULL, _setup, test_expire,
+             _teardown);
+  g_test_add("/sms-filter/free", Fixture, NULL, _setup, test_free,
+             _teardown);
+
+  return g_test_run();
+}
@@ -0,0 +1,236 @@
+/*
+ * test-status-updater.c
+ *
+ * Copyright (C) 2024 Ivaylo Dimitrov <ivo.g.dimitrov.75@gmail.com>
+ *
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library. If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "config.h"
+
+#include <gio/gio.h>
+
+#include "nui-status-updater.h"
+
+#include "nui-mock-mce.h"
+#include "nui-test.h"
+
+/* long enough for a display_status_ind to get in before it fires */
+#define DELAY 500
+
+typedef struct
+{
+  GTestDBus *bus;
+  NuiMockMce *mce;
+  NuiStatusUpdater *updater;
+  /* what the UI shows and what it should */
+  guint shown;
+  guint state;
+  guint applies;
+} Fixture;
+
+static gboolean
+_apply(gpointer user_data)
+{
+  Fixture *f = user_data;
+
+  f->applies++;
+
+  if (f->shown == f->state)
+    return FALSE;
+
+  f->shown = f->state;
+
+  return TRUE;
+}
+
+static gboolean
+_requested_cb(gpointer user_data)
+{
+  return nui_mock_mce_get_requests(user_data) > 0;
+}
+
+static gboolean
+_display_off_cb(gpointer user_data)
+{
+  Fixture *f = user_data;
+
+  return nui_status_updater_get_display_off(f->updater);
+}
+
+static gboolean
+_display_on_cb(gpointer user_data)
+{
+  return !_display_off_cb(user_data);
+}
+
+static gboolean
+_applied_cb(gpointer user_data)
+{
+  Fixture *f = user_data;
+
+  return f->applies > 0;
+}
+
+static void
+_setup(Fixture *f, gconstpointer data)
+{
+  f->bus = nui_test_bus_up();
+  f->mce = nui_mock_mce_new(g_test_dbus_get_bus_address(f->bus), data);
+}
+
+/* the display status is known once the updater asked for it */
+static void
+_updater_new(Fixture *f, guint delay)
+{
+  f->updater = nui_status_updater_new(delay, _apply, f);
+  g_assert_true(nui_test_wait(_requested_cb, f->mce));
+  nui_test_spin(50);
+}
+
+static void
+_teardown(Fixture *f, gconstpointer data)
+{
+  if (f->updater)
+    nui_status_updater_free(f->updater);
+
+  nui_test_spin(100);
+  nui_mock_mce_free(f->mce);
+  nui_test_bus_down(f->bus);
+}
+
+static void
+_request(Fixture *f, guint n)
+{
+  guint i;
+
+  for (i = 0; i < n; i++)
+  {
+    f->state++;
+    nui_status_updater_request(f->updater);
+  }
+}
+
+static void
+_assert_stats(Fixture *f, guint requested, guint applied)
+{
+  guint r;
+  guint a;
+
+  nui_status_updater_get_stats(f->updater, &r, &a);
+  g_assert_cmpuint(r, ==, requested);
+  g_assert_cmpuint(a, ==, applied);
+}
+
+static void
+test_coalesce(Fixture *f, gconstpointer data)
+{
+  _updater_new(f, 0);
+  g_assert_false(nui_status_updater_get_display_off(f->updater));
+
+  /* a burst within one main loop iteration is one update */
+  _request(f, 10);
+  g_assert_cmpuint(f->applies, ==, 0);
+  g_assert_true(nui_test_wait(_applied_cb, f));
+  nui_test_spin(50);
+
+  g_assert_cmpuint(f->applies, ==, 1);
+  g_assert_cmpuint(f->shown, ==, 10);
+  _assert_stats(f, 10, 1);
+}
+
+static void
+test_unchanged(Fixture *f, gconstpointer data)
+{
+  _updater_new(f, 0);
+
+  /* nothing new on screen is not counted as applied */
+  nui_status_updater_request(f->updater);
+  g_assert_true(nui_test_wait(_applied_cb, f));
+  _assert_stats(f, 1, 0);
+}
+
+static void
+test_display_off(Fixture *f, gconstpointer data)
+{
+  _updater_new(f, 0);
+  g_assert_true(nui_test_wait(_display_off_cb, f));
+
+  /* held back for as long as the display is off */
+  _request(f, 20);
+  nui_test_spin(200);
+  g_assert_cmpuint(f->applies, ==, 0);
+
+  nui_mock_mce_set_display(f->mce, "dimmed");
+  g_assert_true(nui_test_wait(_display_on_cb, f));
+
+  /* only the last state is applied */
+  g_assert_true(nui_test_wait(_applied_cb, f));
+  nui_test_spin(50);
+  g_assert_cmpuint(f->applies, ==, 1);
+  g_assert_cmpuint(f->shown, ==, 20);
+  _assert_stats(f, 20, 1);
+}
+
+static void
+test_blanked(Fixture *f, gconstpointer data)
+{
+  _updater_new(f, DELAY);
+
+  /* the display goes off with an update scheduled */
+  _request(f, 3);
+  nui_mock_mce_set_display(f->mce, "off");
+  g_assert_true(nui_test_wait(_display_off_cb, f));
+
+  _request(f, 3);
+  nui_test_spin(DELAY * 2);
+  g_assert_cmpuint(f->applies, ==, 0);
+
+  nui_mock_mce_set_display(f->mce, "on");
+  g_assert_true(nui_test_wait(_applied_cb, f));
+  nui_test_spin(DELAY * 2);
+  g_assert_cmpuint(f->applies, ==, 1);
+  g_assert_cmpuint(f->shown, ==, 6);
+  _assert_stats(f, 6, 1);
+}
+
+static void
+test_display_on(Fixture *f, gconstpointer data)
+{
+  _updater_new(f, 0);
+  nui_mock_mce_set_display(f->mce, "on");
+  nui_test_spin(50);
+
+  /* nothing held back, nothing to apply */
+  g_assert_cmpuint(f->applies, ==, 0);
+}
+
+int
+main(int argc, char **argv)
+{
+  g_test_init(&argc, &argv, NULL);
+
+  g_test_add("/status-updater/coalesce", Fixture, "on", _setup,
+             test_coalesce, _teardown);
+  g_test_add("/status-updater/unchanged", Fixture, "on", _setup,
+             test_unchanged, _teardown);
+  g_test_add("/status-updater/display-off", Fixture, "off", _setup,
+             test_display_off, _teardown);
+  g_test_add("/status-updater/blanked", Fixture, "on", _setup,
+             test_blanked, _teardown);
+  g_test_add("/status-updater/display-on", Fixture, "off", _setup,
+             test_display_on, _teardown);
+
+  return g_test_run();
+}